@@ -0,0 +1,234 @@
+#ifndef MINECRAFT_ARENA_H
+#define MINECRAFT_ARENA_H
+#include "core.h"
+
+#include <cstddef>
+
+namespace Minecraft
+{
+	namespace MemoryStats
+	{
+		// Number of heap allocations made by the chunk pipeline. Arenas and object pools count every
+		// time they have to grow, and debug builds also count every operator new on a thread that's
+		// running pipeline work (see Arena.cpp), so std containers show up here too. Once the chunk
+		// pipeline has warmed up this should stop changing.
+		inline std::atomic<uint64> heapAllocations = 0;
+
+		// Set while this thread is running chunk pipeline work
+		inline thread_local bool isPipelineThread = false;
+
+		// For memory that came from new, which the debug operator new hook may have counted already
+		inline void countNewAllocation()
+		{
+#ifdef _DEBUG
+			if (isPipelineThread)
+			{
+				return;
+			}
+#endif
+			heapAllocations++;
+		}
+	}
+
+	// Bump allocator for short lived data. Nothing is freed individually, memory is handed
+	// back all at once by rewinding the arena and the blocks are kept around for reuse.
+	class Arena
+	{
+	public:
+		struct Marker
+		{
+			uint32 block;
+			size_t offset;
+		};
+
+		Arena(size_t blockSize = 256 * 1024)
+			: blockSize(blockSize), currentBlock(0)
+		{
+			blocks.reserve(16);
+		}
+
+		~Arena()
+		{
+			for (ArenaBlock& block : blocks)
+			{
+				g_memory_free(block.data);
+			}
+			blocks.clear();
+		}
+
+		Arena(const Arena&) = delete;
+		Arena& operator=(const Arena&) = delete;
+
+		void* allocate(size_t size, size_t alignment = alignof(std::max_align_t))
+		{
+			while (currentBlock < (uint32)blocks.size())
+			{
+				ArenaBlock& block = blocks[currentBlock];
+				size_t alignedOffset = (block.offset + alignment - 1) & ~(alignment - 1);
+				if (alignedOffset + size <= block.size)
+				{
+					block.offset = alignedOffset + size;
+					return block.data + alignedOffset;
+				}
+
+				currentBlock++;
+				if (currentBlock < (uint32)blocks.size())
+				{
+					blocks[currentBlock].offset = 0;
+				}
+			}
+
+			size_t newBlockSize = glm::max(blockSize, size + alignment);
+			ArenaBlock newBlock;
+			newBlock.data = (uint8*)g_memory_allocate(newBlockSize);
+			newBlock.size = newBlockSize;
+			newBlock.offset = 0;
+			MemoryStats::heapAllocations++;
+			blocks.push_back(newBlock);
+			return allocate(size, alignment);
+		}
+
+		template<typename T>
+		T* allocate(size_t count = 1)
+		{
+			return (T*)allocate(sizeof(T) * count, alignof(T));
+		}
+
+		Marker mark() const
+		{
+			if (currentBlock < (uint32)blocks.size())
+			{
+				return { currentBlock, blocks[currentBlock].offset };
+			}
+			return { currentBlock, 0 };
+		}
+
+		void rewind(const Marker& marker)
+		{
+			currentBlock = marker.block;
+			if (currentBlock < (uint32)blocks.size())
+			{
+				blocks[currentBlock].offset = marker.offset;
+			}
+		}
+
+		void reset()
+		{
+			rewind({ 0, 0 });
+		}
+
+		// Every thread gets its own arena, so allocating never has to take a lock
+		static Arena& threadLocal()
+		{
+			static thread_local Arena arena;
+			return arena;
+		}
+
+	private:
+		struct ArenaBlock
+		{
+			uint8* data;
+			size_t size;
+			size_t offset;
+		};
+
+		std::vector<ArenaBlock> blocks;
+		size_t blockSize;
+		uint32 currentBlock;
+	};
+
+	// Rewinds the thread's arena to wherever it was when the scope was opened
+	class ArenaScope
+	{
+	public:
+		ArenaScope()
+			: arena(Arena::threadLocal()), marker(arena.mark())
+		{
+		}
+
+		~ArenaScope()
+		{
+			arena.rewind(marker);
+		}
+
+		ArenaScope(const ArenaScope&) = delete;
+		ArenaScope& operator=(const ArenaScope&) = delete;
+
+	private:
+		Arena& arena;
+		Arena::Marker marker;
+	};
+
+	// FIFO ring buffer that lives in the thread's arena, so it should only live inside an ArenaScope
+	// and only hold plain data. It doubles in size when it fills up, which means the arena grows
+	// with the queue's peak size instead of with every value that was ever pushed.
+	template<typename T>
+	class ArenaQueue
+	{
+	public:
+		ArenaQueue(uint32 initialCapacity = 4096)
+			: arena(Arena::threadLocal()), capacity(initialCapacity), head(0), count(0)
+		{
+			g_logger_assert(initialCapacity > 0 && (initialCapacity & (initialCapacity - 1)) == 0, "ArenaQueue capacity must be a power of two, got '%u'.", initialCapacity);
+			slots = arena.allocate<T>(capacity);
+		}
+
+		ArenaQueue(const ArenaQueue&) = delete;
+		ArenaQueue& operator=(const ArenaQueue&) = delete;
+
+		bool empty() const
+		{
+			return count == 0;
+		}
+
+		uint32 size() const
+		{
+			return count;
+		}
+
+		const T& front() const
+		{
+			return slots[head];
+		}
+
+		void push(const T& value)
+		{
+			if (count == capacity)
+			{
+				grow();
+			}
+
+			slots[(head + count) & (capacity - 1)] = value;
+			count++;
+		}
+
+		void pop()
+		{
+			head = (head + 1) & (capacity - 1);
+			count--;
+		}
+
+	private:
+		void grow()
+		{
+			// The old slots stay in the arena until the scope rewinds
+			T* newSlots = arena.allocate<T>(capacity * 2);
+			for (uint32 i = 0; i < count; i++)
+			{
+				newSlots[i] = slots[(head + i) & (capacity - 1)];
+			}
+			slots = newSlots;
+			head = 0;
+			capacity *= 2;
+		}
+
+	private:
+		Arena& arena;
+		T* slots;
+		uint32 capacity;
+		uint32 head;
+		uint32 count;
+	};
+}
+
+#endif
@@ -10,12 +10,23 @@ namespace Minecraft
 		uint64 lastAccess;
 	};
 
+	struct MappedFile
+	{
+		const uint8* data;
+		size_t size;
+		void* mappingHandle;
+	};
+
 	namespace File
 	{
 		bool removeDir(const char* directoryName);
 		bool isDir(const char* directoryName);
 		bool isFile(const char* directoryName);
 		bool moveFile(const char* from, const char* to);
+		// Atomically replaces the destination file if it already exists
+		bool replaceFile(const char* from, const char* to);
+		// Flushes the stream and blocks until the OS has written it to disk
+		bool syncFile(FILE* fp);
 		bool createDirIfNotExists(const char* directoryName);
 		std::string getSpecialAppFolder();
 
@@ -28,6 +39,12 @@ namespace Minecraft
 		///	since 12:00 AM Jan. 1, 1601
 		/// </returns>
 		FileTime getFileTimes(const char* fileOrDirName);
+
+		// Maps the whole file read-only. data is null if the file could not be mapped.
+		MappedFile mapFileReadOnly(const char* filepath);
+		void unmapFile(MappedFile& file);
+		// Hints to the OS that this range of the mapping is about to be read
+		void prefetchMappedRange(const MappedFile& file, size_t offset, size_t size);
 	}
 }
 
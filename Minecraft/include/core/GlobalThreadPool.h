@@ -50,6 +50,7 @@ namespace Minecraft
 		void beginWork(bool notifyAll = true);
 
 	private:
+		static const uint32 initialTaskCapacity = 4096;
 		std::priority_queue<ThreadTask, std::vector<ThreadTask>, CompareThreadTask> tasks;
 		std::thread* workerThreads;
 		std::condition_variable cv;
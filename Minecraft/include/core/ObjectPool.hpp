@@ -0,0 +1,57 @@
+#ifndef MINECRAFT_OBJECT_POOL_H
+#define MINECRAFT_OBJECT_POOL_H
+#include "core.h"
+#include "core/Arena.hpp"
+
+namespace Minecraft
+{
+	// Keeps released objects around so they can be handed out again without going
+	// to the heap. Objects are not reset, the caller is responsible for that.
+	template<typename T>
+	class ObjectPool
+	{
+	public:
+		ObjectPool() = default;
+
+		~ObjectPool()
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			for (T* object : freeObjects)
+			{
+				delete object;
+			}
+			freeObjects.clear();
+		}
+
+		ObjectPool(const ObjectPool&) = delete;
+		ObjectPool& operator=(const ObjectPool&) = delete;
+
+		T* acquire()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				if (!freeObjects.empty())
+				{
+					T* object = freeObjects.back();
+					freeObjects.pop_back();
+					return object;
+				}
+			}
+
+			MemoryStats::countNewAllocation();
+			return new T();
+		}
+
+		void release(T* object)
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			freeObjects.push_back(object);
+		}
+
+	private:
+		std::mutex mtx;
+		std::vector<T*> freeObjects;
+	};
+}
+
+#endif
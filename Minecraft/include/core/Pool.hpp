@@ -14,10 +14,10 @@ namespace Minecraft
 			data = nullptr;
 			dataLength = 0;
 			_poolSize = 0;
-			std::lock_guard<std::mutex> lock(freeListMtx);
 			freeList = nullptr;
-			freeListSize = 0;
-			freeListStart = 0;
+			enqueuePos.store(0);
+			dequeuePos.store(0);
+			freeListSize.store(0);
 		}
 
 		Pool(uint32 poolSize, uint32 numPools)
@@ -27,15 +27,16 @@ namespace Minecraft
 			dataLength = numPools * poolSize;
 			_poolSize = poolSize;
 
-			// Initialize the free list
-			std::lock_guard<std::mutex> lock(freeListMtx);
-			freeListSize = numPools;
-			freeListStart = 0;
-			freeList = (T**)g_memory_allocate(sizeof(T*) * numPools);
+			// Initialize the free list, every pool starts out free
+			freeList = (FreeListCell*)g_memory_allocate(sizeof(FreeListCell) * numPools);
 			for (uint32 i = 0; i < numPools; i++)
 			{
-				freeList[i] = data + (_poolSize * i);
+				freeList[i].poolIndex = i;
+				freeList[i].sequence.store(i + 1, std::memory_order_relaxed);
 			}
+			enqueuePos.store(numPools);
+			dequeuePos.store(0);
+			freeListSize.store(numPools);
 		}
 
 		~Pool()
@@ -50,8 +51,9 @@ namespace Minecraft
 
 				g_memory_free(freeList);
 				freeList = nullptr;
-				freeListSize = 0;
-				freeListStart = 0;
+				enqueuePos.store(0);
+				dequeuePos.store(0);
+				freeListSize.store(0);
 			}
 		}
 
@@ -69,14 +71,39 @@ namespace Minecraft
 
 		T* getNewPool()
 		{
-			std::lock_guard<std::mutex> lock(freeListMtx);
-			if (freeListSize > 0)
+			uint64 pos = dequeuePos.load(std::memory_order_relaxed);
+			while (true)
 			{
-				T* nextPool = freeList[freeListStart];
-				freeList[freeListStart] = nullptr;
-				freeListStart = (freeListStart + 1) % numPools;
-				freeListSize--;
-				return nextPool;
+				FreeListCell& cell = freeList[pos % numPools];
+				uint64 sequence = cell.sequence.load(std::memory_order_acquire);
+				int64 diff = (int64)sequence - (int64)(pos + 1);
+				if (diff == 0)
+				{
+					if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					{
+						uint32 poolIndex = cell.poolIndex;
+						// Hand the cell back to the producers one lap later
+						cell.sequence.store(pos + numPools, std::memory_order_release);
+						freeListSize.fetch_sub(1, std::memory_order_relaxed);
+						return data + (_poolSize * poolIndex);
+					}
+				}
+				else if (diff < 0)
+				{
+					if (enqueuePos.load(std::memory_order_relaxed) <= pos)
+					{
+						// Nothing left to hand out
+						break;
+					}
+
+					// A free is halfway through writing this cell
+					std::this_thread::yield();
+					pos = dequeuePos.load(std::memory_order_relaxed);
+				}
+				else
+				{
+					pos = dequeuePos.load(std::memory_order_relaxed);
+				}
 			}
 
 			g_logger_error("Ran out of pools.");
@@ -86,10 +113,39 @@ namespace Minecraft
 		void freePool(uint32 poolIndex)
 		{
 			g_logger_assert(poolIndex >= 0 && poolIndex < numPools, "Pool index '%d' out of bounds in pool with size '%d'.", poolIndex, numPools);
-			std::lock_guard<std::mutex> lock(freeListMtx);
-			uint32 nextIndex = (freeListStart + freeListSize) % numPools;
-			freeList[nextIndex] = (T*)(data + (_poolSize * poolIndex));
-			freeListSize++;
+			uint64 pos = enqueuePos.load(std::memory_order_relaxed);
+			while (true)
+			{
+				FreeListCell& cell = freeList[pos % numPools];
+				uint64 sequence = cell.sequence.load(std::memory_order_acquire);
+				int64 diff = (int64)sequence - (int64)pos;
+				if (diff == 0)
+				{
+					if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					{
+						cell.poolIndex = poolIndex;
+						cell.sequence.store(pos + 1, std::memory_order_release);
+						freeListSize.fetch_add(1, std::memory_order_relaxed);
+						return;
+					}
+				}
+				else if (diff < 0)
+				{
+					if (dequeuePos.load(std::memory_order_relaxed) + numPools <= pos)
+					{
+						g_logger_assert(false, "Freed more pools than this pool holds. Pool index '%d' was probably freed twice.", poolIndex);
+						return;
+					}
+
+					// A getNewPool is halfway through reading this cell
+					std::this_thread::yield();
+					pos = enqueuePos.load(std::memory_order_relaxed);
+				}
+				else
+				{
+					pos = enqueuePos.load(std::memory_order_relaxed);
+				}
+			}
 		}
 
 		void freePool(T* pool)
@@ -99,10 +155,14 @@ namespace Minecraft
 			freePool(poolIndex);
 		}
 
-		uint32 count()
+		bool contains(const T* pool) const
+		{
+			return pool >= data && pool < data + (_poolSize * numPools);
+		}
+
+		uint32 count() const
 		{
-			std::lock_guard<std::mutex> lock(freeListMtx);
-			return freeListSize;
+			return freeListSize.load(std::memory_order_relaxed);
 		}
 
 		uint32 size() const
@@ -120,17 +180,26 @@ namespace Minecraft
 			return dataLength * sizeof(T);
 		}
 
-		bool empty()
+		bool empty() const
 		{
-			std::lock_guard<std::mutex> lock(freeListMtx);
-			return freeListSize == 0;
+			return freeListSize.load(std::memory_order_relaxed) == 0;
 		}
 
 	private:
-		std::mutex freeListMtx;
-		uint32 freeListStart;
-		uint32 freeListSize;
-		T** freeList;
+		// The free list is a bounded lock-free MPMC queue of pool indices. Each cell's sequence
+		// number says whether it's waiting to be written or read on the current lap, so producers
+		// and consumers only ever race on a single compare exchange. It stays first in first out
+		// so a freed pool isn't handed straight back out.
+		struct FreeListCell
+		{
+			std::atomic<uint64> sequence;
+			uint32 poolIndex;
+		};
+
+		FreeListCell* freeList;
+		std::atomic<uint64> enqueuePos;
+		std::atomic<uint64> dequeuePos;
+		std::atomic<uint32> freeListSize;
 
 		uint64 dataLength;
 		uint32 _poolSize;
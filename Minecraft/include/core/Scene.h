@@ -38,7 +38,8 @@ namespace Minecraft
 		LocalLanGame,
 		MultiplayerGame,
 		MainMenu,
-		Replay
+		Replay,
+		DedicatedServer
 	};
 
 	namespace Scene
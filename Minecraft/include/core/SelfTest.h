@@ -0,0 +1,16 @@
+#ifndef MINECRAFT_SELF_TEST_H
+#define MINECRAFT_SELF_TEST_H
+#include "core.h"
+
+namespace Minecraft
+{
+	// Stress tests, fuzzers and benchmarks for the engine's lower level pieces. They run in place
+	// of the game when either binary is started with --selftest, without a window or a world.
+	namespace SelfTest
+	{
+		// Runs every test and logs the results, returns how many of them failed
+		int run();
+	}
+}
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef MINECRAFT_SPSC_QUEUE_H
+#define MINECRAFT_SPSC_QUEUE_H
+#include "core.h"
+
+namespace Minecraft
+{
+	// Fixed size ring buffer that's safe to use without locks as long as exactly one
+	// thread pushes and exactly one thread pops. Capacity must be a power of two.
+	template<typename T>
+	class SpscQueue
+	{
+	public:
+		SpscQueue() = default;
+
+		~SpscQueue()
+		{
+			free();
+		}
+
+		SpscQueue(const SpscQueue&) = delete;
+		SpscQueue& operator=(const SpscQueue&) = delete;
+
+		void init(uint32 inCapacity)
+		{
+			g_logger_assert(inCapacity > 0 && (inCapacity & (inCapacity - 1)) == 0, "SpscQueue capacity must be a power of two, got '%u'.", inCapacity);
+			capacity = inCapacity;
+			slots = (T*)g_memory_allocate(sizeof(T) * capacity);
+			head = 0;
+			tail = 0;
+		}
+
+		void free()
+		{
+			if (slots)
+			{
+				g_memory_free(slots);
+				slots = nullptr;
+			}
+		}
+
+		// Producer thread only. Returns false if the queue is full.
+		bool push(const T& value)
+		{
+			uint32 currentTail = tail.load(std::memory_order_relaxed);
+			if (currentTail - head.load(std::memory_order_acquire) == capacity)
+			{
+				return false;
+			}
+
+			slots[currentTail & (capacity - 1)] = value;
+			tail.store(currentTail + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Consumer thread only. Returns false if the queue is empty.
+		bool pop(T* value)
+		{
+			uint32 currentHead = head.load(std::memory_order_relaxed);
+			if (currentHead == tail.load(std::memory_order_acquire))
+			{
+				return false;
+			}
+
+			*value = slots[currentHead & (capacity - 1)];
+			head.store(currentHead + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Safe from either thread, but it's only a snapshot if the other one is busy
+		uint32 size() const
+		{
+			return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+		}
+
+	private:
+		T* slots = nullptr;
+		uint32 capacity = 0;
+		// Kept on separate cache lines so the two threads don't fight over them
+		alignas(64) std::atomic<uint32> head{ 0 };
+		alignas(64) std::atomic<uint32> tail{ 0 };
+	};
+}
+
+#endif
@@ -1,6 +1,8 @@
 #ifndef MINECRAFT_CLIENT_H
 #define MINECRAFT_CLIENT_H
 #include "core.h"
+#include "core/Ecs.h"
+#include "network/Network.h"
 
 typedef struct _ENetPacket ENetPacket;
 typedef struct _ENetAddress ENetAddress;
@@ -13,7 +15,9 @@ namespace Minecraft
 
 		void update();
 
-		void sendServer(ENetPacket* packet);
+		void sendServer(ENetPacket* packet, NetworkChannel channel = NetworkChannel::Events);
+
+		void queueTransform(Ecs::EntityId entity, const glm::vec3& position, const glm::vec3& orientation);
 
 		void setAddress(const ENetAddress& address);
 
@@ -0,0 +1,36 @@
+#ifndef MINECRAFT_CLIENT_CHUNK_CACHE_H
+#define MINECRAFT_CLIENT_CHUNK_CACHE_H
+#include "core.h"
+
+namespace Minecraft
+{
+	// What the client tells the server it already has when it joins
+	struct CachedChunkVersion
+	{
+		glm::ivec2 chunkCoords;
+		uint64 version;
+	};
+
+	// Chunks streamed from a server, kept in their ChunkCodec encoded form so rejoining doesn't
+	// have to download them all again. It outlives the connection and is versioned with
+	// ChunkCodec::contentVersion, so the server only resends chunks that changed since. The least
+	// recently used chunks get dropped once it goes over Settings::Chunks::clientCacheBudget.
+	namespace ClientChunkCache
+	{
+		// Advertising more than this on join isn't worth the size of the join message
+		static constexpr uint32 maxAdvertisedChunks = 4096;
+
+		// Keeps a copy of the data, replacing any older copy of the chunk
+		void insert(const glm::ivec2& chunkCoords, const uint8* encodedData, size_t encodedSize);
+		// Returns a copy of the chunk's data that the caller frees, or nullptr on a miss
+		uint8* copy(const glm::ivec2& chunkCoords, size_t* encodedSize);
+		// Most recently used first, at most maxAdvertisedChunks of them
+		std::vector<CachedChunkVersion> getVersions();
+		void clear();
+
+		size_t numChunks();
+		size_t memoryUsed();
+	}
+}
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef MINECRAFT_LOAD_TEST_H
+#define MINECRAFT_LOAD_TEST_H
+#include "core.h"
+
+namespace Minecraft
+{
+	// Connects simulated clients to the server running in this process over loopback. Each bot
+	// speaks the same protocol as a real client: it joins, acks the chunks it's streamed, walks
+	// in circles around spawn, places and breaks blocks and chats. Once the test is over the
+	// server tick times, bandwidth per client and latency percentiles get logged.
+	namespace LoadTest
+	{
+		// Must be called after the server has started listening
+		void start(uint32 numBots, uint32 durationInSeconds);
+
+		// Called once per server tick with how long the tick took
+		void recordTick(float tickTimeInSeconds);
+
+		// True once a running test has gone on for its whole duration
+		bool isFinished();
+
+		// Disconnects the bots and logs the report, does nothing if no test was started
+		void stop();
+	}
+}
+
+#endif
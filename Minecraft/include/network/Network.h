@@ -1,16 +1,24 @@
 #ifndef MINECRAFT_NETWORK_H
 #define MINECRAFT_NETWORK_H
 #include "core.h"
+#include "core/Ecs.h"
 
 typedef struct _ENetPeer ENetPeer;
+typedef struct _ENetPacket ENetPacket;
 
 namespace Minecraft
 {
+	enum class NetworkChannel : uint8
+	{
+		// Reliable and ordered, used for everything except transforms
+		Events = 0,
+		// Transform keyframes and deltas, kept separate so dropped deltas never hold up events
+		Transforms = 1,
+	};
+
 	enum class NetworkEventType : uint8
 	{
 		ChunkData,
-		PatchChunkNeighbors,
-		NotifyChunkWorker,
 		WorldSeed,
 		EntityData,
 		LocalPlayer,
@@ -32,8 +40,9 @@ namespace Minecraft
 		ServerTime,
 		Handshake,
 		ClientLoadInfo,
-		CalculateLighting,
+		ChunkAck,
 		SetTime,
+		ChunkCacheMiss,
 	};
 
 	struct NetworkEvent
@@ -62,22 +71,57 @@ namespace Minecraft
 		size_t sizeOfData;
 	};
 
+	// An event that gets written straight into the ENet packet that sends it
+	struct EventPacket
+	{
+		ENetPacket* packet;
+		// Right after the NetworkEvent header
+		uint8* data;
+		size_t maxDataSize;
+	};
+
 	namespace Network
 	{
 		void init(bool isServer);
 
-		// TODO: Move this into it's own thread worker and process all network
-		// stuff on a dedicated thread
+		// Processes everything the network thread has received since the last update
 		void update();
 
+		// Allocates a packet with room for up to maxDataSizeInBytes of event data
+		EventPacket beginEvent(NetworkEventType eventType, size_t maxDataSizeInBytes, bool isReliable = true);
+		// Trims the packet down to the data that was written and sends it, the packet belongs to ENet after this.
+		// A null peer means the server on the client, and everyone on the server.
+		void sendEvent(ENetPeer* peer, EventPacket& eventPacket, size_t dataSizeInBytes, NetworkChannel channel = NetworkChannel::Events);
+
 		// TODO: Replace these with sized memory types and test
-		void sendServer(NetworkEventType eventType, void* data, size_t dataSizeInBytes, bool isReliable = true);
-		void sendClient(ENetPeer* peer, NetworkEventType eventType, void* data, size_t dataSizeInBytes, bool isReliable = true);
-		void broadcast(NetworkEventType eventType, void* data, size_t dataSizeInBytes, bool isReliable = true);
+		void sendServer(NetworkEventType eventType, void* data, size_t dataSizeInBytes, bool isReliable = true, NetworkChannel channel = NetworkChannel::Events);
+		void sendClient(ENetPeer* peer, NetworkEventType eventType, void* data, size_t dataSizeInBytes, bool isReliable = true, NetworkChannel channel = NetworkChannel::Events);
+		void broadcast(NetworkEventType eventType, void* data, size_t dataSizeInBytes, bool isReliable = true, NetworkChannel channel = NetworkChannel::Events);
 
 		// User/Client/Server Commands
-		void sendUserCommand(UserCommandType type, const SizedMemory& data, ENetPeer* peer = nullptr);
+		void sendUserCommand(UserCommandType type, const SizedMemory& data, ENetPeer* peer = nullptr, bool isReliable = false);
+		// Queues the transform, everything queued gets compressed and sent together on the next update
+		void sendTransform(Ecs::EntityId entity, const glm::vec3& position, const glm::vec3& orientation);
+		// Queues the command, everything queued for a peer gets sent in one packet on the next update.
+		// A null peer means the server on the client, and everyone on the server.
 		void sendClientCommand(ClientCommandType type, const SizedMemory& data, ENetPeer* peer = nullptr);
+		// Finds the command in a UserCommand event, returns false if its data would run past the end of the event
+		bool readUserCommand(uint8* data, size_t dataSize, UserCommand** command, void** commandData);
+		// Walks the commands in a ClientCommand event, returns false once there are none left or the data is malformed
+		bool readClientCommand(uint8* data, size_t dataSize, size_t* offset, ClientCommand** command, void** commandData);
+		// Forgets anything still queued for a peer that disconnected
+		void dropPendingCommands(ENetPeer* peer);
+
+		// How the commands above get framed, for code that drives its own ENet host like the load test bots.
+		// Allocates a packet holding the user command, it only needs handing to ENet after this.
+		EventPacket encodeUserCommand(UserCommandType type, uint64 timestamp, const SizedMemory& data, bool isReliable);
+		// Appends the command to a batch, an empty batch gets room for the NetworkEvent header first
+		void appendClientCommand(std::vector<uint8>& batch, ClientCommandType type, const SizedMemory& data);
+		// Fills in the batch's NetworkEvent header and copies it into a reliable packet. The batch is
+		// cleared but keeps its capacity.
+		ENetPacket* encodeClientCommandBatch(std::vector<uint8>& batch);
+		// Every command in a batch is padded to this so the next one's header stays aligned
+		size_t paddedCommandSize(size_t sizeOfData);
 
 		bool isLanServer();
 		bool isNetworkEnabled();
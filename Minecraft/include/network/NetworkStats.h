@@ -0,0 +1,57 @@
+#ifndef MINECRAFT_NETWORK_STATS_H
+#define MINECRAFT_NETWORK_STATS_H
+#include "core.h"
+#include "network/Network.h"
+
+typedef struct _ENetHost ENetHost;
+
+namespace Minecraft
+{
+	enum class NetworkDirection : uint8
+	{
+		Sent,
+		Received
+	};
+
+	// Packet sizes go in power of two buckets, anything 32Kb or bigger ends up in the last one
+	static constexpr int numPacketSizeBuckets = 16;
+	// Round trip times go in power of two millisecond buckets, 1ms up to 16s
+	static constexpr int numRoundTripBuckets = 15;
+
+	struct NetworkCounter
+	{
+		uint64 packets;
+		uint64 bytes;
+		uint64 sizeHistogram[numPacketSizeBuckets];
+	};
+
+	// What the traffic is made of, broken down by event, user command and client command type.
+	// Everything except the peer samples is recorded on the game thread.
+	namespace NetworkStats
+	{
+		// Records a whole packet, and every command inside it. A broadcast counts once per recipient.
+		void recordPacket(NetworkDirection direction, const uint8* data, size_t dataSize, uint32 numRecipients = 1);
+
+		// Network thread only. Reads ENet's own round trip, loss and queue stats for every connected
+		// peer, at most every few hundred milliseconds. The queue depth is passed in since ENet doesn't know it.
+		void samplePeers(ENetHost* host, uint32 queuedMessages);
+
+		const NetworkCounter& getEventCounter(NetworkDirection direction, NetworkEventType type);
+		const NetworkCounter& getUserCommandCounter(NetworkDirection direction, UserCommandType type);
+		const NetworkCounter& getClientCommandCounter(NetworkDirection direction, ClientCommandType type);
+		uint64 totalBytes(NetworkDirection direction);
+		uint64 totalPackets(NetworkDirection direction);
+
+		// From the last peer sample, averaged over the connected peers
+		float roundTripTime();
+		float packetLoss();
+		uint32 reliableBytesInFlight();
+		uint32 queuedMessages();
+
+		// One row per counter and one per round trip bucket. Returns false if the file couldn't be written.
+		bool dumpCsv(const char* filepath);
+		void reset();
+	}
+}
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef MINECRAFT_NETWORK_THREAD_H
+#define MINECRAFT_NETWORK_THREAD_H
+#include "core.h"
+#include "core/SpscQueue.hpp"
+#include "network/Network.h"
+
+typedef struct _ENetHost ENetHost;
+typedef struct _ENetPeer ENetPeer;
+typedef struct _ENetPacket ENetPacket;
+
+namespace Minecraft
+{
+	enum class NetworkMessageType : uint8
+	{
+		Connect,
+		Disconnect,
+		Receive
+	};
+
+	struct NetworkMessage
+	{
+		NetworkMessageType type;
+		ENetPeer* peer;
+		// Only set for Receive messages, the receiver destroys it once it's done with it
+		ENetPacket* packet;
+	};
+
+	struct OutgoingPacket
+	{
+		// Null sends the packet to every connected peer
+		ENetPeer* peer;
+		ENetPacket* packet;
+		NetworkChannel channel;
+	};
+
+	// Services an ENet host on its own thread so packets keep flowing no matter how long a
+	// frame takes. Everything that touches the host happens on that thread, the game thread
+	// only talks to it through the two queues.
+	class NetworkThread
+	{
+	public:
+		void start(ENetHost* host);
+		// Joins the thread, anything still queued is dropped
+		void stop();
+
+		// Game thread only. Takes ownership of the packet.
+		void send(ENetPeer* peer, ENetPacket* packet, NetworkChannel channel = NetworkChannel::Events);
+		// Game thread only. Returns false once there's nothing left to process.
+		bool poll(NetworkMessage* message);
+
+	private:
+		void run();
+		void pushIncoming(const NetworkMessage& message);
+
+	private:
+		ENetHost* host;
+		std::thread thread;
+		std::atomic<bool> isRunning;
+		SpscQueue<NetworkMessage> incoming;
+		SpscQueue<OutgoingPacket> outgoing;
+	};
+}
+
+#endif
@@ -1,6 +1,8 @@
 #ifndef MINECRAFT_SERVER_H
 #define MINECRAFT_SERVER_H
 #include "core.h"
+#include "core/Ecs.h"
+#include "network/Network.h"
 
 typedef struct _ENetPacket ENetPacket;
 typedef struct _ENetPeer ENetPeer;
@@ -13,13 +15,21 @@ namespace Minecraft
 
 		void update();
 
-		void broadcast(ENetPacket* packet);
+		void broadcast(ENetPacket* packet, NetworkChannel channel = NetworkChannel::Events);
 
-		void sendClient(ENetPeer* peer, ENetPacket* packet);
+		void sendClient(ENetPeer* peer, ENetPacket* packet, NetworkChannel channel = NetworkChannel::Events);
+
+		void queueTransform(Ecs::EntityId entity, const glm::vec3& position, const glm::vec3& orientation);
+
+		// The port the server host ended up bound to
+		uint16 getPort();
+
+		uint32 getNumConnectedClients();
 
 		void free();
 
 		constexpr uint16 listeningPort = 7317;
+		constexpr int maxClients = 32;
 		extern uint64 serverGameTime;
 	}
 }
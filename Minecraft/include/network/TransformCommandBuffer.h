@@ -2,6 +2,7 @@
 #define MINECRAFT_POSITION_COMMAND_BUFFER_H
 #include "core.h"
 #include "core/Ecs.h"
+#include "core/Pool.hpp"
 
 namespace Minecraft
 {
@@ -13,26 +14,50 @@ namespace Minecraft
 		glm::vec3 orientation;
 	};
 
-	struct TransformCommandBuffer
+	struct TransformSnapshot
 	{
-		UpdateTransformCommand* buffer;
-		int size;
-		int maxSize;
+		uint64 timestamp;
+		glm::vec3 position;
+		glm::vec3 orientation;
+	};
 
-		void init(int maxNumPositionCommands);
-		void free();
+	// The most recent snapshots of one entity, oldest first starting at head
+	struct TransformSnapshotRing
+	{
+		// About a second of updates at 60 updates per second
+		static constexpr uint32 capacity = 64;
 
-		void insert(const UpdateTransformCommand& command);
-		bool predict(uint64 lagCompensation, Ecs::EntityId entity, glm::vec3* position, glm::vec3* orientation);
+		TransformSnapshot snapshots[capacity];
+		uint32 head;
+		uint32 size;
 
-		inline UpdateTransformCommand& operator[](int index)
+		inline TransformSnapshot& operator[](uint32 index)
 		{
 #ifdef _DEBUG
-			g_logger_assert(index >= 0 && index < size, "Invalid index in command buffer '%d' out of '%d'", index, size);
+			g_logger_assert(index < size, "Invalid index in snapshot ring '%u' out of '%u'", index, size);
 #endif
-			return buffer[index];
+			return snapshots[(head + index) & (capacity - 1)];
 		}
 	};
+
+	// Keeps a ring of snapshots for every entity so inserting and finding an entity's history
+	// never has to look at anyone else's. The rings come out of a fixed pool.
+	struct TransformCommandBuffer
+	{
+		Pool<TransformSnapshotRing>* rings;
+		robin_hood::unordered_flat_map<Ecs::EntityId, TransformSnapshotRing*> entities;
+
+		void init(int maxNumEntities);
+		void free();
+
+		// Snapshots older than the newest one for the entity are dropped
+		void insert(const UpdateTransformCommand& command);
+		// Forgets the entity's history and gives its ring back to the pool
+		void remove(Ecs::EntityId entity);
+		// Where the entity was lagCompensation milliseconds ago. Interpolates between the snapshots
+		// around that time, or extrapolates a little past the newest one if nothing newer came in yet.
+		bool predict(uint64 lagCompensation, Ecs::EntityId entity, glm::vec3* position, glm::vec3* orientation);
+	};
 }
 
-#endif
\ No newline at end of file
+#endif
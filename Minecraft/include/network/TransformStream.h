@@ -0,0 +1,62 @@
+#ifndef MINECRAFT_TRANSFORM_STREAM_H
+#define MINECRAFT_TRANSFORM_STREAM_H
+#include "core.h"
+#include "core/Ecs.h"
+
+namespace Minecraft
+{
+	struct EntityTransform
+	{
+		Ecs::EntityId entity;
+		glm::vec3 position;
+		glm::vec3 orientation;
+	};
+
+	// Positions are sent in 1/64ths of a block and orientations in 1/65536ths of a turn. Every
+	// entity gets a keyframe every so often, which has to be sent reliably, and in between only
+	// the offset from that keyframe gets sent unreliably. Keyframes and deltas go out on the same
+	// ENet channel so a delta can never arrive before the keyframe it's relative to.
+	struct TransformEncoder
+	{
+		struct EntityState
+		{
+			glm::ivec3 keyframePosition;
+			glm::ivec3 lastPosition;
+			glm::u16vec3 lastOrientation;
+			uint8 keyframeId;
+			uint16 updatesSinceKeyframe;
+		};
+
+		robin_hood::unordered_flat_map<Ecs::EntityId, EntityState> entities;
+
+		// Writes every transform that changed since it was last sent. Both buffers are cleared
+		// first and are left empty if there's nothing to send.
+		void encode(const std::vector<EntityTransform>& transforms, std::vector<uint8>& keyframeData, std::vector<uint8>& deltaData);
+		// Writes the entities the receiver should stop tracking, this has to be sent reliably too
+		void remove(const std::vector<Ecs::EntityId>& leftEntities, std::vector<uint8>& leaveData);
+	};
+
+	struct TransformDecoder
+	{
+		struct EntityState
+		{
+			glm::ivec3 keyframePosition;
+			glm::vec3 lastOrientation;
+			uint8 keyframeId;
+		};
+
+		robin_hood::unordered_flat_map<Ecs::EntityId, EntityState> entities;
+
+		// Returns false if the data is malformed. Deltas against a keyframe we never got are skipped
+		// and entities that left are forgotten.
+		bool decode(const uint8* data, size_t dataSize, std::vector<EntityTransform>& transforms);
+	};
+
+	namespace TransformStream
+	{
+		// What a transform cost on the wire before it was compressed, used for the bandwidth stats
+		size_t uncompressedSize();
+	}
+}
+
+#endif
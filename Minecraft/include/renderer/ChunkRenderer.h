@@ -0,0 +1,27 @@
+#ifndef MINECRAFT_CHUNK_RENDERER_H
+#define MINECRAFT_CHUNK_RENDERER_H
+#include "core.h"
+#include "core/Pool.hpp"
+
+namespace Minecraft
+{
+	struct Shader;
+	struct SubChunk;
+	class Frustum;
+
+	// Everything the chunk manager needs from the GPU. The dedicated server never touches
+	// any of this, so it can run without a GL context.
+	namespace ChunkRenderer
+	{
+		// Points every sub-chunk at its own slice of one persistently mapped vertex buffer
+		void init(Pool<SubChunk>& subChunks);
+		void free();
+
+		// Queues the sub-chunk to be drawn this frame if it's inside the frustum
+		void addSubChunk(const SubChunk& subChunk, const glm::ivec2& playerPositionInChunkCoords, const Frustum& cameraFrustum);
+		// Draws everything that was queued since the last call
+		void render(const glm::vec3& playerPosition, const glm::ivec2& playerPositionInChunkCoords, Shader& opaqueShader, Shader& transparentShader);
+	}
+}
+
+#endif
@@ -13,6 +13,10 @@ namespace Minecraft
 		extern glm::vec3 playerOrientation;
 		extern std::atomic<float> totalChunkRamUsed;
 		extern float totalChunkRamAvailable;
+		extern std::atomic<uint32> cancelledChunkCommands;
+		// What the transforms we sent took on the wire, next to what they would have taken uncompressed
+		extern std::atomic<uint64> transformBytesSent;
+		extern std::atomic<uint64> transformBytesUncompressed;
 		extern Block blockLookingAt;
 		extern Block airBlockLookingAt;
 
@@ -11,6 +11,36 @@ namespace Minecraft
 			extern glm::vec4 clearColor;
 			extern const char* title;
 		}
+
+		namespace Chunks
+		{
+			// How much memory compressed chunks in the standby cache are allowed to use, in bytes
+			extern size_t standbyCacheBudget;
+			// How much memory chunks streamed from a server are allowed to use once they're kept around for reconnects, in bytes
+			extern size_t clientCacheBudget;
+		}
+
+		namespace Network
+		{
+			// How long the network thread waits on the socket for something to come in before it
+			// checks for packets to send again, in milliseconds
+			extern uint32 serviceTimeoutMs;
+		}
+
+		namespace Server
+		{
+			// World the dedicated server hosts when none is passed on the command line
+			extern const char* defaultWorldName;
+			// How many times a second the dedicated server updates the world
+			extern uint32 ticksPerSecond;
+			// Players the dedicated server lets in at once. Every one of them can load a full chunk radius
+			// when they spread out, and a chunk's blocks take 512Kb, so this caps the server's memory.
+			extern uint32 maxPlayers;
+			// Simulated clients the server connects to itself for a load test, 0 turns it off
+			extern uint32 loadTestBots;
+			// How long a load test runs before the server reports and shuts down, in seconds
+			extern uint32 loadTestSeconds;
+		}
 	}
 }
 
@@ -27,12 +27,31 @@ namespace Minecraft
 		ChunkState state;
 		bool needsToGenerateDecorations;
 		bool needsToCalculateLighting;
+		// Only touched on the main thread, keeps us from queueing the same stage twice
+		bool decorationsQueued;
+		bool lightingQueued;
+		// Bumped every time the block ids change. The chunk only needs to be written to
+		// disk if it has changed since the last save.
+		uint32 modifiedEpoch;
+		uint32 savedEpoch;
+		// Bumped when a cancelled chunk gets queued again, commands queued before that get dropped
+		uint32 loadGeneration;
 
 		Chunk* topNeighbor;
 		Chunk* bottomNeighbor;
 		Chunk* leftNeighbor;
 		Chunk* rightNeighbor;
 
+		inline void markModified()
+		{
+			modifiedEpoch++;
+		}
+
+		inline bool isDirty() const
+		{
+			return modifiedEpoch != savedEpoch;
+		}
+
 		inline bool operator==(const Chunk& other) const
 		{
 			return chunkCoords == other.chunkCoords;
@@ -53,7 +72,7 @@ namespace Minecraft
 			return !(*this == other);
 		}
 
-		RawMemory serialize() const;
+		void serialize(RawMemory& memory) const;
 		void deserialize(RawMemory& memory);
 
 		struct HashFunction
@@ -69,10 +88,11 @@ namespace Minecraft
 	namespace ChunkPrivate
 	{
 		void generateTerrain(Chunk* chunk, const glm::ivec2& chunkCoordinates, float seed);
-		void generateDecorations(const glm::ivec2& lastPlayerLoadPosChunkCoords, float seed);
+		void generateDecorations(Chunk* chunk, uint32 seed);
 		// Must guarantee at least 16 sub-chunks located at this address
 		void generateRenderData(Pool<SubChunk>* subChunks, const Chunk* chunk, const glm::ivec2& chunkCoordinates, bool isRetesselation=false);
-		void calculateLighting(const glm::ivec2& lastPlayerLoadPosChunkCoords);
+		void calculateSkyLighting(Chunk* chunk);
+		void calculateLighting(Chunk* chunk);
 		void calculateLightingUpdate(Chunk* chunk, const glm::ivec2& chunkCoordinates, const glm::vec3& blockPosition, bool removedLightSource, robin_hood::unordered_flat_set<Chunk*>& chunksToRetesselate);
 
 		Block getLocalBlock(const glm::ivec3& localPosition, const glm::ivec2& chunkCoordinates, const Chunk* blockData);
@@ -0,0 +1,44 @@
+#ifndef MINECRAFT_CHUNK_CODEC_H
+#define MINECRAFT_CHUNK_CODEC_H
+#include "core.h"
+#include "world/World.h"
+
+namespace Minecraft
+{
+	struct Block;
+
+	// Encodes a chunk's block ids for saves and for sending over the network. The chunk is split
+	// into 16 block tall sections and each section stores a palette of the ids it uses followed
+	// by the palette indices bit-packed into 64 bit words.
+	namespace ChunkCodec
+	{
+		constexpr uint8 CurrentVersion = 1;
+		constexpr int SectionHeight = 16;
+		constexpr int BlocksPerSection = World::ChunkWidth * World::ChunkDepth * SectionHeight;
+		constexpr int NumSections = World::ChunkHeight / SectionHeight;
+		constexpr int MaxPaletteSize = 256;
+
+		// Worst case is a section with more than MaxPaletteSize ids, which stores every id as is
+		constexpr size_t maxEncodedSize = sizeof(uint8) * 2 + sizeof(int32) * 2 +
+			NumSections * (sizeof(uint8) + sizeof(uint16) * BlocksPerSection);
+
+		// Returns the number of bytes written, or 0 if dst is too small
+		size_t encode(const Block* blocks, const glm::ivec2& chunkCoords, uint8* dst, size_t dstSize);
+		// Never trusts the data, returns false instead of reading out of bounds if it's malformed.
+		// Also reads chunks saved in the old run length format that had no version header.
+		bool decode(const uint8* data, size_t dataSize, Block* blocks, glm::ivec2* chunkCoords);
+		// Reads which chunk the data is for without decoding any of the blocks
+		bool peekChunkCoords(const uint8* data, size_t dataSize, glm::ivec2* chunkCoords);
+		// Hash of the encoded data. Encoding the same blocks always gives the same bytes, so two
+		// copies of a chunk with the same version hold the same blocks.
+		uint64 contentVersion(const uint8* data, size_t dataSize);
+
+		// Index of the first block after start with a different id than blocks[start], or end if the
+		// run goes all the way. Checks four blocks at a time with SSE2 when it's available.
+		int findRunEnd(const Block* blocks, int start, int end);
+		// Same thing one block at a time, the self tests hold the SSE2 path to its answers
+		int findRunEndScalar(const Block* blocks, int start, int end);
+	}
+}
+
+#endif
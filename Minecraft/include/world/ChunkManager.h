@@ -3,6 +3,7 @@
 #include "core.h"
 #include "core/Pool.hpp"
 #include "world/World.h"
+#include "world/RegionFile.h"
 
 namespace Minecraft
 {
@@ -50,6 +51,11 @@ namespace Minecraft
 		void free();
 		void serialize();
 		void serializeSynchronous();
+		// Reads a batch of saved chunks straight out of their region files, see RegionFile::readChunks
+		void readSavedChunks(const std::vector<glm::ivec2>& chunkCoords, RegionChunkCallback callback, void* userData);
+		void flushSaves();
+		// Reads saved chunks a couple of rings ahead of where the player is heading into the standby cache
+		void prefetchAhead(const glm::vec3& playerPosition, const glm::vec3& playerVelocity);
 
 		robin_hood::unordered_node_map<glm::ivec2, Chunk>& getAllChunks();
 
@@ -63,19 +69,26 @@ namespace Minecraft
 
 		void patchChunkPointers();
 		void beginWork();
-		void wakeUpCv2();
 		void setPlayerChunkPos(const glm::ivec2& playerChunkPos);
 
 		void queueCommand(FillChunkCommand& command);
-		void queueClientLoadChunk(void* chunkData, const glm::ivec2& chunkCoordinates, ChunkState state);
+		// Takes the chunk still compressed with ChunkCodec, it gets decoded on a worker thread. Returns
+		// false if the chunk couldn't be loaded, the caller still owns compressedData in that case.
+		// A chunk that's already loaded keeps the copy it has.
+		bool queueClientLoadChunk(uint8* compressedData, size_t compressedDataSize, const glm::ivec2& chunkCoordinates, ChunkState state);
 		void queueGenerateDecorations(const glm::ivec2& lastPlayerLoadChunkPos);
 		void queueCalculateLighting(const glm::ivec2& lastPlayerPosInChunkCoords);
+		// Lights chunks streamed from the server once all their neighbors have arrived, or all of them
+		// once the server has nothing left to send
+		void queueStreamedChunkLighting(bool streamCaughtUp);
 		void queueCreateChunk(const glm::ivec2& chunkCoordinates);
 		void queueSaveChunk(const glm::ivec2& chunkCoordinates);
 		void queueRecalculateLighting(const glm::ivec2& chunkCoordinates, const glm::vec3& blockPositionThatUpdated, bool removedLightSource);
 		void queueRetesselateChunk(const glm::ivec2& chunkCoordinates, Chunk* chunk = nullptr);
 		void render(const glm::vec3& playerPosition, const glm::ivec2& playerPositionInChunkCoords, Shader& opaqueShader, Shader& transparentShader, const Frustum& cameraFrustum);
 		void checkChunkRadius(const glm::vec3& playerPosition, bool isClient=false);
+		// Keeps every chunk within the chunk radius of any of the positions loaded, nearest chunks get loaded first
+		void checkChunkRadius(const std::vector<glm::vec3>& loadPositions, bool isClient=false);
 	}
 }
 
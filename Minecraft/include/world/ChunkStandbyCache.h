@@ -0,0 +1,35 @@
+#ifndef MINECRAFT_CHUNK_STANDBY_CACHE_H
+#define MINECRAFT_CHUNK_STANDBY_CACHE_H
+#include "core.h"
+
+namespace Minecraft
+{
+	struct Block;
+
+	// Chunks that aren't loaded but will probably be needed soon, either because the player is
+	// heading towards them or because they were just unloaded. They're kept in their ChunkCodec
+	// encoded form and the least recently used ones get dropped once the cache goes over
+	// Settings::Chunks::standbyCacheBudget. A chunk gets promoted into a blockPool slab when it's
+	// actually loaded.
+	namespace ChunkStandbyCache
+	{
+		// Marks the chunk as being read in the background. Returns false if it's already
+		// cached or on its way.
+		bool beginPrefetch(const glm::ivec2& chunkCoords);
+		// Only takes the data if the prefetch wasn't cancelled in the meantime
+		void finishPrefetch(const glm::ivec2& chunkCoords, const uint8* encodedData, size_t encodedSize);
+		// Forgets a prefetch that never got its data, so the chunk can be read ahead again later
+		void cancelPrefetch(const glm::ivec2& chunkCoords);
+		// Encodes a chunk that's being unloaded, replacing any older copy
+		void insert(const glm::ivec2& chunkCoords, const Block* blocks);
+
+		// Decodes the chunk into blocks and drops it from the cache. Returns false on a miss.
+		bool take(const glm::ivec2& chunkCoords, Block* blocks);
+		void clear();
+
+		size_t numChunks();
+		size_t memoryUsed();
+	}
+}
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef MINECRAFT_CHUNK_THREAD_WORKER_H
 #define MINECRAFT_CHUNK_THREAD_WORKER_H
 #include "core.h"
+#include "core/ObjectPool.hpp"
 // TODO: Remove this by getting rid of Pool type
 #include "world/ChunkManager.h"
 
@@ -12,9 +13,11 @@ namespace Minecraft
 		ClientLoadChunk,
 		GenerateTerrain,
 		GenerateDecorations,
+		CalculateSkyLighting,
 		CalculateLighting,
 		RecalculateLighting,
-		TesselateVertices
+		TesselateVertices,
+		Length
 	};
 
 	struct FillChunkCommand
@@ -22,12 +25,28 @@ namespace Minecraft
 		// Must be at least ChunkWidth * ChunkDepth * ChunkHeight blocks available
 		Chunk* chunk;
 		Pool<SubChunk>* subChunks;
+		// The load position nearest to this chunk, kept up to date by the worker
 		glm::ivec2 playerPosChunkCoords;
 		CommandType type;
 		glm::vec3 blockThatUpdated;
 		bool removedLightSource;
 		bool isRetesselating;
-		void* clientChunkData;
+		// Compressed with ChunkCodec, the worker owns it and frees it once it's decoded
+		uint8* clientChunkData;
+		size_t clientChunkDataSize;
+		// The chunk's load generation when this was queued
+		uint32 loadGeneration;
+	};
+
+	// A node in the chunk task graph. Every command is attached to a single chunk, and
+	// the worker wires it to any pending commands on that chunk or its neighbors that
+	// touch the same block data. A task is dispatched once numDependencies hits 0.
+	struct ChunkTask
+	{
+		FillChunkCommand command;
+		class ChunkThreadWorker* worker;
+		std::vector<ChunkTask*> dependents;
+		uint32 numDependencies;
 	};
 
 	struct CompareFillChunkCommand
@@ -36,6 +55,12 @@ namespace Minecraft
 		bool operator()(const FillChunkCommand& a, const FillChunkCommand& b) const;
 	};
 
+	struct CompareChunkTask
+	{
+		// Returning true means lesser priority
+		bool operator()(const ChunkTask* a, const ChunkTask* b) const;
+	};
+
 	class ChunkThreadWorker
 	{
 	public:
@@ -44,26 +69,65 @@ namespace Minecraft
 		void free();
 
 		void threadWorker();
+		void ioWorker();
 		void queueCommand(FillChunkCommand& command);
 
+		// Releases every command queued since the last call to the thread worker
 		void beginWork(bool notifyAll = true);
-		void wakeupCv2();
+		// Blocks until every queued save has been written to disk
+		void flushSaves();
+		// Moves the local player's load position, the first one, and re-prioritizes every ready command against it
 		void setPlayerPosChunkCoords(const glm::ivec2& playerPosChunkCoords);
+		// Same as above for every position chunks get loaded around, like each player on a server.
+		// Commands are ordered by the nearest position and only cancelled once they're out of range of all of them
+		void setLoadPositions(const std::vector<glm::ivec2>& loadChunkCoords);
 
 		float percentDone();
+		bool hasPendingWork(const glm::ivec2& chunkCoords);
+
+		void completeTask(ChunkTask* task);
+
+	private:
+		void addDependencies(ChunkTask* task);
+		void pushReadyTask(ChunkTask* task);
+		bool shouldCancel(ChunkTask* task);
+		void reprioritizeReadyTasks();
+		glm::ivec2 nearestLoadPosition(const glm::ivec2& chunkCoords) const;
+		void dispatchTask(ChunkTask* task);
 
 	private:
-		std::priority_queue<FillChunkCommand, std::vector<FillChunkCommand>, CompareFillChunkCommand> commands;
+		struct ChunkTaskStages
+		{
+			// The most recently queued task for each stage that hasn't completed yet
+			ChunkTask* pending[(uint8)CommandType::Length];
+		};
+
+		robin_hood::unordered_flat_map<glm::ivec2, ChunkTaskStages> pendingStages;
+		robin_hood::unordered_flat_set<ChunkTask*> allTasks;
+		ObjectPool<ChunkTask> taskPool;
+		std::vector<ChunkTask*> stagedTasks;
+		// A heap ordered by CompareChunkTask, kept as a plain vector so it can be re-ordered in place
+		std::vector<ChunkTask*> readyTasks;
+		uint32 numTasksInFlight;
+
+		// Saves run on their own thread so disk writes never hold up the rest of the pipeline. They
+		// don't depend on each other, so these are just stacks with their capacity reserved up front.
+		static const uint32 maxSavesInFlight = 16;
+		std::vector<ChunkTask*> readySaves;
+		std::vector<ChunkTask*> ioQueue;
+		uint32 numSavesInFlight;
+		uint32 numSavesPending;
+
 		std::thread workerThread;
-		std::atomic<glm::ivec2> playerPosChunkCoords;
+		std::thread ioThread;
+		// Guarded by graphMtx
+		std::vector<glm::ivec2> loadPositions;
 		std::condition_variable cv;
-		std::condition_variable cv2;
-		std::mutex mtx;
-		std::mutex queueMtx;
+		std::condition_variable ioCv;
+		std::mutex graphMtx;
 		bool doWork;
-		std::atomic<bool> waitingOnCommand = false;
 		float initialSize = -1.0f;
 	};
 }
 
-#endif 
\ No newline at end of file
+#endif
\ No newline at end of file
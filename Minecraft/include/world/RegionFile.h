@@ -0,0 +1,40 @@
+#ifndef MINECRAFT_REGION_FILE_H
+#define MINECRAFT_REGION_FILE_H
+#include "core.h"
+
+namespace Minecraft
+{
+	typedef void (*RegionChunkCallback)(const glm::ivec2& chunkCoords, RawMemory& memory, void* userData);
+
+	// Chunks are saved in region files that each hold RegionWidth x RegionWidth chunks. A region
+	// starts with a table of where every chunk lives in the file, followed by the chunk data
+	// stored in fixed size sectors.
+	namespace RegionFile
+	{
+		constexpr int RegionWidth = 32;
+
+		// Writes go to fresh sectors and stay invisible on disk until the next commit
+		bool writeChunk(const std::string& chunkSavePath, const glm::ivec2& chunkCoords, const uint8* data, size_t dataSize);
+		// Makes every write since the last commit durable with one journaled fsync group
+		void commit(const std::string& chunkSavePath);
+		// Finishes a commit that was interrupted by a crash. Call before opening any regions.
+		void recoverJournal(const std::string& chunkSavePath);
+		// Reads go straight out of a read-only mapping of the region file. The memory passed to the
+		// callback points into the mapping, so it's only valid for the duration of the callback and
+		// must never be written to.
+		bool readChunk(const std::string& chunkSavePath, const glm::ivec2& chunkCoords, RegionChunkCallback callback, void* userData);
+		// Reads every chunk that exists out of the list, one region at a time in file order
+		void readChunks(const std::string& chunkSavePath, const std::vector<glm::ivec2>& chunkCoords, RegionChunkCallback callback, void* userData);
+		// Asks the OS to start paging these chunks in before anyone reads them
+		void prefetchChunks(const std::string& chunkSavePath, const std::vector<glm::ivec2>& chunkCoords);
+		bool chunkExists(const std::string& chunkSavePath, const glm::ivec2& chunkCoords);
+
+		glm::ivec2 toRegionCoords(const glm::ivec2& chunkCoords);
+
+		// Moves every chunk saved in the old one file per chunk format into region files
+		void convertChunkFiles(const std::string& chunkSavePath);
+		void closeAll();
+	}
+}
+
+#endif
@@ -16,6 +16,8 @@ namespace Minecraft
 		void reloadShaders();
 		void regenerateWorld();
 		void update(Frustum& cameraFrustum, const Texture& worldTexture);
+		// Ticks the world without a local player or anything to draw, used by the dedicated server
+		void serverUpdate();
 		void serialize();
 		bool deserialize();
 
@@ -35,9 +37,18 @@ namespace Minecraft
 		Ecs::EntityId getLocalPlayer();
 		void setLocalPlayer(Ecs::EntityId localPlayer);
 		Ecs::EntityId createPlayer(const char* playerName, const glm::vec3& position);
+		// New players spawn next to the local player, or at the world spawn if there isn't one
+		glm::vec3 getSpawnPosition();
 
 		const uint16 ChunkRadius = 12;
 		const uint16 ChunkCapacity = (uint16)((ChunkRadius * 2) * (ChunkRadius * 2) * 1.5f);
+		// Clients keep streamed chunks this many chunks past ChunkRadius so walking back and forth over
+		// a chunk border doesn't resend them. The server forgets what it sent one chunk further out.
+		const uint16 StreamUnloadMargin = 2;
+		// How many chunks can be loaded at once. That's ChunkCapacity for a client, which only loads
+		// around its own player. The dedicated server could need a full radius for every player it lets
+		// in, but it only starts with ChunkCapacity and grows towards this as the players spread out.
+		uint32 getChunkCapacity();
 
 		const uint16 ChunkWidth = 16;
 		const uint16 ChunkDepth = 16;
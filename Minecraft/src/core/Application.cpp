@@ -11,6 +11,7 @@
 #include "renderer/Shader.h"
 #include "renderer/Sprites.h"
 #include "physics/Physics.h"
+#include "network/LoadTest.h"
 #include "input/Input.h"
 #include "input/KeyBindings.h"
 #include "utils/Constants.h"
@@ -18,6 +19,9 @@
 #include "gui/Gui.h"
 #include "gui/GuiElements.h"
 
+#include <chrono>
+#include <csignal>
+
 namespace Minecraft
 {
 	namespace Application
@@ -38,6 +42,82 @@ namespace Minecraft
 		static void freeWindow();
 		static void freeRegistry();
 
+#ifdef _HEADLESS
+		static std::atomic<bool> isRunning = false;
+
+		static void stopRunning(int signal);
+
+		void init()
+		{
+			// No window or GL context here, just enough to simulate the world and serve it
+			globalThreadPool = new GlobalThreadPool(std::thread::hardware_concurrency());
+			AppData::init();
+			Ecs::Registry& registry = getRegistry();
+			Physics::init();
+			Scene::init(SceneType::DedicatedServer, registry);
+			if (Settings::Server::loadTestBots > 0)
+			{
+				LoadTest::start(Settings::Server::loadTestBots, Settings::Server::loadTestSeconds);
+			}
+
+			// Ctrl+C shuts down cleanly so the world still gets saved
+			std::signal(SIGINT, stopRunning);
+			std::signal(SIGTERM, stopRunning);
+			isRunning = true;
+		}
+
+		void run()
+		{
+			using Clock = std::chrono::steady_clock;
+			const Clock::duration tickDuration = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / (double)Settings::Server::ticksPerSecond));
+			Clock::time_point previousTime = Clock::now();
+			Clock::time_point nextTick = previousTime;
+			while (isRunning)
+			{
+#ifdef _USE_OPTICK
+				OPTICK_FRAME("Main Thread");
+				OPTICK_EVENT();
+#endif
+
+				Clock::time_point currentTime = Clock::now();
+				deltaTime = std::chrono::duration<float>(currentTime - previousTime).count();
+				previousTime = currentTime;
+
+				Scene::update();
+				LoadTest::recordTick(std::chrono::duration<float>(Clock::now() - currentTime).count());
+				if (LoadTest::isFinished())
+				{
+					isRunning = false;
+				}
+
+				// Nothing to draw, so sleep off whatever is left of the tick
+				nextTick += tickDuration;
+				if (nextTick < Clock::now())
+				{
+					// Don't try to catch up after a slow tick, it would just make the next one slow too
+					nextTick = Clock::now();
+				}
+				std::this_thread::sleep_until(nextTick);
+			}
+
+			g_logger_info("Shutting down the server.");
+		}
+
+		void free()
+		{
+			// The bots have to hang up before the server goes away
+			LoadTest::stop();
+
+			// Important: Scene gets freed first so that it queues all saving tasks to the global thread pool.
+			// Then we can free the global thread pool which will finish those tasks
+			Scene::free();
+			globalThreadPool->free();
+			delete globalThreadPool;
+
+			getRegistry().free();
+			freeRegistry();
+		}
+#else
 		void init()
 		{
 			// Initialize GLFW/Glad
@@ -252,6 +332,7 @@ namespace Minecraft
 			freeWindow();
 			freeRegistry();
 		}
+#endif
 
 		Window& getWindow()
 		{
@@ -293,5 +374,12 @@ namespace Minecraft
 			registry.free();
 			delete& registry;
 		}
+
+#ifdef _HEADLESS
+		static void stopRunning(int signal)
+		{
+			isRunning = false;
+		}
+#endif
 	}
 }
\ No newline at end of file
@@ -0,0 +1,34 @@
+#include "core/Arena.hpp"
+
+#include <cstdlib>
+#include <new>
+
+#ifdef _DEBUG
+// Counts every allocation made while a thread is running chunk pipeline work, so anything that
+// sneaks onto the heap shows up in MemoryStats::heapAllocations and not only arena and pool growth.
+// The array and nothrow versions all end up in here.
+void* operator new(std::size_t size)
+{
+	if (Minecraft::MemoryStats::isPipelineThread)
+	{
+		Minecraft::MemoryStats::heapAllocations++;
+	}
+
+	void* ptr = std::malloc(size == 0 ? 1 : size);
+	if (!ptr)
+	{
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+	std::free(ptr);
+}
+#endif
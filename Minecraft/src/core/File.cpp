@@ -6,6 +6,7 @@
 #include <shellapi.h>
 #include <shobjidl_core.h>
 #include <shlobj.h>
+#include <io.h>
 
 namespace Minecraft
 {
@@ -59,6 +60,34 @@ namespace Minecraft
 			return true;
 		}
 
+		bool replaceFile(const char* from, const char* to)
+		{
+			if (!MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+			{
+				g_logger_error("Replace file failed with %d", GetLastError());
+				return false;
+			}
+
+			return true;
+		}
+
+		bool syncFile(FILE* fp)
+		{
+			if (fflush(fp) != 0)
+			{
+				return false;
+			}
+
+			HANDLE fileHandle = (HANDLE)_get_osfhandle(_fileno(fp));
+			if (!FlushFileBuffers(fileHandle))
+			{
+				g_logger_error("Flush file buffers failed with %d", GetLastError());
+				return false;
+			}
+
+			return true;
+		}
+
 		bool createDirIfNotExists(const char* directoryName)
 		{
 			DWORD fileAttrib = GetFileAttributesA(directoryName);
@@ -121,6 +150,73 @@ namespace Minecraft
 			CloseHandle(fileHandle);
 			return res;
 		}
+
+		MappedFile mapFileReadOnly(const char* filepath)
+		{
+			MappedFile res = { nullptr, 0, nullptr };
+
+			// Other handles still need to be able to write to the file while it's mapped
+			HANDLE fileHandle = CreateFileA(filepath, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+			if (fileHandle == INVALID_HANDLE_VALUE)
+			{
+				g_logger_error("Could not map file '%s'. Failed to open file.", filepath);
+				return res;
+			}
+
+			LARGE_INTEGER fileSize;
+			if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+			{
+				CloseHandle(fileHandle);
+				return res;
+			}
+
+			HANDLE mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+			// The mapping keeps its own reference to the file
+			CloseHandle(fileHandle);
+			if (!mappingHandle)
+			{
+				g_logger_error("Could not map file '%s'. Failed with '%d'", filepath, GetLastError());
+				return res;
+			}
+
+			void* data = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+			if (!data)
+			{
+				g_logger_error("Could not map view of file '%s'. Failed with '%d'", filepath, GetLastError());
+				CloseHandle(mappingHandle);
+				return res;
+			}
+
+			res.data = (const uint8*)data;
+			res.size = (size_t)fileSize.QuadPart;
+			res.mappingHandle = mappingHandle;
+			return res;
+		}
+
+		void unmapFile(MappedFile& file)
+		{
+			if (file.data)
+			{
+				UnmapViewOfFile(file.data);
+				CloseHandle((HANDLE)file.mappingHandle);
+			}
+			file = { nullptr, 0, nullptr };
+		}
+
+		void prefetchMappedRange(const MappedFile& file, size_t offset, size_t size)
+		{
+#if _WIN32_WINNT >= _WIN32_WINNT_WIN8
+			if (!file.data || offset >= file.size)
+			{
+				return;
+			}
+
+			WIN32_MEMORY_RANGE_ENTRY range;
+			range.VirtualAddress = (PVOID)(file.data + offset);
+			range.NumberOfBytes = glm::min(size, file.size - offset);
+			PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#endif
+		}
 	}
 }
 
@@ -128,6 +224,8 @@ namespace Minecraft
 #elif defined(__linux__) 
 #include <dirent.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <string.h>
 #include <unistd.h>
 #include <pwd.h>
@@ -211,6 +309,28 @@ namespace Minecraft
 			return rename(from, to) == 0;
 		}
 
+		bool replaceFile(const char* from, const char* to)
+		{
+			// rename already replaces the destination atomically
+			return rename(from, to) == 0;
+		}
+
+		bool syncFile(FILE* fp)
+		{
+			if (fflush(fp) != 0)
+			{
+				return false;
+			}
+
+			if (fsync(fileno(fp)) != 0)
+			{
+				g_logger_error("fsync failed with %d", errno);
+				return false;
+			}
+
+			return true;
+		}
+
 		bool createDirIfNotExists(const char* directoryName)
 		{
 			if (!isDir(directoryName)) 
@@ -274,6 +394,61 @@ namespace Minecraft
 
 			return { UINT64_MAX, UINT64_MAX, UINT64_MAX };
 		}
+
+		MappedFile mapFileReadOnly(const char* filepath)
+		{
+			MappedFile res = { nullptr, 0, nullptr };
+
+			int fd = open(filepath, O_RDONLY);
+			if (fd == -1)
+			{
+				g_logger_error("Could not map file '%s'. Failed to open file.", filepath);
+				return res;
+			}
+
+			struct stat attr;
+			if (fstat(fd, &attr) != 0 || attr.st_size == 0)
+			{
+				close(fd);
+				return res;
+			}
+
+			void* data = mmap(nullptr, (size_t)attr.st_size, PROT_READ, MAP_SHARED, fd, 0);
+			// The mapping keeps its own reference to the file
+			close(fd);
+			if (data == MAP_FAILED)
+			{
+				g_logger_error("Could not map file '%s'. Failed with '%d'", filepath, errno);
+				return res;
+			}
+
+			res.data = (const uint8*)data;
+			res.size = (size_t)attr.st_size;
+			return res;
+		}
+
+		void unmapFile(MappedFile& file)
+		{
+			if (file.data)
+			{
+				munmap((void*)file.data, file.size);
+			}
+			file = { nullptr, 0, nullptr };
+		}
+
+		void prefetchMappedRange(const MappedFile& file, size_t offset, size_t size)
+		{
+			if (!file.data || offset >= file.size)
+			{
+				return;
+			}
+
+			// madvise wants a page aligned address
+			size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+			size_t alignedOffset = offset - (offset % pageSize);
+			size_t length = glm::min(size, file.size - offset) + (offset - alignedOffset);
+			madvise((void*)(file.data + alignedOffset), length, MADV_WILLNEED);
+		}
 	}
 }
 
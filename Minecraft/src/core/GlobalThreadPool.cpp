@@ -15,6 +15,12 @@ namespace Minecraft
 	GlobalThreadPool::GlobalThreadPool(uint32 numThreads)
 		: cv(), queueMtx(), generalMtx(), doWork(true), numThreads(numThreads)
 	{
+		// The chunk workers queue onto this from their own threads, so the queue gets enough room up
+		// front that it doesn't have to grow while they're running
+		std::vector<ThreadTask> taskStorage;
+		taskStorage.reserve(initialTaskCapacity);
+		tasks = std::priority_queue<ThreadTask, std::vector<ThreadTask>, CompareThreadTask>(CompareThreadTask(), std::move(taskStorage));
+
 		workerThreads = new std::thread[numThreads];
 		for (uint32 i = 0; i < numThreads; i++)
 		{
@@ -61,6 +61,7 @@ namespace Minecraft
 			TexturePacker::packTextures("assets/images/block", "assets/generated/textureFormat.yaml", packedTexturesFilepath, "Blocks", true);
 			TexturePacker::packTextures("assets/images/item", "assets/generated/itemTextureFormat.yaml", packedItemTexturesFilepath, "Items");
 			BlockMap::loadBlocks("assets/generated/textureFormat.yaml", "assets/generated/itemTextureFormat.yaml", "assets/custom/blockFormats.yaml");
+#ifndef _HEADLESS
 			BlockMap::uploadTextureCoordinateMapToGpu();
 
 			worldTexture = TextureBuilder()
@@ -98,6 +99,7 @@ namespace Minecraft
 				.bindTextureObject()
 				.generate(true);
 			BlockMap::patchBlockItemTextureMaps(&blockItemTexture);
+#endif
 			BlockMap::loadCraftingRecipes("assets/custom/craftingRecipes.yaml");
 
 			registry = &inRegistry;
@@ -107,7 +109,9 @@ namespace Minecraft
 
 		void update()
 		{
+#ifndef _HEADLESS
 			Gui::beginFrame();
+#endif
 
 			// Process events and open the event file if needed
 			if (serializedEventFile == nullptr && (serializeEvents || playFromEventFile))
@@ -156,6 +160,9 @@ namespace Minecraft
 			case SceneType::MainMenu:
 				MainMenu::update();
 				break;
+			case SceneType::DedicatedServer:
+				World::serverUpdate();
+				break;
 			case SceneType::None:
 				break;
 			default:
@@ -163,7 +170,9 @@ namespace Minecraft
 				break;
 			}
 
+#ifndef _HEADLESS
 			Renderer::render();
+#endif
 
 			queueMainEvent(GEventType::FrameTick, nullptr, 0, false);
 
@@ -184,12 +193,14 @@ namespace Minecraft
 
 		void free(bool freeGlobalResources)
 		{
+#ifndef _HEADLESS
 			if (freeGlobalResources)
 			{
 				worldTexture.destroy();
 				itemTexture.destroy();
 				blockItemTexture.destroy();
 			}
+#endif
 
 			if (serializedEventFile)
 			{
@@ -207,6 +218,7 @@ namespace Minecraft
 			case SceneType::SinglePlayerGame:
 			case SceneType::LocalLanGame:
 			case SceneType::MultiplayerGame:
+			case SceneType::DedicatedServer:
 				World::free();
 				break;
 			case SceneType::MainMenu:
@@ -367,7 +379,9 @@ namespace Minecraft
 			registry->registerComponent<CharacterController>("CharacterController");
 			registry->registerComponent<Inventory>("Inventory");
 			registry->registerComponent<PlayerComponent>("PlayerComponent");
+#ifndef _HEADLESS
 			addCameraToRegistry();
+#endif
 		}
 
 		Camera& getCamera()
@@ -405,6 +419,9 @@ namespace Minecraft
 			case SceneType::MainMenu:
 				MainMenu::init();
 				break;
+			case SceneType::DedicatedServer:
+				World::init(*registry);
+				break;
 			case SceneType::None:
 				break;
 			default:
@@ -0,0 +1,687 @@
+#include "core/SelfTest.h"
+#include "core/Pool.hpp"
+#include "core/SpscQueue.hpp"
+#include "world/ChunkCodec.h"
+#include "world/BlockMap.h"
+
+namespace Minecraft
+{
+	namespace SelfTest
+	{
+		typedef bool (*TestFunction)();
+		struct Test
+		{
+			const char* name;
+			TestFunction fn;
+		};
+
+		enum class TestChunk : uint8
+		{
+			// One block everywhere
+			Uniform = 0,
+			// Stone, dirt and grass under air with a few ores, what most saved chunks look like
+			Layered,
+			// Every block picked from 16 ids
+			Random,
+			// Every block picked from 1000 ids, so no section fits in a palette
+			ManyIds,
+			Length
+		};
+
+		static const char* testChunkNames[(uint8)TestChunk::Length] = {
+			"uniform",
+			"layered",
+			"random",
+			"many ids",
+		};
+
+		static const int BlocksPerChunk = World::ChunkWidth * World::ChunkDepth * World::ChunkHeight;
+
+		// Internal functions
+		static bool poolConcurrentProducersAndConsumers();
+		static bool chunkCodecRejectsMalformedData();
+		static bool chunkCodecRoundTripsGeneratedChunks();
+		static bool chunkCodecRunDetectionMatchesScalar();
+		static bool chunkCodecThroughput();
+		static void fillTestChunk(Block* blocks, TestChunk kind, std::minstd_rand& rng);
+		static void fillTestSection(Block* sectionBlocks, int numIds, int maxRunLength, std::minstd_rand& rng);
+		template<typename Fn>
+		static double secondsPerCall(const Fn& fn);
+		static bool sameBlockIds(const Block* a, const Block* b, int numBlocks);
+		static size_t encodeLegacy(const Block* blocks, const glm::ivec2& chunkCoords, uint8* dst);
+		static bool fuzzDecode(const char* name, const uint8* encoded, size_t encodedSize, size_t headerSize, std::minstd_rand& rng);
+
+		static const Test tests[] = {
+			{ "Pool concurrent getNewPool/freePool", poolConcurrentProducersAndConsumers },
+			{ "ChunkCodec rejects truncated and mutated data", chunkCodecRejectsMalformedData },
+			{ "ChunkCodec round trips generated chunks", chunkCodecRoundTripsGeneratedChunks },
+			{ "ChunkCodec SSE2 run detection matches the scalar loop", chunkCodecRunDetectionMatchesScalar },
+			{ "ChunkCodec throughput", chunkCodecThroughput },
+		};
+
+		int run()
+		{
+			int numFailed = 0;
+			for (const Test& test : tests)
+			{
+				auto start = std::chrono::steady_clock::now();
+				bool passed = test.fn();
+				float seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+				if (passed)
+				{
+					g_logger_info("[PASS] %s (%2.3fs)", test.name, seconds);
+				}
+				else
+				{
+					g_logger_error("[FAIL] %s (%2.3fs)", test.name, seconds);
+					numFailed++;
+				}
+			}
+
+			g_logger_info("%d of %d self tests passed.", (int)(sizeof(tests) / sizeof(Test)) - numFailed, (int)(sizeof(tests) / sizeof(Test)));
+			return numFailed;
+		}
+
+		static bool poolConcurrentProducersAndConsumers()
+		{
+			// Consumers take pools and hand them to their producer, which checks nobody else wrote to
+			// them in the meantime and frees them. There are only a few more pools than can ever be in
+			// flight, so the free list wraps around constantly without ever running dry.
+			const uint32 poolSize = 32;
+			const uint32 numPairs = 4;
+			const uint32 handoffCapacity = 4;
+			const uint32 numPools = numPairs * (handoffCapacity + 1) + 4;
+			const uint32 iterationsPerConsumer = 200'000;
+			const uint32 freeMarker = 0xFFFFFFFF;
+
+			Pool<uint32> pool(poolSize, numPools);
+			for (uint32 i = 0; i < numPools; i++)
+			{
+				std::fill(pool[i], pool[i] + poolSize, freeMarker);
+			}
+
+			std::atomic<uint32> numErrors = 0;
+			SpscQueue<uint32*> handoffs[numPairs];
+			std::vector<std::thread> threads;
+			for (uint32 pair = 0; pair < numPairs; pair++)
+			{
+				handoffs[pair].init(handoffCapacity);
+
+				threads.emplace_back([&, pair]()
+				{
+					for (uint32 i = 0; i < iterationsPerConsumer; i++)
+					{
+						uint32* slab = pool.getNewPool();
+						if (!slab)
+						{
+							numErrors++;
+							break;
+						}
+
+						// A pool that's handed out twice still has the last owner's tag in it
+						if (slab[0] != freeMarker)
+						{
+							numErrors++;
+						}
+
+						const uint32 tag = (pair << 24) | (i & 0xFFFFFF);
+						std::fill(slab, slab + poolSize, tag);
+						while (!handoffs[pair].push(slab))
+						{
+							std::this_thread::yield();
+						}
+					}
+
+					while (!handoffs[pair].push(nullptr))
+					{
+						std::this_thread::yield();
+					}
+				});
+
+				threads.emplace_back([&, pair]()
+				{
+					uint32 expectedIteration = 0;
+					while (true)
+					{
+						uint32* slab;
+						if (!handoffs[pair].pop(&slab))
+						{
+							std::this_thread::yield();
+							continue;
+						}
+
+						if (!slab)
+						{
+							break;
+						}
+
+						const uint32 tag = (pair << 24) | (expectedIteration & 0xFFFFFF);
+						for (uint32 i = 0; i < poolSize; i++)
+						{
+							if (slab[i] != tag)
+							{
+								numErrors++;
+								break;
+							}
+						}
+						expectedIteration++;
+
+						std::fill(slab, slab + poolSize, freeMarker);
+						pool.freePool(slab);
+					}
+				});
+			}
+
+			for (std::thread& thread : threads)
+			{
+				thread.join();
+			}
+
+			if (numErrors > 0)
+			{
+				g_logger_error("Pool handed out a slot that was still in use %u times.", numErrors.load());
+				return false;
+			}
+
+			if (pool.count() != numPools)
+			{
+				g_logger_error("Pool only got %u of its %u slots back.", pool.count(), numPools);
+				return false;
+			}
+
+			// Every slot has to come back out exactly once
+			std::vector<uint32*> slabs;
+			for (uint32 i = 0; i < numPools; i++)
+			{
+				slabs.push_back(pool.getNewPool());
+			}
+			std::sort(slabs.begin(), slabs.end());
+			bool allUnique = slabs[0] != nullptr && std::adjacent_find(slabs.begin(), slabs.end()) == slabs.end();
+			for (uint32* slab : slabs)
+			{
+				if (slab)
+				{
+					pool.freePool(slab);
+				}
+			}
+
+			if (!allUnique || pool.count() != numPools)
+			{
+				g_logger_error("Pool free list lost track of a slot.");
+				return false;
+			}
+
+			return true;
+		}
+	
+		static bool chunkCodecRejectsMalformedData()
+		{
+			std::minstd_rand rng(1234);
+			std::vector<Block> source(BlocksPerChunk);
+			std::vector<Block> decoded(BlocksPerChunk);
+			std::vector<uint8> encoded(ChunkCodec::maxEncodedSize);
+			const glm::ivec2 chunkCoords = glm::ivec2(-7, 12);
+
+			bool passed = true;
+			for (uint8 kind = 0; kind < (uint8)TestChunk::Length; kind++)
+			{
+				fillTestChunk(source.data(), (TestChunk)kind, rng);
+				size_t encodedSize = ChunkCodec::encode(source.data(), chunkCoords, encoded.data(), encoded.size());
+				glm::ivec2 decodedCoords;
+				if (encodedSize == 0 ||
+					!ChunkCodec::decode(encoded.data(), encodedSize, decoded.data(), &decodedCoords) ||
+					decodedCoords != chunkCoords || !sameBlockIds(source.data(), decoded.data(), BlocksPerChunk))
+				{
+					g_logger_error("ChunkCodec did not round trip the %s chunk.", testChunkNames[kind]);
+					passed = false;
+					continue;
+				}
+
+				// Magic and version byte
+				passed = fuzzDecode(testChunkNames[kind], encoded.data(), encodedSize, sizeof(uint8) * 2, rng) && passed;
+			}
+
+			// The header is only checked once here, anything else would log an unknown version on every mutation
+			fillTestChunk(source.data(), TestChunk::Layered, rng);
+			size_t encodedSize = ChunkCodec::encode(source.data(), chunkCoords, encoded.data(), encoded.size());
+			std::vector<uint8> badHeader(encoded.begin(), encoded.begin() + encodedSize);
+			badHeader[1] = ChunkCodec::CurrentVersion + 1;
+			glm::ivec2 decodedCoords;
+			if (ChunkCodec::decode(badHeader.data(), badHeader.size(), decoded.data(), &decodedCoords))
+			{
+				g_logger_error("ChunkCodec decoded a chunk with an unknown version.");
+				passed = false;
+			}
+			badHeader[0] ^= 0x40;
+			badHeader[1] = ChunkCodec::CurrentVersion;
+			if (ChunkCodec::decode(badHeader.data(), badHeader.size(), decoded.data(), &decodedCoords))
+			{
+				g_logger_error("ChunkCodec decoded a chunk with the wrong magic byte.");
+				passed = false;
+			}
+
+			// Old saves go through their own decoder
+			size_t legacySize = encodeLegacy(source.data(), chunkCoords, encoded.data());
+			if (!ChunkCodec::decode(encoded.data(), legacySize, decoded.data(), &decodedCoords) ||
+				decodedCoords != chunkCoords || !sameBlockIds(source.data(), decoded.data(), BlocksPerChunk))
+			{
+				g_logger_error("ChunkCodec did not decode the legacy run length format.");
+				passed = false;
+			}
+			// The low bits of the first byte pick the legacy decoder, so those can't be mutated either
+			passed = fuzzDecode("legacy", encoded.data(), legacySize, 1, rng) && passed;
+
+			return passed;
+		}
+
+		static bool chunkCodecRoundTripsGeneratedChunks()
+		{
+			// Past the named chunks every section gets its own number of ids and run length, so each
+			// palette width shows up next to uniform and direct sections in the same chunk. Sections
+			// with 255 or more ids use runs of one so nearly all of their ids actually get used.
+			const int idCounts[] = { 1, 2, 3, 4, 5, 16, 17, 100, 255, 256, 257, 1000 };
+			const int numIdCounts = (int)(sizeof(idCounts) / sizeof(int));
+			const int numMixedChunks = 200;
+			std::minstd_rand rng(4321);
+			std::vector<Block> source(BlocksPerChunk);
+			std::vector<Block> decoded(BlocksPerChunk);
+			std::vector<uint8> encoded(ChunkCodec::maxEncodedSize);
+			std::vector<uint8> reencoded(ChunkCodec::maxEncodedSize);
+
+			for (int chunk = 0; chunk < (int)TestChunk::Length + numMixedChunks; chunk++)
+			{
+				const char* name = "mixed";
+				if (chunk < (int)TestChunk::Length)
+				{
+					fillTestChunk(source.data(), (TestChunk)chunk, rng);
+					name = testChunkNames[chunk];
+				}
+				else
+				{
+					for (int section = 0; section < ChunkCodec::NumSections; section++)
+					{
+						int numIds = idCounts[rng() % numIdCounts];
+						int maxRunLength = numIds >= 255 ? 1 : 1 + (int)(rng() % 64);
+						fillTestSection(source.data() + section * ChunkCodec::BlocksPerSection, numIds, maxRunLength, rng);
+					}
+				}
+
+				const glm::ivec2 chunkCoords = glm::ivec2((int)(rng() % 20001) - 10000, (int)(rng() % 20001) - 10000);
+				size_t encodedSize = ChunkCodec::encode(source.data(), chunkCoords, encoded.data(), encoded.size());
+				glm::ivec2 decodedCoords;
+				if (encodedSize == 0 ||
+					!ChunkCodec::decode(encoded.data(), encodedSize, decoded.data(), &decodedCoords) ||
+					decodedCoords != chunkCoords || !sameBlockIds(source.data(), decoded.data(), BlocksPerChunk))
+				{
+					g_logger_error("ChunkCodec did not round trip %s chunk %d.", name, chunk);
+					return false;
+				}
+
+				glm::ivec2 peekedCoords;
+				if (!ChunkCodec::peekChunkCoords(encoded.data(), encodedSize, &peekedCoords) || peekedCoords != chunkCoords)
+				{
+					g_logger_error("ChunkCodec peeked the wrong coordinates from %s chunk %d.", name, chunk);
+					return false;
+				}
+
+				// The content version relies on the same blocks always encoding to the same bytes
+				size_t reencodedSize = ChunkCodec::encode(decoded.data(), chunkCoords, reencoded.data(), reencoded.size());
+				if (reencodedSize != encodedSize || !std::equal(encoded.begin(), encoded.begin() + encodedSize, reencoded.begin()))
+				{
+					g_logger_error("ChunkCodec encoded the blocks of %s chunk %d differently the second time.", name, chunk);
+					return false;
+				}
+
+				// Too small a buffer has to fail instead of writing past it
+				if (ChunkCodec::encode(source.data(), chunkCoords, reencoded.data(), encodedSize - 1) != 0)
+				{
+					g_logger_error("ChunkCodec encoded %s chunk %d into a buffer one byte too small.", name, chunk);
+					return false;
+				}
+			}
+
+			return true;
+		}
+
+		static bool chunkCodecRunDetectionMatchesScalar()
+		{
+			// The SSE2 path compares four blocks at a time and only looks at their id bytes. Every
+			// start gets checked with each leftover count after the four block loop and with the rest
+			// of its section. The lighting is random so a mask letting other bytes through shows up,
+			// and the last chunk has ids that only differ in their high byte.
+			std::minstd_rand rng(99);
+			std::vector<Block> blocks(BlocksPerChunk);
+			const int numChunks = (int)TestChunk::Length + 2;
+			for (int chunk = 0; chunk < numChunks; chunk++)
+			{
+				const char* name;
+				if (chunk < (int)TestChunk::Length)
+				{
+					fillTestChunk(blocks.data(), (TestChunk)chunk, rng);
+					name = testChunkNames[chunk];
+				}
+				else if (chunk == (int)TestChunk::Length)
+				{
+					for (int section = 0; section < ChunkCodec::NumSections; section++)
+					{
+						fillTestSection(blocks.data() + section * ChunkCodec::BlocksPerSection, 3, 1 + section * 4, rng);
+					}
+					name = "short runs";
+				}
+				else
+				{
+					for (int section = 0; section < ChunkCodec::NumSections; section++)
+					{
+						fillTestSection(blocks.data() + section * ChunkCodec::BlocksPerSection, 2, 1 + section, rng);
+					}
+					for (int i = 0; i < BlocksPerChunk; i++)
+					{
+						blocks[i].id = (uint16)((blocks[i].id << 8) | 1);
+					}
+					name = "high byte";
+				}
+
+				for (int sectionStart = 0; sectionStart < BlocksPerChunk; sectionStart += ChunkCodec::BlocksPerSection)
+				{
+					const int sectionEnd = sectionStart + ChunkCodec::BlocksPerSection;
+					for (int start = sectionStart; start < sectionEnd; start++)
+					{
+						for (int length = 1; length <= 9; length++)
+						{
+							int end = glm::min(start + length, sectionEnd);
+							int expected = ChunkCodec::findRunEndScalar(blocks.data(), start, end);
+							int actual = ChunkCodec::findRunEnd(blocks.data(), start, end);
+							if (actual != expected)
+							{
+								g_logger_error("Run from %d to %d in the %s chunk ends at %d, the scalar loop says %d.", start, end, name, actual, expected);
+								return false;
+							}
+						}
+
+						int expected = ChunkCodec::findRunEndScalar(blocks.data(), start, sectionEnd);
+						int actual = ChunkCodec::findRunEnd(blocks.data(), start, sectionEnd);
+						if (actual != expected)
+						{
+							g_logger_error("Run from %d to %d in the %s chunk ends at %d, the scalar loop says %d.", start, sectionEnd, name, actual, expected);
+							return false;
+						}
+					}
+				}
+			}
+
+			return true;
+		}
+
+		static bool chunkCodecThroughput()
+		{
+			// Only fails if the codec stops round tripping, the numbers are there to compare builds
+			std::minstd_rand rng(7);
+			std::vector<Block> source(BlocksPerChunk);
+			std::vector<Block> decoded(BlocksPerChunk);
+			std::vector<uint8> encoded(ChunkCodec::maxEncodedSize);
+			const glm::ivec2 chunkCoords = glm::ivec2(3, -4);
+			const double megabytesPerChunk = (double)(sizeof(Block) * BlocksPerChunk) / (1024.0 * 1024.0);
+
+			for (uint8 kind = 0; kind < (uint8)TestChunk::Length; kind++)
+			{
+				fillTestChunk(source.data(), (TestChunk)kind, rng);
+				size_t encodedSize = 0;
+				double encodeSeconds = secondsPerCall([&]()
+				{
+					encodedSize = ChunkCodec::encode(source.data(), chunkCoords, encoded.data(), encoded.size());
+				});
+
+				bool decodedOk = false;
+				glm::ivec2 decodedCoords;
+				double decodeSeconds = secondsPerCall([&]()
+				{
+					decodedOk = ChunkCodec::decode(encoded.data(), encodedSize, decoded.data(), &decodedCoords);
+				});
+
+				if (encodedSize == 0 || !decodedOk || !sameBlockIds(source.data(), decoded.data(), BlocksPerChunk))
+				{
+					g_logger_error("ChunkCodec did not round trip the %s chunk.", testChunkNames[kind]);
+					return false;
+				}
+
+				g_logger_info("  %-8s %7zu bytes, encode %8.1f MB/s, decode %8.1f MB/s", testChunkNames[kind], encodedSize,
+					megabytesPerChunk / encodeSeconds, megabytesPerChunk / decodeSeconds);
+			}
+
+			// Walking every run of a chunk is most of what the encoder does
+			fillTestChunk(source.data(), TestChunk::Layered, rng);
+			int numRuns = 0;
+			auto walkRuns = [&](int (*findEnd)(const Block*, int, int))
+			{
+				numRuns = 0;
+				for (int runStart = 0; runStart < BlocksPerChunk; runStart = findEnd(source.data(), runStart, BlocksPerChunk))
+				{
+					numRuns++;
+				}
+			};
+			double scalarSeconds = secondsPerCall([&]() { walkRuns(ChunkCodec::findRunEndScalar); });
+			double fastSeconds = secondsPerCall([&]() { walkRuns(ChunkCodec::findRunEnd); });
+			g_logger_info("  run detection over %d runs, scalar %8.1f MB/s, findRunEnd %8.1f MB/s", numRuns,
+				megabytesPerChunk / scalarSeconds, megabytesPerChunk / fastSeconds);
+
+			return true;
+		}
+
+		template<typename Fn>
+		static double secondsPerCall(const Fn& fn)
+		{
+			// Average over a fifth of a second of calls, after one to warm the caches up
+			const double minSeconds = 0.2;
+			fn();
+			int numCalls = 0;
+			double seconds = 0.0;
+			auto start = std::chrono::steady_clock::now();
+			do
+			{
+				fn();
+				numCalls++;
+				seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			} while (seconds < minSeconds);
+			return seconds / numCalls;
+		}
+
+		static bool fuzzDecode(const char* name, const uint8* encoded, size_t encodedSize, size_t headerSize, std::minstd_rand& rng)
+		{
+			// The decoder gets exactly as many bytes as it's told about so a sanitizer catches any read
+			// past the end, and it writes into blocks followed by a guard that has to stay untouched
+			const int numGuardBlocks = 64;
+			const uint16 guardId = 0xBEEF;
+			std::vector<Block> blocks(BlocksPerChunk + numGuardBlocks);
+			auto decodeGuarded = [&](const std::vector<uint8>& data, bool* decoded)
+			{
+				for (int i = BlocksPerChunk; i < BlocksPerChunk + numGuardBlocks; i++)
+				{
+					blocks[i].id = guardId;
+				}
+
+				glm::ivec2 chunkCoords;
+				*decoded = ChunkCodec::decode(data.data(), data.size(), blocks.data(), &chunkCoords);
+				ChunkCodec::peekChunkCoords(data.data(), data.size(), &chunkCoords);
+				for (int i = BlocksPerChunk; i < BlocksPerChunk + numGuardBlocks; i++)
+				{
+					if (blocks[i].id != guardId)
+					{
+						return false;
+					}
+				}
+				return true;
+			};
+
+			// Every complete encoding is read to its last byte, so any prefix of it has to be rejected.
+			// The ends of the data get checked byte by byte, the middle gets sampled.
+			const size_t stride = glm::max<size_t>(1, encodedSize / 512);
+			for (size_t length = 0; length < encodedSize; length += (length < 64 || length + 64 >= encodedSize) ? 1 : stride)
+			{
+				std::vector<uint8> truncated(encoded, encoded + length);
+				bool decoded;
+				if (!decodeGuarded(truncated, &decoded))
+				{
+					g_logger_error("ChunkCodec wrote past the chunk decoding the %s chunk truncated to %zu of %zu bytes.", name, length, encodedSize);
+					return false;
+				}
+				if (decoded)
+				{
+					g_logger_error("ChunkCodec accepted the %s chunk truncated to %zu of %zu bytes.", name, length, encodedSize);
+					return false;
+				}
+			}
+
+			// Mutated data is allowed to decode to different blocks, it just can't go out of bounds
+			const int numMutations = 2000;
+			for (int i = 0; i < numMutations; i++)
+			{
+				std::vector<uint8> mutated(encoded, encoded + encodedSize);
+				int numEdits = 1 + (int)(rng() % 4);
+				for (int edit = 0; edit < numEdits && mutated.size() > headerSize; edit++)
+				{
+					size_t offset = headerSize + rng() % (mutated.size() - headerSize);
+					switch (rng() % 4)
+					{
+					case 0:
+						mutated[offset] ^= (uint8)(1u << (rng() % 8));
+						break;
+					case 1:
+						mutated[offset] = (uint8)rng();
+						break;
+					case 2:
+						mutated.resize(offset);
+						break;
+					case 3:
+						mutated.insert(mutated.begin() + offset, (uint8)rng());
+						break;
+					}
+				}
+
+				bool decoded;
+				if (!decodeGuarded(mutated, &decoded))
+				{
+					g_logger_error("ChunkCodec wrote past the chunk decoding a mutated %s chunk.", name);
+					return false;
+				}
+			}
+
+			// And plain garbage behind a valid header
+			for (int i = 0; i < numMutations; i++)
+			{
+				std::vector<uint8> garbage(encoded, encoded + glm::min(headerSize, encodedSize));
+				size_t garbageSize = rng() % 4096;
+				for (size_t j = 0; j < garbageSize; j++)
+				{
+					garbage.push_back((uint8)rng());
+				}
+
+				bool decoded;
+				if (!decodeGuarded(garbage, &decoded))
+				{
+					g_logger_error("ChunkCodec wrote past the chunk decoding garbage after a %s chunk header.", name);
+					return false;
+				}
+			}
+
+			return true;
+		}
+
+		static void fillTestChunk(Block* blocks, TestChunk kind, std::minstd_rand& rng)
+		{
+			g_memory_zeroMem(blocks, sizeof(Block) * BlocksPerChunk);
+			for (int i = 0; i < BlocksPerChunk; i++)
+			{
+				// Same layout as the chunk's block data, y is the outermost axis
+				int y = i / (World::ChunkWidth * World::ChunkDepth);
+				switch (kind)
+				{
+				case TestChunk::Uniform:
+					blocks[i].id = 1;
+					break;
+				case TestChunk::Layered:
+					if (y < 60)
+					{
+						blocks[i].id = rng() % 200 == 0 ? 7 : 1;
+					}
+					else if (y < 64)
+					{
+						blocks[i].id = 2;
+					}
+					else if (y == 64)
+					{
+						blocks[i].id = 3;
+					}
+					else
+					{
+						blocks[i].id = BlockMap::AIR_BLOCK.id;
+					}
+					break;
+				case TestChunk::Random:
+					blocks[i].id = (uint16)(rng() % 16);
+					break;
+				case TestChunk::ManyIds:
+					blocks[i].id = (uint16)(rng() % 1000);
+					break;
+				}
+
+				// The codec only keeps the ids, lighting is recalculated after loading
+				blocks[i].setSkyLightLevel((int)(rng() % 32));
+			}
+		}
+
+		static void fillTestSection(Block* sectionBlocks, int numIds, int maxRunLength, std::minstd_rand& rng)
+		{
+			g_memory_zeroMem(sectionBlocks, sizeof(Block) * ChunkCodec::BlocksPerSection);
+			for (int runStart = 0; runStart < ChunkCodec::BlocksPerSection;)
+			{
+				int runEnd = glm::min(runStart + 1 + (int)(rng() % maxRunLength), ChunkCodec::BlocksPerSection);
+				uint16 blockId = (uint16)(rng() % numIds);
+				for (int i = runStart; i < runEnd; i++)
+				{
+					sectionBlocks[i].id = blockId;
+					sectionBlocks[i].setSkyLightLevel((int)(rng() % 32));
+				}
+				runStart = runEnd;
+			}
+		}
+
+		static bool sameBlockIds(const Block* a, const Block* b, int numBlocks)
+		{
+			for (int i = 0; i < numBlocks; i++)
+			{
+				if (a[i].id != b[i].id)
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		static size_t encodeLegacy(const Block* blocks, const glm::ivec2& chunkCoords, uint8* dst)
+		{
+			// runLengthSize (uint32) -> (blockId (uint16) -> blockCount (uint16)) * n -> chunkX (int32) -> chunkZ (int32)
+			size_t offset = sizeof(uint32);
+			for (int runStart = 0; runStart < BlocksPerChunk;)
+			{
+				int runEnd = runStart + 1;
+				while (runEnd < BlocksPerChunk && blocks[runEnd].id == blocks[runStart].id && runEnd - runStart < UINT16_MAX)
+				{
+					runEnd++;
+				}
+
+				uint16 blockId = blocks[runStart].id;
+				uint16 blockCount = (uint16)(runEnd - runStart);
+				g_memory_copyMem(dst + offset, &blockId, sizeof(uint16));
+				g_memory_copyMem(dst + offset + sizeof(uint16), &blockCount, sizeof(uint16));
+				offset += sizeof(uint16) * 2;
+				runStart = runEnd;
+			}
+
+			uint32 runLengthSize = (uint32)(offset - sizeof(uint32));
+			g_memory_copyMem(dst, &runLengthSize, sizeof(uint32));
+			g_memory_copyMem(dst + offset, (void*)&chunkCoords.x, sizeof(int32));
+			g_memory_copyMem(dst + offset + sizeof(int32), (void*)&chunkCoords.y, sizeof(int32));
+			return offset + sizeof(int32) * 2;
+		}
+	}
+}
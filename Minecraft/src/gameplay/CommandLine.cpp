@@ -15,6 +15,7 @@
 #include "gameplay/CharacterController.h"
 #include "world/ChunkManager.h"
 #include "network/Network.h"
+#include "network/NetworkStats.h"
 
 namespace Minecraft
 {
@@ -38,6 +39,7 @@ namespace Minecraft
 		BeginRecording,
 		StopRecording,
 		PlayRecording,
+		DumpNetworkStats,
 		Length
 	};
 
@@ -255,6 +257,15 @@ namespace Minecraft
 				g_logger_info("Playing demo at '%s'", demoDir.c_str());
 			}
 			break;
+			case CommandLineType::DumpNetworkStats:
+			{
+				// Optionally takes the file to write to
+				std::string filepath = argsLength > 0
+					? std::string(args[0].string, args[0].string + args[0].length)
+					: World::savePath + "/networkStats.csv";
+				NetworkStats::dumpCsv(filepath.c_str());
+			}
+			break;
 			default:
 				g_logger_warning("Unknown command line type: %s", magic_enum::enum_name(type).data());
 				break;
@@ -196,9 +196,7 @@ namespace Minecraft
 
 				MainHud::update(inventory);
 
-				SizedMemory transformData = pack<glm::vec3, glm::vec3, Ecs::EntityId>(transform.position, transform.orientation, playerId);
-				Network::sendUserCommand(UserCommandType::UpdateTransform, transformData);
-				g_memory_free(transformData.memory);
+				Network::sendTransform(playerId, transform.position, transform.orientation);
 			}
 		}
 
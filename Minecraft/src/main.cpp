@@ -4,10 +4,14 @@
 #include "core/Application.h"
 #include "world/TerrainGenerator.h"
 #include "core/GlobalThreadPool.h"
+#include "world/World.h"
+#include "utils/Settings.h"
+#include "core/SelfTest.h"
+#include "network/Server.h"
 
 using namespace Minecraft;
 
-int main()
+int main(int argc, char** argv)
 {
 	//_CrtSetDbgFlag(_CRTDBG_CHECK_ALWAYS_DF);
 
@@ -18,6 +22,50 @@ int main()
 	g_logger_set_level(g_logger_level::Info);
 #endif
 
+	// Either binary started with --selftest runs the self tests instead, the exit code is how many failed
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--selftest") == 0)
+		{
+			return SelfTest::run();
+		}
+	}
+
+#ifdef _HEADLESS
+	// MinecraftServer [world] [--max-players count] [--bots count [seconds]]
+	// The world to host gets created if it doesn't exist yet. Passing --bots runs a load test
+	// with that many simulated clients and shuts the server down once it's done.
+	World::savePath = Settings::Server::defaultWorldName;
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--max-players") == 0 && i + 1 < argc)
+		{
+			Settings::Server::maxPlayers = (uint32)std::strtoul(argv[++i], nullptr, 10);
+		}
+		else if (std::strcmp(argv[i], "--bots") == 0 && i + 1 < argc)
+		{
+			Settings::Server::loadTestBots = (uint32)std::strtoul(argv[++i], nullptr, 10);
+			if (i + 1 < argc && std::isdigit((unsigned char)argv[i + 1][0]))
+			{
+				Settings::Server::loadTestSeconds = (uint32)std::strtoul(argv[++i], nullptr, 10);
+			}
+		}
+		else
+		{
+			World::savePath = argv[i];
+		}
+	}
+	// The bots take up player slots like anyone else
+	if (Settings::Server::loadTestBots > Settings::Server::maxPlayers)
+	{
+		g_logger_warning("Raising the player limit from %u to %u to fit the load test bots.", Settings::Server::maxPlayers, Settings::Server::loadTestBots);
+		Settings::Server::maxPlayers = Settings::Server::loadTestBots;
+	}
+	Settings::Server::maxPlayers = glm::clamp(Settings::Server::maxPlayers, 1u, (uint32)Server::maxClients);
+	// The world name is what shows up in the LAN server list
+	World::localPlayerName = World::savePath;
+#endif
+
 	Minecraft::Application::init();
 	Minecraft::Application::run();
 	Minecraft::Application::free();
@@ -1,6 +1,10 @@
 #include "network/Client.h"
+#include "network/ClientChunkCache.h"
 #include "network/TransformCommandBuffer.h"
+#include "network/TransformStream.h"
 #include "network/Network.h"
+#include "network/NetworkThread.h"
+#include "network/NetworkStats.h"
 #include "network/Server.h"
 #include "core.h"
 #include "core/Scene.h"
@@ -8,8 +12,10 @@
 #include "world/ChunkManager.h"
 #include "world/Chunk.hpp"
 #include "world/BlockMap.h"
+#include "world/ChunkCodec.h"
 #include "gameplay/PlayerController.h"
 #include "gui/MainHud.h"
+#include "utils/DebugStats.h"
 
 #include <enet/enet.h>
 
@@ -22,10 +28,15 @@ namespace Minecraft
 		static ENetAddress address;
 		static ENetHost* client;
 		static ENetPeer* peer;
+		static NetworkThread networkThread;
 
 		static TransformCommandBuffer transformCommandBuffer;
 		static constexpr uint64 lagInMs = 300;
-		static constexpr int maxNumTransformCommands = 3000;
+		static constexpr int maxNumTrackedEntities = 256;
+		static robin_hood::unordered_flat_map<Ecs::EntityId, EntityTransform> latestTransforms;
+		static TransformEncoder transformEncoder;
+		static TransformDecoder transformDecoder;
+		static std::vector<EntityTransform> decodedTransforms;
 		static bool isConnectingVar;
 
 		// The time that this client is drifting from the server in milliseconds
@@ -36,6 +47,9 @@ namespace Minecraft
 		static void processEvent(NetworkEvent* event, uint8* data);
 		static void processUserCommand(UserCommand* command, void* userCommandData);
 		static void processClientCommand(ClientCommand* command, void* userCommandData);
+		static void sendTransforms();
+		static void updateRemoteTransforms();
+		static void requestChunk(const glm::ivec2& chunkCoords);
 
 		void init()
 		{
@@ -80,27 +94,30 @@ namespace Minecraft
 				return;
 			}
 
-			transformCommandBuffer.init(maxNumTransformCommands);
+			transformCommandBuffer.init(maxNumTrackedEntities);
+			networkThread.start(client);
 		}
 
 		void update()
 		{
 			clientGameTime += (uint64)(World::deltaTime * 1000.0f);
-			ENetEvent event;
+			sendTransforms();
+			NetworkMessage event;
 
 			// Process all events
-			while (enet_host_service(client, &event, 0) > 0)
+			while (networkThread.poll(&event))
 			{
 				switch (event.type)
 				{
-				case ENET_EVENT_TYPE_CONNECT:
+				case NetworkMessageType::Connect:
 				{
 					g_logger_info("A new client connected from %x:%u.", event.peer->address.host, event.peer->address.port);
 					g_logger_assert(false, "Is this ever even hit? If not remove this.");
 					break;
 				}
-				case ENET_EVENT_TYPE_RECEIVE:
+				case NetworkMessageType::Receive:
 				{
+					NetworkStats::recordPacket(NetworkDirection::Received, event.packet->data, event.packet->dataLength);
 					NetworkEventData networkEventData = Network::deserializeNetworkEvent(event.packet->data, event.packet->dataLength);
 					processEvent(networkEventData.event, networkEventData.data);
 
@@ -108,7 +125,7 @@ namespace Minecraft
 					enet_packet_destroy(event.packet);
 					break;
 				}
-				case ENET_EVENT_TYPE_DISCONNECT:
+				case NetworkMessageType::Disconnect:
 				{
 					g_logger_info("%s disconnected.", event.peer->data);
 
@@ -118,6 +135,8 @@ namespace Minecraft
 				}
 				}
 			}
+
+			updateRemoteTransforms();
 		}
 
 		bool isConnecting()
@@ -125,19 +144,30 @@ namespace Minecraft
 			return isConnectingVar;
 		}
 
-		void sendServer(ENetPacket* packet)
+		void sendServer(ENetPacket* packet, NetworkChannel channel)
 		{
-			enet_peer_send(peer, 0, packet);
+			networkThread.send(peer, packet, channel);
 		}
 
-		void free()
+		void queueTransform(Ecs::EntityId entity, const glm::vec3& position, const glm::vec3& orientation)
 		{
-			enet_peer_disconnect(peer, 0);
-			peer = NULL;
+			latestTransforms[entity] = { entity, position, orientation };
+		}
 
-			// Process all the events
-			update();
+		void free()
+		{
+			// Nothing else touches the host once the thread is gone
+			networkThread.stop();
+			if (peer)
+			{
+				enet_peer_disconnect(peer, 0);
+				enet_host_flush(client);
+				peer = NULL;
+			}
 			transformCommandBuffer.free();
+			latestTransforms.clear();
+			transformEncoder.entities.clear();
+			transformDecoder.entities.clear();
 
 			enet_host_destroy(client);
 			client = NULL;
@@ -158,77 +188,95 @@ namespace Minecraft
 			{
 			case NetworkEventType::ChunkData:
 			{
-				g_logger_info("Recieving server chunk data.");
+				// Chunks are streamed from the server nearest first, a few at a time
 				uint16 numChunks;
+				uint32 numChunksRemaining;
+				size_t headerSize = sizeof(uint16) + sizeof(uint32);
+				if (event->dataSize < headerSize)
+				{
+					g_logger_error("Recieved chunk data that's too small to hold its header.");
+					break;
+				}
 				uint8* chunkDataPtr = data;
 				g_memory_copyMem(&numChunks, chunkDataPtr, sizeof(uint16));
 				chunkDataPtr += sizeof(uint16);
-				g_logger_info("Num chunks: %u", numChunks);
+				g_memory_copyMem(&numChunksRemaining, chunkDataPtr, sizeof(uint32));
+				chunkDataPtr += sizeof(uint32);
 
 				for (uint16 i = 0; i < numChunks; i++)
 				{
 					uint32 compressedChunkSize;
+					if (sizeof(uint32) > event->dataSize - (chunkDataPtr - data))
+					{
+						g_logger_error("Recieved chunk data that runs past the end of the event.");
+						break;
+					}
 					g_memory_copyMem(&compressedChunkSize, chunkDataPtr, sizeof(uint32));
 					chunkDataPtr += sizeof(uint32);
 
-					Block* chunkData = (Block*)g_memory_allocate(sizeof(Block) * World::ChunkWidth * World::ChunkHeight * World::ChunkDepth);
-					g_memory_zeroMem(chunkData, sizeof(Block) * World::ChunkWidth * World::ChunkDepth * World::ChunkHeight);
-					int blockIndex = 0;
-					uint32 chunkByteCounter = 0;
-					while (chunkByteCounter < compressedChunkSize)
+					if (compressedChunkSize == 0)
 					{
-						uint16 blockId;
-						uint16 blockCount;
-						g_memory_copyMem(&blockId, chunkDataPtr, sizeof(uint16));
-						chunkDataPtr += sizeof(uint16);
-						chunkByteCounter += sizeof(uint16);
-						g_memory_copyMem(&blockCount, chunkDataPtr, sizeof(uint16));
-						chunkDataPtr += sizeof(uint16);
-						chunkByteCounter += sizeof(uint16);
-
-						g_logger_assert(blockIndex + blockCount <= World::ChunkWidth * World::ChunkDepth * World::ChunkHeight,
-							"Encountered bad data while serializing chunk data.");
-						int maxBlockCount = glm::min((int)blockCount, World::ChunkWidth * World::ChunkDepth * World::ChunkHeight);
-						const BlockFormat& blockFormat = BlockMap::getBlock(blockId);
-						for (int blockCounter = 0; blockCounter < maxBlockCount; blockCounter++)
+						// The server only sends the coordinates when our cached copy is still up to date
+						glm::ivec2 chunkCoords;
+						if (sizeof(glm::ivec2) > event->dataSize - (chunkDataPtr - data))
+						{
+							g_logger_error("Recieved chunk data that runs past the end of the event.");
+							break;
+						}
+						g_memory_copyMem(&chunkCoords, chunkDataPtr, sizeof(glm::ivec2));
+						chunkDataPtr += sizeof(glm::ivec2);
+
+						size_t cachedChunkSize;
+						uint8* cachedChunk = ClientChunkCache::copy(chunkCoords, &cachedChunkSize);
+						if (!cachedChunk)
 						{
-							chunkData[blockIndex].id = blockId;
-							chunkData[blockIndex].setLightLevel(0);
-							chunkData[blockIndex].setSkyLightLevel(0);
-							chunkData[blockIndex].setLightColor(glm::ivec3(255, 255, 255));
-							chunkData[blockIndex].setTransparent(blockFormat.isTransparent);
-							chunkData[blockIndex].setIsBlendable(blockFormat.isBlendable);
-							chunkData[blockIndex].setIsLightSource(blockFormat.isLightSource);
-							blockIndex++;
+							// It got evicted since we joined, so ask for the whole thing
+							requestChunk(chunkCoords);
 						}
+						else if (!ChunkManager::queueClientLoadChunk(cachedChunk, cachedChunkSize, chunkCoords, ChunkState::Loaded))
+						{
+							g_memory_free(cachedChunk);
+							requestChunk(chunkCoords);
+						}
+						continue;
+					}
+
+					if (compressedChunkSize > event->dataSize - (chunkDataPtr - data))
+					{
+						g_logger_error("Recieved chunk data that runs past the end of the event.");
+						break;
+					}
+
+					// Only the header gets read here, the blocks get decoded on the chunk workers
+					glm::ivec2 chunkCoords;
+					if (!ChunkCodec::peekChunkCoords(chunkDataPtr, compressedChunkSize, &chunkCoords))
+					{
+						g_logger_error("Recieved corrupted chunk data from the server.");
+						chunkDataPtr += compressedChunkSize;
+						continue;
+					}
+
+					ClientChunkCache::insert(chunkCoords, chunkDataPtr, compressedChunkSize);
+
+					// The packet is gone once this event is processed, so the worker gets its own copy
+					uint8* compressedChunk = (uint8*)g_memory_allocate(compressedChunkSize);
+					g_memory_copyMem(compressedChunk, chunkDataPtr, compressedChunkSize);
+					chunkDataPtr += compressedChunkSize;
+
+					if (!ChunkManager::queueClientLoadChunk(compressedChunk, compressedChunkSize, chunkCoords, ChunkState::Loaded))
+					{
+						// The server thinks we have it now, so it has to be told to send it again
+						g_memory_free(compressedChunk);
+						requestChunk(chunkCoords);
 					}
-					g_logger_assert(blockIndex == World::ChunkWidth * World::ChunkDepth * World::ChunkHeight,
-						"Deserialized invalid block data on client. Count was '%d', should be '%d'", blockIndex, World::ChunkWidth * World::ChunkHeight * World::ChunkDepth);
-					int32 chunkX, chunkZ;
-					ChunkState state;
-					g_memory_copyMem(&chunkX, chunkDataPtr, sizeof(int32));
-					chunkDataPtr += sizeof(int32);
-					g_memory_copyMem(&chunkZ, chunkDataPtr, sizeof(int32));
-					chunkDataPtr += sizeof(int32);
-					g_memory_copyMem(&state, chunkDataPtr, sizeof(ChunkState));
-					chunkDataPtr += sizeof(ChunkState);
-
-					ChunkManager::queueClientLoadChunk(chunkData, glm::ivec2(chunkX, chunkZ), state);
 				}
-				g_logger_assert(chunkDataPtr - data == event->dataSize, "Deserialized more or less data than we recieved from the client.");
-			}
-			break;
-			case NetworkEventType::PatchChunkNeighbors:
-			{
-				g_logger_info("Patching chunk pointers.");
-				ChunkManager::patchChunkPointers();
-				g_logger_info("Done patching chunk pointers.");
-			}
-			break;
-			case NetworkEventType::NotifyChunkWorker:
-			{
-				g_logger_info("Starting the work on the thread.");
-				ChunkManager::beginWork();
+
+				ChunkManager::queueStreamedChunkLighting(numChunksRemaining == 0);
+
+				// Let the server know it can send more
+				SizedMemory ackData = pack<uint32>((uint32)event->dataSize);
+				Network::sendClientCommand(ClientCommandType::ChunkAck, ackData);
+				g_memory_free(ackData.memory);
 			}
 			break;
 			case NetworkEventType::WorldSeed:
@@ -267,16 +315,24 @@ namespace Minecraft
 			break;
 			case NetworkEventType::UserCommand:
 			{
-				UserCommand* command = (UserCommand*)data;
-				uint8* userCommandData = (uint8*)data + sizeof(UserCommand);
-				processUserCommand(command, userCommandData);
+				UserCommand* command;
+				void* userCommandData;
+				if (Network::readUserCommand(data, event->dataSize, &command, &userCommandData))
+				{
+					processUserCommand(command, userCommandData);
+				}
 			}
 			break;
 			case NetworkEventType::ClientCommand:
 			{
-				ClientCommand* command = (ClientCommand*)data;
-				uint8* clientCommandData = (uint8*)data + sizeof(ClientCommand);
-				processClientCommand(command, clientCommandData);
+				// Everything the server sent us during one update comes in the same event
+				size_t offset = 0;
+				ClientCommand* command;
+				void* clientCommandData;
+				while (Network::readClientCommand(data, event->dataSize, &offset, &command, &clientCommandData))
+				{
+					processClientCommand(command, clientCommandData);
+				}
 			}
 			break;
 			default:
@@ -293,29 +349,26 @@ namespace Minecraft
 			{
 			case UserCommandType::UpdateTransform:
 			{
-				UpdateTransformCommand bufferCommand;
-				SizedMemory sizedData = SizedMemory{ (uint8*)userCommandData, command->sizeOfData };
-				unpack<glm::vec3, glm::vec3, Ecs::EntityId>(
-					sizedData,
-					&bufferCommand.position,
-					&bufferCommand.orientation,
-					&bufferCommand.entity
-					);
-				bufferCommand.timestamp = command->timestamp;
-				transformCommandBuffer.insert(bufferCommand);
+				decodedTransforms.clear();
+				if (!transformDecoder.decode((uint8*)userCommandData, command->sizeOfData, decodedTransforms))
+				{
+					g_logger_error("<Client> Recieved a malformed transform update.");
+				}
 
-				// Use a command from at least 300ms ago
-				bool foundPosition;
-				glm::vec3 position, orientation;
-				if (transformCommandBuffer.predict(lagInMs, bufferCommand.entity, &position, &orientation))
+				for (const EntityTransform& entityTransform : decodedTransforms)
 				{
-					Ecs::Registry* registry = Scene::getRegistry();
-					if (registry->hasComponent<Transform>(bufferCommand.entity))
+					// The server sends everyone's transform to everyone, ours is already up to date
+					if (entityTransform.entity == World::getLocalPlayer())
 					{
-						Transform& transform = registry->getComponent<Transform>(bufferCommand.entity);
-						transform.position = position;
-						transform.orientation = orientation;
+						continue;
 					}
+
+					UpdateTransformCommand bufferCommand;
+					bufferCommand.entity = entityTransform.entity;
+					bufferCommand.position = entityTransform.position;
+					bufferCommand.orientation = entityTransform.orientation;
+					bufferCommand.timestamp = command->timestamp;
+					transformCommandBuffer.insert(bufferCommand);
 				}
 			}
 			break;
@@ -418,28 +471,24 @@ namespace Minecraft
 			break;
 			case ClientCommandType::Handshake:
 			{
-				SizedMemory myName;
-				myName.size = (World::localPlayerName.size() + 1) * sizeof(char);
-				myName.memory = (uint8*)g_memory_allocate(myName.size);
-				std::strcpy((char*)myName.memory, World::localPlayerName.c_str());
-				myName.memory[World::localPlayerName.size()] = '\0';
-				g_logger_info("Client '%s' responding to handshake.", (char*)myName.memory);
-				Network::sendClientCommand(ClientCommandType::ClientLoadInfo, myName);
-				g_memory_free(myName.memory);
-			}
-			break;
-			case ClientCommandType::CalculateLighting:
-			{
-				glm::vec3 lastPlayerPos;
-				SizedMemory sizedData = SizedMemory{ (uint8*)clientCommandData, command->sizeOfData };
-				unpack<glm::vec3>(
-					sizedData,
-					&lastPlayerPos
-				);
-
-				glm::ivec2 playerPosChunkCoords = World::toChunkCoords(lastPlayerPos);
-				ChunkManager::setPlayerChunkPos(playerPosChunkCoords);
-				ChunkManager::queueCalculateLighting(playerPosChunkCoords);
+				// Our name followed by the chunks we still have from the last time we joined
+				// Name (null terminated) -> NumCachedChunks (uint32) -> CachedChunkVersion * NumCachedChunks
+				std::vector<CachedChunkVersion> cachedVersions = ClientChunkCache::getVersions();
+				uint32 numCachedChunks = (uint32)cachedVersions.size();
+				size_t nameSize = (World::localPlayerName.size() + 1) * sizeof(char);
+				SizedMemory loadInfo;
+				loadInfo.size = nameSize + sizeof(uint32) + sizeof(CachedChunkVersion) * numCachedChunks;
+				loadInfo.memory = (uint8*)g_memory_allocate(loadInfo.size);
+				std::strcpy((char*)loadInfo.memory, World::localPlayerName.c_str());
+				loadInfo.memory[World::localPlayerName.size()] = '\0';
+				g_memory_copyMem(loadInfo.memory + nameSize, &numCachedChunks, sizeof(uint32));
+				if (numCachedChunks > 0)
+				{
+					g_memory_copyMem(loadInfo.memory + nameSize + sizeof(uint32), cachedVersions.data(), sizeof(CachedChunkVersion) * numCachedChunks);
+				}
+				g_logger_info("Client '%s' responding to handshake with %u cached chunks.", (char*)loadInfo.memory, numCachedChunks);
+				Network::sendClientCommand(ClientCommandType::ClientLoadInfo, loadInfo);
+				g_memory_free(loadInfo.memory);
 			}
 			break;
 			case ClientCommandType::SetTime:
@@ -461,5 +510,75 @@ namespace Minecraft
 			break;
 			}
 		}
+
+		static void sendTransforms()
+		{
+			if (latestTransforms.empty() || !peer)
+			{
+				return;
+			}
+
+			std::vector<EntityTransform> transforms;
+			transforms.reserve(latestTransforms.size());
+			for (const auto& [entity, entityTransform] : latestTransforms)
+			{
+				transforms.push_back(entityTransform);
+			}
+
+			// Keyframes have to make it, dropping a delta just means the next one fixes it
+			static std::vector<uint8> keyframeData;
+			static std::vector<uint8> deltaData;
+			transformEncoder.encode(transforms, keyframeData, deltaData);
+			if (!keyframeData.empty())
+			{
+				Network::sendUserCommand(UserCommandType::UpdateTransform, SizedMemory{ keyframeData.data(), keyframeData.size() }, nullptr, true);
+				DebugStats::transformBytesSent += sizeof(NetworkEvent) + sizeof(UserCommand) + keyframeData.size();
+			}
+			if (!deltaData.empty())
+			{
+				Network::sendUserCommand(UserCommandType::UpdateTransform, SizedMemory{ deltaData.data(), deltaData.size() }, nullptr, false);
+				DebugStats::transformBytesSent += sizeof(NetworkEvent) + sizeof(UserCommand) + deltaData.size();
+			}
+			DebugStats::transformBytesUncompressed += transforms.size() * TransformStream::uncompressedSize();
+		}
+
+		static void updateRemoteTransforms()
+		{
+			// Remote entities get moved every frame instead of only when an update for them comes in
+			static std::vector<Ecs::EntityId> leftEntities;
+			leftEntities.clear();
+			Ecs::Registry* registry = Scene::getRegistry();
+			for (const auto& [entity, ring] : transformCommandBuffer.entities)
+			{
+				if (transformDecoder.entities.find(entity) == transformDecoder.entities.end())
+				{
+					// The server stopped sending us this one
+					leftEntities.push_back(entity);
+					continue;
+				}
+
+				// Stay lagInMs behind so there's usually a snapshot on both sides to interpolate between
+				glm::vec3 position, orientation;
+				if (registry->hasComponent<Transform>(entity) && transformCommandBuffer.predict(lagInMs, entity, &position, &orientation))
+				{
+					Transform& transform = registry->getComponent<Transform>(entity);
+					transform.position = position;
+					transform.orientation = orientation;
+				}
+			}
+
+			for (Ecs::EntityId entity : leftEntities)
+			{
+				transformCommandBuffer.remove(entity);
+			}
+		}
+
+		static void requestChunk(const glm::ivec2& chunkCoords)
+		{
+			// The server streams it again as long as it's still in range of our player
+			SizedMemory missData = pack<glm::ivec2>(chunkCoords);
+			Network::sendClientCommand(ClientCommandType::ChunkCacheMiss, missData);
+			g_memory_free(missData.memory);
+		}
 	}
-}
+}
\ No newline at end of file
@@ -0,0 +1,125 @@
+#include "network/ClientChunkCache.h"
+#include "world/ChunkCodec.h"
+#include "utils/Settings.h"
+
+#include <list>
+
+namespace Minecraft
+{
+	namespace ClientChunkCache
+	{
+		struct CachedChunk
+		{
+			uint8* data;
+			size_t size;
+			uint64 version;
+			std::list<glm::ivec2>::iterator lruPosition;
+		};
+
+		// Internal members
+		// Only used on the main thread, so unlike the standby cache there's no lock
+		static robin_hood::unordered_flat_map<glm::ivec2, CachedChunk> cachedChunks;
+		// Most recently used at the front
+		static std::list<glm::ivec2> lruOrder;
+		static size_t totalBytes = 0;
+
+		// Internal functions
+		static void release(CachedChunk& cachedChunk);
+		static void evictToBudget();
+
+		void insert(const glm::ivec2& chunkCoords, const uint8* encodedData, size_t encodedSize)
+		{
+			auto iter = cachedChunks.find(chunkCoords);
+			if (iter != cachedChunks.end())
+			{
+				release(iter->second);
+				cachedChunks.erase(iter);
+			}
+
+			CachedChunk cachedChunk;
+			cachedChunk.data = (uint8*)g_memory_allocate(encodedSize);
+			cachedChunk.size = encodedSize;
+			cachedChunk.version = ChunkCodec::contentVersion(encodedData, encodedSize);
+			g_memory_copyMem(cachedChunk.data, (void*)encodedData, encodedSize);
+			lruOrder.push_front(chunkCoords);
+			cachedChunk.lruPosition = lruOrder.begin();
+			cachedChunks[chunkCoords] = cachedChunk;
+			totalBytes += encodedSize;
+
+			evictToBudget();
+		}
+
+		uint8* copy(const glm::ivec2& chunkCoords, size_t* encodedSize)
+		{
+			auto iter = cachedChunks.find(chunkCoords);
+			if (iter == cachedChunks.end())
+			{
+				return nullptr;
+			}
+
+			// The chunk stays cached for the next time we join
+			CachedChunk& cachedChunk = iter->second;
+			lruOrder.splice(lruOrder.begin(), lruOrder, cachedChunk.lruPosition);
+			uint8* data = (uint8*)g_memory_allocate(cachedChunk.size);
+			g_memory_copyMem(data, cachedChunk.data, cachedChunk.size);
+			*encodedSize = cachedChunk.size;
+			return data;
+		}
+
+		std::vector<CachedChunkVersion> getVersions()
+		{
+			std::vector<CachedChunkVersion> versions;
+			versions.reserve(glm::min((size_t)maxAdvertisedChunks, cachedChunks.size()));
+			for (const glm::ivec2& chunkCoords : lruOrder)
+			{
+				if (versions.size() >= maxAdvertisedChunks)
+				{
+					break;
+				}
+				versions.push_back({ chunkCoords, cachedChunks.find(chunkCoords)->second.version });
+			}
+			return versions;
+		}
+
+		void clear()
+		{
+			for (auto& [chunkCoords, cachedChunk] : cachedChunks)
+			{
+				g_memory_free(cachedChunk.data);
+			}
+			cachedChunks.clear();
+			lruOrder.clear();
+			totalBytes = 0;
+		}
+
+		size_t numChunks()
+		{
+			return cachedChunks.size();
+		}
+
+		size_t memoryUsed()
+		{
+			return totalBytes;
+		}
+
+		// =====================================================
+		// Internal functions
+		// =====================================================
+		static void release(CachedChunk& cachedChunk)
+		{
+			g_memory_free(cachedChunk.data);
+			lruOrder.erase(cachedChunk.lruPosition);
+			totalBytes -= cachedChunk.size;
+		}
+
+		static void evictToBudget()
+		{
+			while (totalBytes > Settings::Chunks::clientCacheBudget && !lruOrder.empty())
+			{
+				auto iter = cachedChunks.find(lruOrder.back());
+				release(iter->second);
+				cachedChunks.erase(iter);
+			}
+		}
+	}
+}
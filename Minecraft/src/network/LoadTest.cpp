@@ -0,0 +1,550 @@
+#include "network/LoadTest.h"
+#include "network/Network.h"
+#include "network/Server.h"
+#include "network/TransformStream.h"
+#include "network/NetworkStats.h"
+#include "world/World.h"
+#include "world/BlockMap.h"
+#include "utils/Settings.h"
+
+#include <enet/enet.h>
+
+namespace Minecraft
+{
+	namespace LoadTest
+	{
+		using Clock = std::chrono::steady_clock;
+
+		struct Bot
+		{
+			ENetHost* host;
+			ENetPeer* peer;
+			char name[32];
+			Ecs::EntityId player;
+			bool isConnected;
+			bool hasSpawned;
+			// Server game time minus the test clock, in milliseconds, from the last time sync
+			int64 serverTimeOffset;
+			glm::vec3 pathCenter;
+			float pathAngle;
+			glm::vec3 blockPosition;
+			bool hasPlacedBlock;
+			float nextBlockAction;
+			float nextChat;
+			float nextPing;
+			TransformEncoder transformEncoder;
+			// Commands get batched into one packet per update just like the real client does it
+			std::vector<uint8> pendingCommands;
+			uint64 bytesSent;
+			uint64 bytesReceived;
+		};
+
+		// Internal variables
+		static std::vector<Bot> bots;
+		static std::thread botThread;
+		static std::atomic<bool> isRunning = false;
+		static bool isActive = false;
+		static Clock::time_point startTime;
+		static float duration;
+		static glm::vec3 spawnPosition;
+		static Block placedBlock;
+
+		// Tick times are recorded on the game thread, everything else on the bot thread until it's joined
+		static std::vector<float> tickTimes;
+		static std::vector<float> chatLatencies;
+		static std::vector<float> pingTimes;
+
+		static constexpr uint32 maxBots = 32;
+		static constexpr float pathRadius = 8.0f;
+		static constexpr float walkSpeed = 4.3f;
+		static constexpr float blockActionInterval = 2.0f;
+		static constexpr float chatInterval = 5.0f;
+		static constexpr float pingInterval = 1.0f;
+		static constexpr float disconnectTimeout = 1.0f;
+
+		// Internal functions
+		static void runBots();
+		static void updateBot(Bot& bot, float time, float deltaTime);
+		static void processPacket(Bot& bot, ENetPacket* packet);
+		static void processClientCommand(Bot& bot, ClientCommand* command, void* commandData);
+		static void sendTransform(Bot& bot);
+		static void sendUserCommand(Bot& bot, UserCommandType type, const std::vector<uint8>& data, bool isReliable);
+		static void queueClientCommand(Bot& bot, ClientCommandType type, const SizedMemory& data);
+		static void flushCommands(Bot& bot);
+		static void sendPacket(Bot& bot, ENetPacket* packet, NetworkChannel channel);
+		static float secondsSinceStart();
+		static uint64 microsecondsSinceStart();
+		static void logPercentiles(const char* name, std::vector<float>& values);
+
+		void start(uint32 numBots, uint32 durationInSeconds)
+		{
+			g_logger_assert(!isActive, "Cannot start a load test twice.");
+			uint16 port = Server::getPort();
+			if (port == 0)
+			{
+				g_logger_error("Cannot start a load test without a running server.");
+				return;
+			}
+
+			if (numBots > maxBots)
+			{
+				g_logger_warning("The server only has room for '%u' clients, running the load test with that many bots instead of '%u'.", maxBots, numBots);
+				numBots = maxBots;
+			}
+
+			spawnPosition = World::getSpawnPosition();
+			placedBlock = Block{ 0, 0, 0, 0 };
+			placedBlock.id = BlockMap::getBlockId("stone");
+			duration = (float)durationInSeconds;
+			tickTimes.clear();
+			tickTimes.reserve(durationInSeconds * Settings::Server::ticksPerSecond);
+			chatLatencies.clear();
+			pingTimes.clear();
+
+			ENetAddress address;
+			enet_address_set_host(&address, "127.0.0.1");
+			address.port = port;
+
+			bots.resize(numBots);
+			for (uint32 i = 0; i < numBots; i++)
+			{
+				Bot& bot = bots[i];
+				std::snprintf(bot.name, sizeof(bot.name), "Bot%u", i);
+				bot.player = Ecs::nullEntity;
+				bot.isConnected = false;
+				bot.hasSpawned = false;
+				bot.serverTimeOffset = 0;
+				bot.hasPlacedBlock = false;
+				bot.bytesSent = 0;
+				bot.bytesReceived = 0;
+
+				// Every bot walks its own circle, rings of them spread out around spawn
+				float ringAngle = glm::radians(45.0f * (float)(i % 8));
+				float ringRadius = pathRadius * 2.5f * (float)(i / 8 + 1);
+				bot.pathCenter = spawnPosition + glm::vec3(glm::cos(ringAngle) * ringRadius, 0.0f, glm::sin(ringAngle) * ringRadius);
+				bot.pathAngle = ringAngle;
+
+				// Stagger everything so the bots don't all act on the same update
+				bot.nextBlockAction = blockActionInterval * (float)i / (float)numBots;
+				bot.nextChat = chatInterval * (float)i / (float)numBots;
+				bot.nextPing = 0.0f;
+
+				// Each bot gets its own host, just like a client running in its own process
+				bot.host = enet_host_create(NULL, 1, 2, 0, 0);
+				bot.peer = bot.host ? enet_host_connect(bot.host, &address, 2, 0) : nullptr;
+				if (!bot.peer)
+				{
+					g_logger_error("<LoadTest> Failed to create a connection for '%s'.", bot.name);
+				}
+			}
+
+			g_logger_info("<LoadTest> Connecting %u bots to port %u for %u seconds.", numBots, port, durationInSeconds);
+			startTime = Clock::now();
+			isActive = true;
+			isRunning = true;
+			botThread = std::thread(runBots);
+		}
+
+		void recordTick(float tickTimeInSeconds)
+		{
+			if (isActive)
+			{
+				tickTimes.push_back(tickTimeInSeconds * 1000.0f);
+			}
+		}
+
+		bool isFinished()
+		{
+			return isActive && secondsSinceStart() >= duration;
+		}
+
+		void stop()
+		{
+			if (!isActive)
+			{
+				return;
+			}
+
+			isRunning = false;
+			if (botThread.joinable())
+			{
+				botThread.join();
+			}
+
+			float elapsed = glm::max(secondsSinceStart(), 0.001f);
+			uint32 numSpawned = 0;
+			float totalDown = 0.0f, totalUp = 0.0f;
+			float minDown = FLT_MAX, maxDown = 0.0f;
+			for (const Bot& bot : bots)
+			{
+				if (bot.player != Ecs::nullEntity)
+				{
+					numSpawned++;
+				}
+
+				float down = (float)bot.bytesReceived / 1024.0f / elapsed;
+				float up = (float)bot.bytesSent / 1024.0f / elapsed;
+				totalDown += down;
+				totalUp += up;
+				minDown = glm::min(minDown, down);
+				maxDown = glm::max(maxDown, down);
+			}
+
+			float numBots = (float)glm::max(bots.size(), (size_t)1);
+			float tickBudget = 1000.0f / (float)Settings::Server::ticksPerSecond;
+			size_t numSlowTicks = std::count_if(tickTimes.begin(), tickTimes.end(), [tickBudget](float tickTime) { return tickTime > tickBudget; });
+			g_logger_info("<LoadTest> %zu bots ran for %2.1f seconds, %u of them spawned.", bots.size(), elapsed, numSpawned);
+			logPercentiles("Server tick (ms)", tickTimes);
+			g_logger_info("<LoadTest> %zu of %zu ticks went over the %2.2fms budget.", numSlowTicks, tickTimes.size(), tickBudget);
+			g_logger_info("<LoadTest> Per client down: %2.2fKB/s average, %2.2fKB/s min, %2.2fKB/s max. Up: %2.2fKB/s average.",
+				totalDown / numBots, bots.empty() ? 0.0f : minDown, maxDown, totalUp / numBots);
+			logPercentiles("Chat, client to client (ms)", chatLatencies);
+			logPercentiles("Ping round trip (ms)", pingTimes);
+
+			// What the server's traffic was made of during the test
+			std::string statsFilepath = World::savePath + "/loadTestNetworkStats.csv";
+			NetworkStats::dumpCsv(statsFilepath.c_str());
+
+			bots.clear();
+			isActive = false;
+		}
+
+		// =====================================================
+		// Internal functions
+		// =====================================================
+		static void runBots()
+		{
+			const float updateInterval = 1.0f / (float)Settings::Server::ticksPerSecond;
+			float nextUpdate = 0.0f;
+			while (isRunning)
+			{
+				for (Bot& bot : bots)
+				{
+					if (!bot.host)
+					{
+						continue;
+					}
+
+					ENetEvent event;
+					while (enet_host_service(bot.host, &event, 0) > 0)
+					{
+						switch (event.type)
+						{
+						case ENET_EVENT_TYPE_CONNECT:
+							bot.isConnected = true;
+							break;
+						case ENET_EVENT_TYPE_RECEIVE:
+							bot.bytesReceived += event.packet->dataLength;
+							processPacket(bot, event.packet);
+							enet_packet_destroy(event.packet);
+							break;
+						case ENET_EVENT_TYPE_DISCONNECT:
+							g_logger_warning("<LoadTest> '%s' got disconnected.", bot.name);
+							bot.isConnected = false;
+							bot.hasSpawned = false;
+							break;
+						default:
+							break;
+						}
+					}
+				}
+
+				float time = secondsSinceStart();
+				if (time >= nextUpdate)
+				{
+					for (Bot& bot : bots)
+					{
+						if (bot.isConnected)
+						{
+							updateBot(bot, time, updateInterval);
+							flushCommands(bot);
+						}
+					}
+
+					// Same as the server, a slow update doesn't get caught up on
+					nextUpdate = glm::max(nextUpdate + updateInterval, time);
+				}
+
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+
+			// Say goodbye so the server doesn't have to wait for the bots to time out
+			for (Bot& bot : bots)
+			{
+				if (bot.isConnected)
+				{
+					enet_peer_disconnect(bot.peer, 0);
+				}
+			}
+
+			Clock::time_point deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(disconnectTimeout));
+			bool anyConnected = true;
+			while (anyConnected && Clock::now() < deadline)
+			{
+				anyConnected = false;
+				for (Bot& bot : bots)
+				{
+					if (!bot.isConnected)
+					{
+						continue;
+					}
+
+					ENetEvent event;
+					while (enet_host_service(bot.host, &event, 0) > 0)
+					{
+						if (event.type == ENET_EVENT_TYPE_RECEIVE)
+						{
+							enet_packet_destroy(event.packet);
+						}
+						else if (event.type == ENET_EVENT_TYPE_DISCONNECT)
+						{
+							bot.isConnected = false;
+						}
+					}
+					anyConnected = anyConnected || bot.isConnected;
+				}
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+
+			for (Bot& bot : bots)
+			{
+				if (bot.host)
+				{
+					enet_host_destroy(bot.host);
+					bot.host = nullptr;
+					bot.peer = nullptr;
+				}
+			}
+		}
+
+		static void updateBot(Bot& bot, float time, float deltaTime)
+		{
+			if (!bot.hasSpawned)
+			{
+				return;
+			}
+
+			bot.pathAngle += walkSpeed / pathRadius * deltaTime;
+			sendTransform(bot);
+
+			if (time >= bot.nextPing)
+			{
+				SizedMemory pingData = pack<uint64, uint64, uint64>(microsecondsSinceStart(), 0, 0);
+				queueClientCommand(bot, ClientCommandType::ServerTime, pingData);
+				g_memory_free(pingData.memory);
+				bot.nextPing = time + pingInterval;
+			}
+
+			if (time >= bot.nextBlockAction)
+			{
+				// Build a block over the middle of the path and break it again on the next action
+				if (bot.hasPlacedBlock)
+				{
+					SizedMemory blockData = pack<glm::vec3>(bot.blockPosition);
+					queueClientCommand(bot, ClientCommandType::RemoveBlock, blockData);
+					g_memory_free(blockData.memory);
+				}
+				else
+				{
+					bot.blockPosition = glm::floor(bot.pathCenter) + glm::vec3(0.5f, 3.5f, 0.5f);
+					SizedMemory blockData = pack<glm::vec3, Block>(bot.blockPosition, placedBlock);
+					queueClientCommand(bot, ClientCommandType::SetBlock, blockData);
+					g_memory_free(blockData.memory);
+				}
+				bot.hasPlacedBlock = !bot.hasPlacedBlock;
+				bot.nextBlockAction = time + blockActionInterval;
+			}
+
+			if (time >= bot.nextChat)
+			{
+				// Everyone else gets the message relayed through the server, the send time in it
+				// is how they measure the latency
+				char message[64];
+				int messageLength = std::snprintf(message, sizeof(message), "%s %llu", bot.name, (unsigned long long)microsecondsSinceStart());
+				std::vector<uint8> chatData((size_t)messageLength + 1 + sizeof(Ecs::EntityId));
+				g_memory_copyMem(chatData.data(), message, (size_t)messageLength + 1);
+				g_memory_copyMem(chatData.data() + messageLength + 1, &bot.player, sizeof(Ecs::EntityId));
+				queueClientCommand(bot, ClientCommandType::Chat, SizedMemory{ chatData.data(), chatData.size() });
+				bot.nextChat = time + chatInterval;
+			}
+		}
+
+		static void processPacket(Bot& bot, ENetPacket* packet)
+		{
+			if (packet->dataLength < sizeof(NetworkEvent))
+			{
+				g_logger_error("<LoadTest> '%s' recieved a packet that's too small to hold an event.", bot.name);
+				return;
+			}
+
+			NetworkEvent* event = (NetworkEvent*)packet->data;
+			uint8* data = packet->data + sizeof(NetworkEvent);
+			if (event->dataSize != packet->dataLength - sizeof(NetworkEvent))
+			{
+				g_logger_error("<LoadTest> '%s' recieved an event with the wrong size.", bot.name);
+				return;
+			}
+
+			switch (event->type)
+			{
+			case NetworkEventType::ChunkData:
+			{
+				// The chunks get thrown away, acking them is all it takes to keep the server streaming
+				SizedMemory ackData = pack<uint32>((uint32)event->dataSize);
+				queueClientCommand(bot, ClientCommandType::ChunkAck, ackData);
+				g_memory_free(ackData.memory);
+			}
+			break;
+			case NetworkEventType::LocalPlayer:
+			{
+				if (event->dataSize >= sizeof(Ecs::EntityId))
+				{
+					g_memory_copyMem(&bot.player, data, sizeof(Ecs::EntityId));
+					bot.hasSpawned = true;
+				}
+			}
+			break;
+			case NetworkEventType::ClientCommand:
+			{
+				size_t offset = 0;
+				ClientCommand* command;
+				void* commandData;
+				while (Network::readClientCommand(data, event->dataSize, &offset, &command, &commandData))
+				{
+					processClientCommand(bot, command, commandData);
+				}
+			}
+			break;
+			default:
+				// The world seed, entity data and transforms only count towards the bandwidth
+				break;
+			}
+		}
+
+		static void processClientCommand(Bot& bot, ClientCommand* command, void* commandData)
+		{
+			switch (command->type)
+			{
+			case ClientCommandType::Handshake:
+			{
+				queueClientCommand(bot, ClientCommandType::ClientLoadInfo, SizedMemory{ (uint8*)bot.name, std::strlen(bot.name) + 1 });
+			}
+			break;
+			case ClientCommandType::ServerTime:
+			{
+				uint64 sentAt, serverTime, serverGameTime;
+				SizedMemory sizedData = SizedMemory{ (uint8*)commandData, command->sizeOfData };
+				unpack<uint64, uint64, uint64>(
+					sizedData,
+					&sentAt,
+					&serverTime,
+					&serverGameTime
+					);
+
+				uint64 now = microsecondsSinceStart();
+				float roundTrip = (float)(now - sentAt) / 1000.0f;
+				pingTimes.push_back(roundTrip);
+				bot.serverTimeOffset = (int64)serverGameTime + (int64)(roundTrip / 2.0f) - (int64)(now / 1000);
+			}
+			break;
+			case ClientCommandType::Chat:
+			{
+				unsigned long long sentAt;
+				const char* message = (const char*)commandData;
+				if (std::memchr(message, '\0', command->sizeOfData) && std::sscanf(message, "%*s %llu", &sentAt) == 1)
+				{
+					chatLatencies.push_back((float)(microsecondsSinceStart() - (uint64)sentAt) / 1000.0f);
+				}
+			}
+			break;
+			default:
+				// Block edits and everything else are just part of the traffic
+				break;
+			}
+		}
+
+		static void sendTransform(Bot& bot)
+		{
+			EntityTransform transform;
+			transform.entity = bot.player;
+			transform.position = bot.pathCenter + glm::vec3(glm::cos(bot.pathAngle) * pathRadius, 0.0f, glm::sin(bot.pathAngle) * pathRadius);
+			// Facing the way it's walking
+			transform.orientation = glm::vec3(0.0f, glm::degrees(bot.pathAngle) + 90.0f, 0.0f);
+
+			static std::vector<EntityTransform> transforms;
+			static std::vector<uint8> keyframeData;
+			static std::vector<uint8> deltaData;
+			transforms.clear();
+			transforms.push_back(transform);
+			bot.transformEncoder.encode(transforms, keyframeData, deltaData);
+			if (!keyframeData.empty())
+			{
+				sendUserCommand(bot, UserCommandType::UpdateTransform, keyframeData, true);
+			}
+			if (!deltaData.empty())
+			{
+				sendUserCommand(bot, UserCommandType::UpdateTransform, deltaData, false);
+			}
+		}
+
+		static void sendUserCommand(Bot& bot, UserCommandType type, const std::vector<uint8>& data, bool isReliable)
+		{
+			// Framed by the same code the real client uses, the bot only owns the ENet host it goes out on
+			uint64 timestamp = (uint64)((int64)(microsecondsSinceStart() / 1000) + bot.serverTimeOffset);
+			EventPacket eventPacket = Network::encodeUserCommand(type, timestamp, SizedMemory{ (uint8*)data.data(), data.size() }, isReliable);
+			sendPacket(bot, eventPacket.packet, NetworkChannel::Transforms);
+		}
+
+		static void queueClientCommand(Bot& bot, ClientCommandType type, const SizedMemory& data)
+		{
+			Network::appendClientCommand(bot.pendingCommands, type, data);
+		}
+
+		static void flushCommands(Bot& bot)
+		{
+			if (bot.pendingCommands.empty())
+			{
+				return;
+			}
+
+			sendPacket(bot, Network::encodeClientCommandBatch(bot.pendingCommands), NetworkChannel::Events);
+		}
+
+		static void sendPacket(Bot& bot, ENetPacket* packet, NetworkChannel channel)
+		{
+			bot.bytesSent += packet->dataLength;
+			if (enet_peer_send(bot.peer, (uint8)channel, packet) != 0)
+			{
+				g_logger_error("<LoadTest> '%s' failed to send a packet.", bot.name);
+				enet_packet_destroy(packet);
+			}
+		}
+
+		static float secondsSinceStart()
+		{
+			return std::chrono::duration<float>(Clock::now() - startTime).count();
+		}
+
+		static uint64 microsecondsSinceStart()
+		{
+			return (uint64)std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - startTime).count();
+		}
+
+		static void logPercentiles(const char* name, std::vector<float>& values)
+		{
+			if (values.empty())
+			{
+				g_logger_info("<LoadTest> %s: no samples.", name);
+				return;
+			}
+
+			std::sort(values.begin(), values.end());
+			auto percentile = [&values](float p)
+			{
+				return values[glm::min((size_t)(p * (float)values.size()), values.size() - 1)];
+			};
+			g_logger_info("<LoadTest> %s: p50 %2.2f, p95 %2.2f, p99 %2.2f, max %2.2f over %zu samples.",
+				name, percentile(0.5f), percentile(0.95f), percentile(0.99f), values.back(), values.size());
+		}
+	}
+}
@@ -1,30 +1,35 @@
 #include "network/Network.h"
 #include "network/Server.h"
 #include "network/Client.h"
+#include "network/NetworkStats.h"
 
 #include <enet/enet.h>
 
 namespace Minecraft
 {
-	struct NetworkPacket
-	{
-		uint8* data;
-		size_t size;
-	};
-
 	namespace Network
 	{
 		// Internal variables
 		static bool isServer;
 		static bool isInitialized = false;
 
+		// Client commands get collected here and sent as one packet per peer each update. Each buffer
+		// starts with room for the NetworkEvent so it can be handed to ENet as is. The null peer is
+		// the server on the client, and everyone on the server.
+		static robin_hood::unordered_node_map<ENetPeer*, std::vector<uint8>> pendingCommands;
+		// Big batches go out early instead of waiting for the update to finish
+		static constexpr size_t maxCommandBatchSize = 32 * 1024;
+
 		// Internal functions
-		static NetworkPacket createPacket(NetworkEventType eventType, void* data, size_t dataSizeInBytes);
+		static void routePacket(ENetPeer* peer, ENetPacket* packet, NetworkChannel channel);
+		static void flushCommands();
+		static void flushCommands(ENetPeer* peer, std::vector<uint8>& batch);
 
 		void init(bool inIsServer)
 		{
 			g_logger_assert(!isInitialized, "Cannot initailze the network code twice.");
 			isServer = inIsServer;
+			NetworkStats::reset();
 
 			if (enet_initialize() != 0)
 			{
@@ -48,6 +53,8 @@ namespace Minecraft
 		{
 			if (isInitialized)
 			{
+				// Send everything queued since the last update, then anything queued while processing this one
+				flushCommands();
 				if (isServer)
 				{
 					Server::update();
@@ -56,117 +63,220 @@ namespace Minecraft
 				{
 					Client::update();
 				}
+				flushCommands();
 			}
 		}
 
-		void sendServer(NetworkEventType eventType, void* data, size_t dataSizeInBytes, bool isReliable)
+		EventPacket beginEvent(NetworkEventType eventType, size_t maxDataSizeInBytes, bool isReliable)
 		{
-			g_logger_assert(!isServer, "Cannot send server a message from the server.");
-			NetworkPacket networkPacket = createPacket(eventType, data, dataSizeInBytes);
 			_ENetPacketFlag packetFlag = isReliable
 				? ENET_PACKET_FLAG_RELIABLE
 				: ENET_PACKET_FLAG_UNRELIABLE_FRAGMENT;
-			ENetPacket* packet = enet_packet_create(networkPacket.data, networkPacket.size, packetFlag);
-			Client::sendServer(packet);
-			g_memory_free(networkPacket.data);
+			// ENet allocates the buffer without copying anything into it when there's no data
+			ENetPacket* packet = enet_packet_create(NULL, sizeof(NetworkEvent) + maxDataSizeInBytes, packetFlag);
+			NetworkEvent* networkEvent = (NetworkEvent*)packet->data;
+			networkEvent->type = eventType;
+			networkEvent->dataSize = maxDataSizeInBytes;
+
+			EventPacket res;
+			res.packet = packet;
+			res.data = packet->data + sizeof(NetworkEvent);
+			res.maxDataSize = maxDataSizeInBytes;
+			return res;
 		}
 
-		void sendClient(ENetPeer* peer, NetworkEventType eventType, void* data, size_t dataSizeInBytes, bool isReliable)
+		void sendEvent(ENetPeer* peer, EventPacket& eventPacket, size_t dataSizeInBytes, NetworkChannel channel)
 		{
-			g_logger_assert(isServer, "Cannot send client a message from the client.");
-			NetworkPacket networkPacket = createPacket(eventType, data, dataSizeInBytes);
-			_ENetPacketFlag packetFlag = isReliable
-				? ENET_PACKET_FLAG_RELIABLE
-				: ENET_PACKET_FLAG_UNRELIABLE_FRAGMENT;
-			ENetPacket* packet = enet_packet_create(networkPacket.data, networkPacket.size, packetFlag);
-			Server::sendClient(peer, packet);
-			g_memory_free(networkPacket.data);
+			g_logger_assert(dataSizeInBytes <= eventPacket.maxDataSize, "Wrote '%zu' bytes into an event packet that only has room for '%zu'.", dataSizeInBytes, eventPacket.maxDataSize);
+			if (channel == NetworkChannel::Events)
+			{
+				// Keep the events in order with any commands that were queued before them
+				flushCommands();
+			}
+
+			// Shrinking a packet never reallocates it
+			NetworkEvent* networkEvent = (NetworkEvent*)eventPacket.packet->data;
+			networkEvent->dataSize = dataSizeInBytes;
+			enet_packet_resize(eventPacket.packet, sizeof(NetworkEvent) + dataSizeInBytes);
+			routePacket(peer, eventPacket.packet, channel);
+			eventPacket.packet = nullptr;
+			eventPacket.data = nullptr;
 		}
 
-		void broadcast(NetworkEventType eventType, void* data, size_t dataSizeInBytes, bool isReliable)
+		void sendServer(NetworkEventType eventType, void* data, size_t dataSizeInBytes, bool isReliable, NetworkChannel channel)
 		{
-			NetworkPacket networkPacket = createPacket(eventType, data, dataSizeInBytes);
-			_ENetPacketFlag packetFlag = isReliable
-				? ENET_PACKET_FLAG_RELIABLE
-				: ENET_PACKET_FLAG_UNRELIABLE_FRAGMENT;
-			ENetPacket* packet = enet_packet_create(networkPacket.data, networkPacket.size, packetFlag);
-
-			if (isServer)
+			g_logger_assert(!isServer, "Cannot send server a message from the server.");
+			EventPacket eventPacket = beginEvent(eventType, dataSizeInBytes, isReliable);
+			if (dataSizeInBytes > 0)
 			{
-				Server::broadcast(packet);
+				g_memory_copyMem(eventPacket.data, data, dataSizeInBytes);
 			}
-			else
+			sendEvent(nullptr, eventPacket, dataSizeInBytes, channel);
+		}
+
+		void sendClient(ENetPeer* peer, NetworkEventType eventType, void* data, size_t dataSizeInBytes, bool isReliable, NetworkChannel channel)
+		{
+			g_logger_assert(isServer, "Cannot send client a message from the client.");
+			g_logger_assert(peer != nullptr, "Cannot send a message to a null client.");
+			EventPacket eventPacket = beginEvent(eventType, dataSizeInBytes, isReliable);
+			if (dataSizeInBytes > 0)
 			{
-				Client::sendServer(packet);
+				g_memory_copyMem(eventPacket.data, data, dataSizeInBytes);
 			}
+			sendEvent(peer, eventPacket, dataSizeInBytes, channel);
+		}
 
-			g_memory_free(networkPacket.data);
+		void broadcast(NetworkEventType eventType, void* data, size_t dataSizeInBytes, bool isReliable, NetworkChannel channel)
+		{
+			// ENet hands the same packet to every peer and frees it once the last one is done with it
+			EventPacket eventPacket = beginEvent(eventType, dataSizeInBytes, isReliable);
+			if (dataSizeInBytes > 0)
+			{
+				g_memory_copyMem(eventPacket.data, data, dataSizeInBytes);
+			}
+			sendEvent(nullptr, eventPacket, dataSizeInBytes, channel);
 		}
 
-		void sendUserCommand(UserCommandType type, const SizedMemory& data, ENetPeer* peer)
+		void sendUserCommand(UserCommandType type, const SizedMemory& data, ENetPeer* peer, bool isReliable)
 		{
 			if (isInitialized)
 			{
-				size_t sizeOfCommand = sizeof(UserCommand) + data.size;
-				void* commandData = g_memory_allocate(sizeOfCommand);
-				UserCommand* command = (UserCommand*)commandData;
-				command->type = type;
-				command->sizeOfData = data.size;
-				uint8* dataDst = (uint8*)commandData + sizeof(UserCommand);
-				g_memory_copyMem(dataDst, data.memory, data.size);
+				uint64 timestamp = isServer ? Server::serverGameTime : Client::clientGameTime;
+				EventPacket eventPacket = encodeUserCommand(type, timestamp, data, isReliable);
+				sendEvent(isServer ? peer : nullptr, eventPacket, eventPacket.maxDataSize, NetworkChannel::Transforms);
+			}
+		}
 
-				if (!isServer)
-				{
-					command->timestamp = Client::clientGameTime;
-					sendServer(NetworkEventType::UserCommand, commandData, sizeOfCommand, false);
-				}
-				else
+		void sendClientCommand(ClientCommandType type, const SizedMemory& data, ENetPeer* peer)
+		{
+			if (isInitialized)
+			{
+				std::vector<uint8>& batch = pendingCommands[isServer ? peer : nullptr];
+				appendClientCommand(batch, type, data);
+				if (batch.size() >= maxCommandBatchSize)
 				{
-					command->timestamp = Server::serverGameTime;
-					if (peer)
-					{
-						sendClient(peer, NetworkEventType::UserCommand, commandData, sizeOfCommand, false);
-					}
-					else
-					{
-						broadcast(NetworkEventType::UserCommand, commandData, sizeOfCommand, false);
-					}
+					flushCommands(isServer ? peer : nullptr, batch);
 				}
+			}
+		}
 
-				g_memory_free(command);
+		bool readUserCommand(uint8* data, size_t dataSize, UserCommand** command, void** commandData)
+		{
+			// The size of the command's data comes off the wire, so it can't be trusted any more than the rest
+			if (!data || dataSize < sizeof(UserCommand))
+			{
+				g_logger_error("Recieved a user command that's too small to hold its header.");
+				return false;
+			}
+
+			UserCommand* userCommand = (UserCommand*)data;
+			if (userCommand->sizeOfData > dataSize - sizeof(UserCommand))
+			{
+				g_logger_error("Recieved a user command that runs past the end of the event.");
+				return false;
 			}
+
+			*command = userCommand;
+			*commandData = data + sizeof(UserCommand);
+			return true;
 		}
 
-		void sendClientCommand(ClientCommandType type, const SizedMemory& data, ENetPeer* peer)
+		bool readClientCommand(uint8* data, size_t dataSize, size_t* offset, ClientCommand** command, void** commandData)
 		{
-			if (isInitialized)
+			if (*offset >= dataSize)
+			{
+				return false;
+			}
+
+			if (dataSize - *offset < sizeof(ClientCommand))
 			{
-				size_t sizeOfCommand = sizeof(ClientCommand) + data.size;
-				void* commandData = g_memory_allocate(sizeOfCommand);
-				ClientCommand* command = (ClientCommand*)commandData;
-				command->type = type;
-				command->timestamp = 0;
-				command->sizeOfData = data.size;
-				uint8* dataDst = (uint8*)commandData + sizeof(ClientCommand);
-				g_memory_copyMem(dataDst, data.memory, data.size);
+				g_logger_error("Recieved a client command that's too small to hold its header.");
+				return false;
+			}
+
+			ClientCommand* nextCommand = (ClientCommand*)(data + *offset);
+			if (nextCommand->sizeOfData > dataSize - *offset - sizeof(ClientCommand))
+			{
+				g_logger_error("Recieved a client command that runs past the end of the event.");
+				return false;
+			}
+
+			*command = nextCommand;
+			*commandData = data + *offset + sizeof(ClientCommand);
+			*offset += paddedCommandSize(nextCommand->sizeOfData);
+			return true;
+		}
+
+		void dropPendingCommands(ENetPeer* peer)
+		{
+			pendingCommands.erase(peer);
+		}
+
+		EventPacket encodeUserCommand(UserCommandType type, uint64 timestamp, const SizedMemory& data, bool isReliable)
+		{
+			size_t sizeOfCommand = sizeof(UserCommand) + data.size;
+			EventPacket eventPacket = beginEvent(NetworkEventType::UserCommand, sizeOfCommand, isReliable);
+			UserCommand* command = (UserCommand*)eventPacket.data;
+			command->type = type;
+			command->timestamp = timestamp;
+			command->sizeOfData = data.size;
+			if (data.size > 0)
+			{
+				g_memory_copyMem(eventPacket.data + sizeof(UserCommand), data.memory, data.size);
+			}
+			return eventPacket;
+		}
+
+		void appendClientCommand(std::vector<uint8>& batch, ClientCommandType type, const SizedMemory& data)
+		{
+			if (batch.empty())
+			{
+				batch.resize(sizeof(NetworkEvent));
+			}
+
+			size_t offset = batch.size();
+			batch.resize(offset + paddedCommandSize(data.size), 0);
+			ClientCommand* command = (ClientCommand*)(batch.data() + offset);
+			command->type = type;
+			command->timestamp = 0;
+			command->sizeOfData = data.size;
+			if (data.size > 0)
+			{
+				g_memory_copyMem(batch.data() + offset + sizeof(ClientCommand), data.memory, data.size);
+			}
+		}
+
+		ENetPacket* encodeClientCommandBatch(std::vector<uint8>& batch)
+		{
+			g_logger_assert(batch.size() > sizeof(NetworkEvent), "Cannot send an empty batch of client commands.");
+			NetworkEvent* networkEvent = (NetworkEvent*)batch.data();
+			networkEvent->type = NetworkEventType::ClientCommand;
+			networkEvent->dataSize = batch.size() - sizeof(NetworkEvent);
+			ENetPacket* packet = enet_packet_create(batch.data(), batch.size(), ENET_PACKET_FLAG_RELIABLE);
+
+			// Keeps the capacity around for the next batch
+			batch.clear();
+			return packet;
+		}
+
+		size_t paddedCommandSize(size_t sizeOfData)
+		{
+			size_t size = sizeof(ClientCommand) + sizeOfData;
+			return (size + alignof(ClientCommand) - 1) & ~(alignof(ClientCommand) - 1);
+		}
 
-				if (!isServer)
+		void sendTransform(Ecs::EntityId entity, const glm::vec3& position, const glm::vec3& orientation)
+		{
+			if (isInitialized)
+			{
+				if (isServer)
 				{
-					sendServer(NetworkEventType::ClientCommand, commandData, sizeOfCommand);
+					Server::queueTransform(entity, position, orientation);
 				}
 				else
 				{
-					if (peer)
-					{
-						sendClient(peer, NetworkEventType::ClientCommand, commandData, sizeOfCommand);
-					}
-					else
-					{
-						broadcast(NetworkEventType::ClientCommand, commandData, sizeOfCommand);
-					}
+					Client::queueTransform(entity, position, orientation);
 				}
-
-				g_memory_free(command);
 			}
 		}
 
@@ -203,6 +313,7 @@ namespace Minecraft
 					Client::free();
 				}
 
+				pendingCommands.clear();
 				enet_deinitialize();
 			}
 		}
@@ -226,25 +337,50 @@ namespace Minecraft
 		}
 
 		// Internal functions
-		static NetworkPacket createPacket(NetworkEventType eventType, void* data, size_t dataSizeInBytes)
+		static void flushCommands()
 		{
-			// Copy event and data into the packet
-			size_t eventPlusDataSize = sizeof(NetworkEvent) + dataSizeInBytes;
-			// TODO: Create custom stack based memory allocator for the server messages
-			uint8* eventPlusData = (uint8*)g_memory_allocate(eventPlusDataSize);
-			NetworkEvent* networkEvent = (NetworkEvent*)eventPlusData;
-			networkEvent->dataSize = dataSizeInBytes;
-			networkEvent->type = eventType;
+			// Broadcasts go out before the commands queued for single peers, the two aren't kept in
+			// order with each other
+			auto broadcastIter = pendingCommands.find(nullptr);
+			if (broadcastIter != pendingCommands.end())
+			{
+				flushCommands(nullptr, broadcastIter->second);
+			}
 
-			if (dataSizeInBytes > 0)
+			for (auto& [peer, batch] : pendingCommands)
 			{
-				g_memory_copyMem(eventPlusData + sizeof(NetworkEvent), data, dataSizeInBytes);
+				flushCommands(peer, batch);
 			}
+		}
 
-			NetworkPacket res;
-			res.data = eventPlusData;
-			res.size = eventPlusDataSize;
-			return res;
+		static void flushCommands(ENetPeer* peer, std::vector<uint8>& batch)
+		{
+			if (batch.empty())
+			{
+				return;
+			}
+
+			routePacket(peer, encodeClientCommandBatch(batch), NetworkChannel::Events);
+		}
+
+		static void routePacket(ENetPeer* peer, ENetPacket* packet, NetworkChannel channel)
+		{
+			// Everything that gets sent comes through here
+			uint32 numRecipients = isServer && !peer ? Server::getNumConnectedClients() : 1;
+			NetworkStats::recordPacket(NetworkDirection::Sent, packet->data, packet->dataLength, numRecipients);
+
+			if (!isServer)
+			{
+				Client::sendServer(packet, channel);
+			}
+			else if (peer)
+			{
+				Server::sendClient(peer, packet, channel);
+			}
+			else
+			{
+				Server::broadcast(packet, channel);
+			}
 		}
 	}
 }
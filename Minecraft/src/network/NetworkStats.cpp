@@ -0,0 +1,288 @@
+#include "network/NetworkStats.h"
+
+#include <enet/enet.h>
+
+namespace Minecraft
+{
+	namespace NetworkStats
+	{
+		static constexpr size_t numEventTypes = magic_enum::enum_count<NetworkEventType>();
+		static constexpr size_t numUserCommandTypes = magic_enum::enum_count<UserCommandType>();
+		static constexpr size_t numClientCommandTypes = magic_enum::enum_count<ClientCommandType>();
+		static constexpr std::chrono::milliseconds peerSampleInterval = std::chrono::milliseconds(250);
+
+		// Internal variables
+		static NetworkCounter eventCounters[2][numEventTypes];
+		static NetworkCounter userCommandCounters[2][numUserCommandTypes];
+		static NetworkCounter clientCommandCounters[2][numClientCommandTypes];
+		static NetworkCounter emptyCounter;
+
+		// Written by the network thread, read on the game thread
+		static std::atomic<uint64> roundTripHistogram[numRoundTripBuckets];
+		static std::atomic<float> averageRoundTripTime = 0.0f;
+		static std::atomic<float> averagePacketLoss = 0.0f;
+		static std::atomic<uint32> totalReliableBytesInFlight = 0;
+		static std::atomic<uint32> numQueuedMessages = 0;
+		static std::chrono::steady_clock::time_point lastPeerSample;
+
+		// Internal functions
+		static void record(NetworkCounter& counter, size_t numBytes, uint32 numRecipients);
+		static int bucketFor(uint64 value, int numBuckets);
+		static void writeCounter(FILE* fp, NetworkDirection direction, const char* category, std::string_view type, const NetworkCounter& counter);
+
+		void recordPacket(NetworkDirection direction, const uint8* data, size_t dataSize, uint32 numRecipients)
+		{
+			if (dataSize < sizeof(NetworkEvent) || numRecipients == 0)
+			{
+				return;
+			}
+
+			const NetworkEvent* event = (const NetworkEvent*)data;
+			if ((size_t)event->type >= numEventTypes)
+			{
+				return;
+			}
+
+			int dir = (int)direction;
+			record(eventCounters[dir][(size_t)event->type], dataSize, numRecipients);
+
+			uint8* eventData = (uint8*)data + sizeof(NetworkEvent);
+			size_t eventDataSize = glm::min(event->dataSize, dataSize - sizeof(NetworkEvent));
+			switch (event->type)
+			{
+			case NetworkEventType::UserCommand:
+			{
+				const UserCommand* command = (const UserCommand*)eventData;
+				if (eventDataSize >= sizeof(UserCommand) && (size_t)command->type < numUserCommandTypes)
+				{
+					record(userCommandCounters[dir][(size_t)command->type], eventDataSize, numRecipients);
+				}
+			}
+			break;
+			case NetworkEventType::ClientCommand:
+			{
+				// Each command in the batch is charged for its header and padding too
+				size_t offset = 0;
+				size_t lastOffset = 0;
+				ClientCommand* command;
+				void* commandData;
+				while (Network::readClientCommand(eventData, eventDataSize, &offset, &command, &commandData))
+				{
+					if ((size_t)command->type < numClientCommandTypes)
+					{
+						record(clientCommandCounters[dir][(size_t)command->type], glm::min(offset, eventDataSize) - lastOffset, numRecipients);
+					}
+					lastOffset = glm::min(offset, eventDataSize);
+				}
+			}
+			break;
+			default:
+				break;
+			}
+		}
+
+		void samplePeers(ENetHost* host, uint32 queuedMessages)
+		{
+			std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+			if (now - lastPeerSample < peerSampleInterval)
+			{
+				return;
+			}
+			lastPeerSample = now;
+
+			uint32 numPeers = 0;
+			float roundTripSum = 0.0f;
+			float packetLossSum = 0.0f;
+			uint32 bytesInFlight = 0;
+			for (size_t i = 0; i < host->peerCount; i++)
+			{
+				const ENetPeer& peer = host->peers[i];
+				if (peer.state != ENET_PEER_STATE_CONNECTED)
+				{
+					continue;
+				}
+
+				numPeers++;
+				roundTripSum += (float)peer.roundTripTime;
+				packetLossSum += (float)peer.packetLoss / (float)ENET_PEER_PACKET_LOSS_SCALE;
+				bytesInFlight += peer.reliableDataInTransit;
+				roundTripHistogram[bucketFor(peer.roundTripTime, numRoundTripBuckets)]++;
+			}
+
+			averageRoundTripTime = numPeers > 0 ? roundTripSum / (float)numPeers : 0.0f;
+			averagePacketLoss = numPeers > 0 ? packetLossSum / (float)numPeers : 0.0f;
+			totalReliableBytesInFlight = bytesInFlight;
+			numQueuedMessages = queuedMessages;
+		}
+
+		const NetworkCounter& getEventCounter(NetworkDirection direction, NetworkEventType type)
+		{
+			return (size_t)type < numEventTypes ? eventCounters[(int)direction][(size_t)type] : emptyCounter;
+		}
+
+		const NetworkCounter& getUserCommandCounter(NetworkDirection direction, UserCommandType type)
+		{
+			return (size_t)type < numUserCommandTypes ? userCommandCounters[(int)direction][(size_t)type] : emptyCounter;
+		}
+
+		const NetworkCounter& getClientCommandCounter(NetworkDirection direction, ClientCommandType type)
+		{
+			return (size_t)type < numClientCommandTypes ? clientCommandCounters[(int)direction][(size_t)type] : emptyCounter;
+		}
+
+		uint64 totalBytes(NetworkDirection direction)
+		{
+			uint64 bytes = 0;
+			for (const NetworkCounter& counter : eventCounters[(int)direction])
+			{
+				bytes += counter.bytes;
+			}
+			return bytes;
+		}
+
+		uint64 totalPackets(NetworkDirection direction)
+		{
+			uint64 packets = 0;
+			for (const NetworkCounter& counter : eventCounters[(int)direction])
+			{
+				packets += counter.packets;
+			}
+			return packets;
+		}
+
+		float roundTripTime()
+		{
+			return averageRoundTripTime.load();
+		}
+
+		float packetLoss()
+		{
+			return averagePacketLoss.load();
+		}
+
+		uint32 reliableBytesInFlight()
+		{
+			return totalReliableBytesInFlight.load();
+		}
+
+		uint32 queuedMessages()
+		{
+			return numQueuedMessages.load();
+		}
+
+		bool dumpCsv(const char* filepath)
+		{
+			FILE* fp = std::fopen(filepath, "w");
+			if (!fp)
+			{
+				g_logger_error("Could not open '%s' to write the network stats to.", filepath);
+				return false;
+			}
+
+			std::fprintf(fp, "direction,category,type,packets,bytes,averageBytes");
+			for (int i = 0; i < numPacketSizeBuckets; i++)
+			{
+				if (i == numPacketSizeBuckets - 1)
+				{
+					std::fprintf(fp, ",bytes>=%llu", 1ull << i);
+				}
+				else
+				{
+					std::fprintf(fp, ",bytes<%llu", 1ull << (i + 1));
+				}
+			}
+			std::fprintf(fp, "\n");
+
+			for (int dir = 0; dir < 2; dir++)
+			{
+				NetworkDirection direction = (NetworkDirection)dir;
+				for (size_t i = 0; i < numEventTypes; i++)
+				{
+					writeCounter(fp, direction, "NetworkEvent", magic_enum::enum_name((NetworkEventType)i), eventCounters[dir][i]);
+				}
+				for (size_t i = 0; i < numUserCommandTypes; i++)
+				{
+					writeCounter(fp, direction, "UserCommand", magic_enum::enum_name((UserCommandType)i), userCommandCounters[dir][i]);
+				}
+				for (size_t i = 0; i < numClientCommandTypes; i++)
+				{
+					writeCounter(fp, direction, "ClientCommand", magic_enum::enum_name((ClientCommandType)i), clientCommandCounters[dir][i]);
+				}
+			}
+
+			// Round trips get their own table, one row per bucket of peer samples
+			std::fprintf(fp, "\nroundTripMs,peerSamples\n");
+			for (int i = 0; i < numRoundTripBuckets; i++)
+			{
+				if (i == numRoundTripBuckets - 1)
+				{
+					std::fprintf(fp, ">=%llu,%llu\n", 1ull << i, (unsigned long long)roundTripHistogram[i].load());
+				}
+				else
+				{
+					std::fprintf(fp, "%llu-%llu,%llu\n", 1ull << i, (1ull << (i + 1)) - 1, (unsigned long long)roundTripHistogram[i].load());
+				}
+			}
+
+			std::fprintf(fp, "\naverageRoundTripMs,packetLoss,reliableBytesInFlight,queuedMessages\n");
+			std::fprintf(fp, "%.2f,%.4f,%u,%u\n", roundTripTime(), packetLoss(), reliableBytesInFlight(), queuedMessages());
+			std::fclose(fp);
+
+			g_logger_info("Wrote network stats to '%s'.", filepath);
+			return true;
+		}
+
+		void reset()
+		{
+			g_memory_zeroMem(eventCounters, sizeof(eventCounters));
+			g_memory_zeroMem(userCommandCounters, sizeof(userCommandCounters));
+			g_memory_zeroMem(clientCommandCounters, sizeof(clientCommandCounters));
+			for (std::atomic<uint64>& bucket : roundTripHistogram)
+			{
+				bucket = 0;
+			}
+			averageRoundTripTime = 0.0f;
+			averagePacketLoss = 0.0f;
+			totalReliableBytesInFlight = 0;
+			numQueuedMessages = 0;
+		}
+
+		// =====================================================
+		// Internal functions
+		// =====================================================
+		static void record(NetworkCounter& counter, size_t numBytes, uint32 numRecipients)
+		{
+			counter.packets += numRecipients;
+			counter.bytes += numBytes * numRecipients;
+			counter.sizeHistogram[bucketFor(numBytes, numPacketSizeBuckets)] += numRecipients;
+		}
+
+		static int bucketFor(uint64 value, int numBuckets)
+		{
+			// Bucket i holds [2^i, 2^(i + 1)), zero goes in with the ones
+			int bucket = 0;
+			while (value > 1 && bucket < numBuckets - 1)
+			{
+				value >>= 1;
+				bucket++;
+			}
+			return bucket;
+		}
+
+		static void writeCounter(FILE* fp, NetworkDirection direction, const char* category, std::string_view type, const NetworkCounter& counter)
+		{
+			std::fprintf(fp, "%s,%s,%.*s,%llu,%llu,%.1f",
+				magic_enum::enum_name(direction).data(),
+				category,
+				(int)type.length(), type.data(),
+				(unsigned long long)counter.packets,
+				(unsigned long long)counter.bytes,
+				counter.packets > 0 ? (double)counter.bytes / (double)counter.packets : 0.0);
+			for (int i = 0; i < numPacketSizeBuckets; i++)
+			{
+				std::fprintf(fp, ",%llu", (unsigned long long)counter.sizeHistogram[i]);
+			}
+			std::fprintf(fp, "\n");
+		}
+	}
+}
@@ -0,0 +1,134 @@
+#include "network/NetworkThread.h"
+#include "network/NetworkStats.h"
+#include "utils/Settings.h"
+
+#include <enet/enet.h>
+
+namespace Minecraft
+{
+	static const uint32 queueCapacity = 4096;
+
+	void NetworkThread::start(ENetHost* inHost)
+	{
+		host = inHost;
+		incoming.init(queueCapacity);
+		outgoing.init(queueCapacity);
+		isRunning = true;
+		thread = std::thread(&NetworkThread::run, this);
+	}
+
+	void NetworkThread::stop()
+	{
+		isRunning = false;
+		if (thread.joinable())
+		{
+			thread.join();
+		}
+
+		// Nobody is going to read these anymore
+		NetworkMessage message;
+		while (incoming.pop(&message))
+		{
+			if (message.packet)
+			{
+				enet_packet_destroy(message.packet);
+			}
+		}
+
+		OutgoingPacket outgoingPacket;
+		while (outgoing.pop(&outgoingPacket))
+		{
+			enet_packet_destroy(outgoingPacket.packet);
+		}
+
+		incoming.free();
+		outgoing.free();
+		host = nullptr;
+	}
+
+	void NetworkThread::send(ENetPeer* peer, ENetPacket* packet, NetworkChannel channel)
+	{
+		while (!outgoing.push({ peer, packet, channel }))
+		{
+			// Only happens if the network thread has fallen way behind
+			std::this_thread::yield();
+		}
+	}
+
+	bool NetworkThread::poll(NetworkMessage* message)
+	{
+		return incoming.pop(message);
+	}
+
+	void NetworkThread::run()
+	{
+		while (isRunning)
+		{
+			OutgoingPacket outgoingPacket;
+			while (outgoing.pop(&outgoingPacket))
+			{
+				if (outgoingPacket.peer)
+				{
+					if (enet_peer_send(outgoingPacket.peer, (uint8)outgoingPacket.channel, outgoingPacket.packet) != 0)
+					{
+						g_logger_error("Failed to send packet.");
+						enet_packet_destroy(outgoingPacket.packet);
+					}
+				}
+				else
+				{
+					enet_host_broadcast(host, (uint8)outgoingPacket.channel, outgoingPacket.packet);
+				}
+			}
+
+			// Sleeps on the socket until something comes in or the timeout runs out, anything
+			// queued to send in the meantime goes out on the next pass
+			ENetEvent event;
+			int result = enet_host_service(host, &event, Settings::Network::serviceTimeoutMs);
+			while (result > 0)
+			{
+				switch (event.type)
+				{
+				case ENET_EVENT_TYPE_CONNECT:
+					pushIncoming({ NetworkMessageType::Connect, event.peer, nullptr });
+					break;
+				case ENET_EVENT_TYPE_RECEIVE:
+					pushIncoming({ NetworkMessageType::Receive, event.peer, event.packet });
+					break;
+				case ENET_EVENT_TYPE_DISCONNECT:
+					pushIncoming({ NetworkMessageType::Disconnect, event.peer, nullptr });
+					break;
+				default:
+					break;
+				}
+
+				result = enet_host_service(host, &event, 0);
+			}
+
+			if (result < 0)
+			{
+				g_logger_error("Failed to service the ENet host.");
+			}
+
+			NetworkStats::samplePeers(host, incoming.size() + outgoing.size());
+		}
+	}
+
+	void NetworkThread::pushIncoming(const NetworkMessage& message)
+	{
+		while (!incoming.push(message))
+		{
+			if (!isRunning)
+			{
+				if (message.packet)
+				{
+					enet_packet_destroy(message.packet);
+				}
+				return;
+			}
+
+			// The game thread is behind, ENet keeps buffering on its end until we catch up
+			std::this_thread::yield();
+		}
+	}
+}
@@ -1,15 +1,22 @@
 #include "network/Server.h"
+#include "network/ClientChunkCache.h"
 #include "network/TransformCommandBuffer.h"
+#include "network/TransformStream.h"
 #include "core.h"
 #include "core/Scene.h"
 #include "core/Components.h"
 #include "network/Network.h"
+#include "network/NetworkThread.h"
+#include "network/NetworkStats.h"
 #include "world/ChunkManager.h"
 #include "world/Chunk.hpp"
 #include "world/BlockMap.h"
+#include "world/ChunkCodec.h"
 #include "gameplay/CharacterController.h"
 #include "gameplay/PlayerController.h"
 #include "gui/MainHud.h"
+#include "utils/DebugStats.h"
+#include "utils/Settings.h"
 
 #include <enet/enet.h>
 
@@ -27,13 +34,43 @@ namespace Minecraft
 		// Internal variables
 		static ENetAddress address;
 		static ENetHost* server;
-		static const int maxClients = 32;
+		static NetworkThread networkThread;
 		static std::array<ENetPeer*, maxClients> clients;
 		static int numConnectedClients;
 
 		static ENetSocket listenSocket;
 		static ENetAddress listenAddress;
 
+		// What each client can see. Chunks get streamed to it nearest first, a few packets at a time,
+		// and it only hears about the entities near its player.
+		struct ClientView
+		{
+			ENetPeer* peer;
+			Ecs::EntityId player;
+			robin_hood::unordered_flat_set<glm::ivec2> sentChunks;
+			// Chunks in range of the player that haven't been sent yet. Only rebuilt when the player
+			// moves to another chunk, so once it's empty there's nothing to look at until they do.
+			robin_hood::unordered_flat_set<glm::ivec2> unsentChunks;
+			glm::ivec2 streamCenter;
+			bool hasStreamCenter;
+			// Versions of the chunks the client still had when it joined, these only get sent again if they changed
+			robin_hood::unordered_flat_map<glm::ivec2, uint64> cachedChunks;
+			// Bytes the client hasn't acknowledged yet
+			uint32 bytesInFlight;
+			// Server game time the client asked to join at
+			uint64 joinTime;
+			bool hasSpawned;
+			robin_hood::unordered_flat_set<Ecs::EntityId> relevantEntities;
+			TransformEncoder transformEncoder;
+		};
+		static robin_hood::unordered_node_map<ENetPeer*, ClientView> clientViews;
+		static constexpr size_t maxChunkPacketSize = 64 * 1024;
+		static constexpr uint32 maxChunkBytesInFlight = 512 * 1024;
+		// The player gets sent in once the chunks this close to them have been sent
+		static constexpr int spawnRadius = 2;
+		// Or after this long, standing in a hole beats never getting past the connecting screen
+		static constexpr uint64 maxSpawnWaitInMs = 30'000;
+
 		// Time since server started in milliseconds
 		uint64 serverGameTime;
 
@@ -45,11 +82,25 @@ namespace Minecraft
 		// TODO: Should there be server commands? If so, what's the difference from a ClientCommand?
 		// static void processServerCommand(UserCommand* command, void* userCommandData, ENetPeer* peer);
 		static void sendToEveryoneExcept(const ClientCommand* command, const SizedMemory& sizedData, const ENetPeer* peer);
+		static void sendToChunkHoldersExcept(const ClientCommand* command, const SizedMemory& sizedData, const glm::vec3& worldPosition, const ENetPeer* peer);
+		static void streamChunks(ClientView& view);
+		static void finishJoin(ClientView& view);
+		static bool isReadyToStream(const Chunk& chunk);
+		static void sendTransforms();
+		static void updateClientTransforms();
+		static void updateEntityGrid();
+		static void findRelevantEntities(ClientView& view, std::vector<EntityTransform>& transforms, std::vector<Ecs::EntityId>& leftEntities);
 
 		// Internal buffers
 		static TransformCommandBuffer transformCommandBuffer;
 		static constexpr uint64 lagInMs = 300;
-		static constexpr int maxNumTransformCommands = 3000;
+		static constexpr int maxNumTrackedEntities = 256;
+		// The last transform we heard for every entity, each client gets the ones near them once per update
+		static robin_hood::unordered_flat_map<Ecs::EntityId, EntityTransform> latestTransforms;
+		// Every entity with a transform bucketed by the chunk it's standing in
+		static robin_hood::unordered_flat_map<glm::ivec2, std::vector<Ecs::EntityId>> entityGrid;
+		static TransformDecoder transformDecoder;
+		static std::vector<EntityTransform> decodedTransforms;
 
 		void init()
 		{
@@ -71,9 +122,15 @@ namespace Minecraft
 			g_memory_zeroMem(clients.data(), sizeof(ENetPeer*) * maxClients);
 			numConnectedClients = 0;
 
+#ifdef _HEADLESS
+			// The chunk pool only has room for this many players, ENet turns away anyone past it
+			const size_t peerCount = glm::min((size_t)Settings::Server::maxPlayers, (size_t)maxClients);
+#else
+			const size_t peerCount = maxClients;
+#endif
 			server = enet_host_create(
 				&address, // the address to bind the server host to
-				32, // allow up to 32 clients and/or outgoing connections
+				peerCount, // how many clients and/or outgoing connections are allowed
 				2, // allow up to 2 channels to be used, 0 and 1
 				0, // assume any amount of incoming bandwidth
 				0); // assume any amount of outgoing bandwidth
@@ -84,22 +141,24 @@ namespace Minecraft
 				return;
 			}
 
-			transformCommandBuffer.init(maxNumTransformCommands);
+			transformCommandBuffer.init(maxNumTrackedEntities);
+			networkThread.start(server);
 		}
 
 		void update()
 		{
 			serverGameTime += (uint64)(World::deltaTime * 1000.0f);
 			checkForClientBroadcasts();
+			sendTransforms();
 
-			ENetEvent event;
+			NetworkMessage event;
 
 			// Process all events
-			while (enet_host_service(server, &event, 0) > 0)
+			while (networkThread.poll(&event))
 			{
 				switch (event.type)
 				{
-				case ENET_EVENT_TYPE_CONNECT:
+				case NetworkMessageType::Connect:
 				{
 					g_logger_info("A new client connected from %x:%u.", event.peer->address.host, event.peer->address.port);
 					clients[numConnectedClients] = event.peer;
@@ -113,13 +172,14 @@ namespace Minecraft
 					Network::sendClientCommand(ClientCommandType::Handshake, empty, event.peer);
 				}
 				break;
-				case ENET_EVENT_TYPE_RECEIVE:
+				case NetworkMessageType::Receive:
 				{
 					//g_logger_info("A packet of length %u containing %s was received from %s on channel %u.",
 					//	event.packet->dataLength,
 					//	event.packet->data,
 					//	event.peer->data,
 					//	event.channelID);
+					NetworkStats::recordPacket(NetworkDirection::Received, event.packet->data, event.packet->dataLength);
 					NetworkEventData networkEventData = Network::deserializeNetworkEvent(event.packet->data, event.packet->dataLength);
 					processEvent(networkEventData.event, networkEventData.data, event.peer);
 
@@ -127,7 +187,7 @@ namespace Minecraft
 					enet_packet_destroy(event.packet);
 				}
 				break;
-				case ENET_EVENT_TYPE_DISCONNECT:
+				case NetworkMessageType::Disconnect:
 				{
 					g_logger_info("%s disconnected.", event.peer->data);
 
@@ -144,37 +204,70 @@ namespace Minecraft
 						}
 					}
 
-					// Reset the peer's client information
+					// Reset the peer's client information, everyone that could see their player gets told it left
 					event.peer->data = NULL;
+					Network::dropPendingCommands(event.peer);
+					auto viewIter = clientViews.find(event.peer);
+					if (viewIter != clientViews.end())
+					{
+						// Their chunks stop being kept loaded once they're offline
+						Ecs::Registry* registry = Scene::getRegistry();
+						if (registry->hasComponent<PlayerComponent>(viewIter->second.player))
+						{
+							registry->getComponent<PlayerComponent>(viewIter->second.player).isOnline = false;
+						}
+						latestTransforms.erase(viewIter->second.player);
+						transformCommandBuffer.remove(viewIter->second.player);
+						clientViews.erase(viewIter);
+					}
 				}
 				break;
 				}
 			}
-		}
 
-		void broadcast(ENetPacket* packet)
-		{
-			//enet_host_broadcast(server, 0, packet);
-			for (int i = 0; i < numConnectedClients; i++)
+			updateClientTransforms();
+			for (auto& [peer, view] : clientViews)
 			{
-				sendClient(clients[i], packet);
+				streamChunks(view);
 			}
 		}
 
-		void sendClient(ENetPeer* peer, ENetPacket* packet)
+		void broadcast(ENetPacket* packet, NetworkChannel channel)
 		{
-			if (enet_peer_send(peer, 0, packet) != 0)
-			{
-				g_logger_error("Failed to send packet from server.");
-			}
+			networkThread.send(nullptr, packet, channel);
+		}
+
+		void sendClient(ENetPeer* peer, ENetPacket* packet, NetworkChannel channel)
+		{
+			networkThread.send(peer, packet, channel);
+		}
+
+		void queueTransform(Ecs::EntityId entity, const glm::vec3& position, const glm::vec3& orientation)
+		{
+			latestTransforms[entity] = { entity, position, orientation };
+		}
+
+		uint16 getPort()
+		{
+			return server ? server->address.port : 0;
+		}
+
+		uint32 getNumConnectedClients()
+		{
+			return (uint32)numConnectedClients;
 		}
 
 		void free()
 		{
+			networkThread.stop();
 			enet_socket_shutdown(listenSocket, ENET_SOCKET_SHUTDOWN_READ_WRITE);
 			enet_socket_destroy(listenSocket);
 			enet_host_destroy(server);
 			transformCommandBuffer.free();
+			clientViews.clear();
+			latestTransforms.clear();
+			entityGrid.clear();
+			transformDecoder.entities.clear();
 		}
 
 		static void checkForClientBroadcasts()
@@ -284,18 +377,24 @@ namespace Minecraft
 			{
 			case NetworkEventType::UserCommand:
 			{
-				UserCommand* command = (UserCommand*)data;
-				size_t sizeOfCommand = sizeof(UserCommand) + command->sizeOfData;
-				void* userCommandData = (void*)((UserCommand*)data + 1);
-				processUserCommand(command, userCommandData, peer);
+				UserCommand* command;
+				void* userCommandData;
+				if (Network::readUserCommand(data, event->dataSize, &command, &userCommandData))
+				{
+					processUserCommand(command, userCommandData, peer);
+				}
 			}
 			break;
 			case NetworkEventType::ClientCommand:
 			{
-				ClientCommand* command = (ClientCommand*)data;
-				size_t sizeOfCommand = sizeof(ClientCommand) + command->sizeOfData;
-				void* userCommandData = (void*)((ClientCommand*)data + 1);
-				processClientCommand(command, userCommandData, peer);
+				// Everything the client sent during one update comes in the same event
+				size_t offset = 0;
+				ClientCommand* command;
+				void* clientCommandData;
+				while (Network::readClientCommand(data, event->dataSize, &offset, &command, &clientCommandData))
+				{
+					processClientCommand(command, clientCommandData, peer);
+				}
 			}
 			break;
 			default:
@@ -312,42 +411,24 @@ namespace Minecraft
 			{
 			case UserCommandType::UpdateTransform:
 			{
-				UpdateTransformCommand bufferCommand;
-				SizedMemory sizedData = SizedMemory{ (uint8*)userCommandData, command->sizeOfData };
-				unpack<glm::vec3, glm::vec3, Ecs::EntityId>(
-					sizedData,
-					&bufferCommand.position,
-					&bufferCommand.orientation,
-					&bufferCommand.entity
-					);
-				bufferCommand.timestamp = command->timestamp;
-
-				// TODO: Don't broadcast these back to all the clients every update, it's stupid
-				// instead, buffer the data and send bulk updates and perform interpolation
-				for (int i = 0; i < numConnectedClients; i++)
+				decodedTransforms.clear();
+				if (!transformDecoder.decode((uint8*)userCommandData, command->sizeOfData, decodedTransforms))
 				{
-					ENetPeer* peerToSendTo = clients[i];
-					if (peerToSendTo != peer)
-					{
-						Network::sendUserCommand(command->type, sizedData, peerToSendTo);
-					}
+					g_logger_error("<Server> Recieved a malformed transform update.");
 				}
 
-				transformCommandBuffer.insert(bufferCommand);
-
-				// TODO: Do cheat checking, make sure the entity hasn't moved farther than it should in one update
-				// Use a command from at least 100ms ago
-				bool foundPosition;
-				glm::vec3 position, orientation;
-				if (transformCommandBuffer.predict(lagInMs, bufferCommand.entity, &position, &orientation))
+				for (const EntityTransform& entityTransform : decodedTransforms)
 				{
-					Ecs::Registry* registry = Scene::getRegistry();
-					if (registry->hasComponent<Transform>(bufferCommand.entity))
-					{
-						Transform& transform = registry->getComponent<Transform>(bufferCommand.entity);
-						transform.position = position;
-						transform.orientation = orientation;
-					}
+					// Everyone else gets this in the next batch of transforms
+					latestTransforms[entityTransform.entity] = entityTransform;
+
+					UpdateTransformCommand bufferCommand;
+					bufferCommand.entity = entityTransform.entity;
+					bufferCommand.position = entityTransform.position;
+					bufferCommand.orientation = entityTransform.orientation;
+					bufferCommand.timestamp = command->timestamp;
+					// TODO: Do cheat checking, make sure the entity hasn't moved farther than it should in one update
+					transformCommandBuffer.insert(bufferCommand);
 				}
 			}
 			break;
@@ -404,7 +485,7 @@ namespace Minecraft
 				// TODO: Do cheat checking, make sure the entity hasn't moved farther than it should in one update
 				// TODO: Add buffering here. Buffer the commands so you can perform interpolation of updates client side
 				ChunkManager::setBlock(worldPosition, block);
-				sendToEveryoneExcept(command, sizedData, peer);
+				sendToChunkHoldersExcept(command, sizedData, worldPosition, peer);
 			}
 			break;
 			case ClientCommandType::RemoveBlock:
@@ -419,7 +500,7 @@ namespace Minecraft
 				// TODO: Do cheat checking, make sure the entity hasn't moved farther than it should in one update
 				// TODO: Add buffering here. Buffer the commands so you can perform interpolation of updates client side
 				ChunkManager::removeBlock(worldPosition);
-				sendToEveryoneExcept(command, sizedData, peer);
+				sendToChunkHoldersExcept(command, sizedData, worldPosition, peer);
 			}
 			break;
 			case ClientCommandType::Chat:
@@ -435,7 +516,11 @@ namespace Minecraft
 				if (player != Ecs::nullEntity && registry->hasComponent<PlayerComponent>(player))
 				{
 					const PlayerComponent& playerComponent = registry->getComponent<PlayerComponent>(player);
+#ifdef _HEADLESS
+					g_logger_info("<%s>: %s", playerComponent.name, message);
+#else
 					MainHud::generalMessage(player, message);
+#endif
 					sendToEveryoneExcept(command, sizedData, peer);
 				}
 			}
@@ -466,79 +551,18 @@ namespace Minecraft
 			break;
 			case ClientCommandType::ClientLoadInfo:
 			{
-				SizedMemory sizedData = SizedMemory{ (uint8*)clientCommandData, command->sizeOfData };
+				// Name (null terminated) -> NumCachedChunks (uint32) -> CachedChunkVersion * NumCachedChunks
 				char* playerName = (char*)clientCommandData;
+				size_t nameSize = strnlen(playerName, command->sizeOfData);
+				if (nameSize == command->sizeOfData)
+				{
+					g_logger_error("Recieved client load info without a player name.");
+					break;
+				}
 
-				g_logger_info("Sending client chunk data to player '%s'.", playerName);
-				robin_hood::unordered_node_map<glm::ivec2, Chunk>& chunks = ChunkManager::getAllChunks();
 				Network::sendClient(peer, NetworkEventType::WorldSeed, &World::seed, sizeof(uint32));
-				uint16 numChunks = (uint16)chunks.size();
-				size_t chunkDataSize = sizeof(Block) * World::ChunkHeight * World::ChunkWidth * World::ChunkDepth;
-				size_t chunkCoordsSize = sizeof(int32) * 2;
-				size_t chunkStateSize = sizeof(ChunkState);
-				size_t chunkCompressedSizeSize = sizeof(uint32);
-				uint8* chunkDataEvent = (uint8*)g_memory_allocate(sizeof(uint16) + (chunkDataSize * numChunks) + (chunkCoordsSize * numChunks) + (chunkStateSize * numChunks));
-				g_logger_info("Num chunks: %u", numChunks);
-				g_memory_copyMem(chunkDataEvent, &numChunks, sizeof(uint16));
-				uint8* chunkDataPtr = chunkDataEvent + sizeof(uint16);
-				bool first = true;
-				for (auto& pair : chunks)
-				{
-					uint32 compressedChunkSize = 0;
-					Chunk& chunk = pair.second;
-					if (chunk.state == ChunkState::Loaded)
-					{
-						// Compressed chunk looks like this
-						// NumChunks -> ChunkSize (uint16) -> blockId (uint16) -> blockCount(uint16) -> ... ...
-						//		   -> blockId(uint16) -> blockCount(uint16)
-						//         -> chunkCoords (int32) * 2 -> chunkState (uint8)
-						uint8* chunkDataCurrentPtr = chunkDataPtr + chunkCompressedSizeSize;
-						uint16 lastBlockId = chunk.data[0].id;
-						uint16 lastBlockCount = 1;
-						for (uint32 i = 1; i < World::ChunkHeight * World::ChunkWidth * World::ChunkDepth; i++)
-						{
-							if (chunk.data[i].id != lastBlockId)
-							{
-								// Write to our memory
-								g_memory_copyMem(chunkDataCurrentPtr, &lastBlockId, sizeof(uint16));
-								chunkDataCurrentPtr += sizeof(uint16);
-								g_memory_copyMem(chunkDataCurrentPtr, &lastBlockCount, sizeof(uint16));
-								chunkDataCurrentPtr += sizeof(uint16);
-								compressedChunkSize += (sizeof(uint16) * 2);
-
-								// Set the next id
-								lastBlockId = chunk.data[i].id;
-								lastBlockCount = 0;
-							}
-							lastBlockCount++;
-						}
-						if (lastBlockCount > 0)
-						{
-							g_memory_copyMem(chunkDataCurrentPtr, &lastBlockId, sizeof(uint16));
-							chunkDataCurrentPtr += sizeof(uint16);
-							g_memory_copyMem(chunkDataCurrentPtr, &lastBlockCount, sizeof(uint16));
-							chunkDataCurrentPtr += sizeof(uint16);
-							compressedChunkSize += (sizeof(uint16) * 2);
-						}
-						g_memory_copyMem(chunkDataPtr, &compressedChunkSize, sizeof(uint32));
-						chunkDataPtr += chunkCompressedSizeSize + compressedChunkSize;
-
-						g_memory_copyMem(chunkDataPtr, &chunk.chunkCoords.x, sizeof(int32));
-						chunkDataPtr += sizeof(int32);
-						g_memory_copyMem(chunkDataPtr, &chunk.chunkCoords.y, sizeof(int32));
-						chunkDataPtr += sizeof(int32);
-						g_memory_copyMem(chunkDataPtr, &chunk.state, sizeof(ChunkState));
-						chunkDataPtr += sizeof(ChunkState);
-					}
-				}
-				size_t totalCompressedSize = chunkDataPtr - chunkDataEvent;
-				g_logger_info("Total compressed chunk data size: %u bytes", totalCompressedSize);
-				Network::sendClient(peer, NetworkEventType::ChunkData, chunkDataEvent, totalCompressedSize);
-				g_memory_free(chunkDataEvent);
 
 				Ecs::Registry* registry = Scene::getRegistry();
-				Ecs::EntityId currentPlayer = World::getLocalPlayer();
-				Transform& currentPlayerTransform = registry->getComponent<Transform>(currentPlayer);
 				// Check if we need a new player or if the player has joined before
 				Ecs::EntityId newPlayer = Ecs::nullEntity;
 				for (auto entity : registry->view<PlayerComponent>())
@@ -553,29 +577,87 @@ namespace Minecraft
 				}
 				if (newPlayer == Ecs::nullEntity)
 				{
-					newPlayer = World::createPlayer(playerName, currentPlayerTransform.position);
+					newPlayer = World::createPlayer(playerName, World::getSpawnPosition());
 					g_logger_info("Welcome '%s'. First time joining this world.", playerName);
 				}
 				registry->getComponent<CharacterController>(newPlayer).lockedToCamera = false;
 				registry->getComponent<PlayerComponent>(newPlayer).isOnline = true;
-				// Synchronize the ECS
-				RawMemory entityMemory = registry->serialize();
-				Network::broadcast(NetworkEventType::EntityData, entityMemory.data, entityMemory.size);
-				// Then set the new local player
-				Network::sendClient(peer, NetworkEventType::LocalPlayer, &newPlayer, sizeof(Ecs::EntityId));
-				g_memory_free(entityMemory.data);
-
-				SizedMemory timeData = pack<int>(World::worldTime);
-				Network::sendClientCommand(ClientCommandType::SetTime, timeData, peer);
-				g_memory_free(timeData.memory);
-
-				g_logger_info("Telling client to patch their dang chunk neighbors and to calculate their lighting.");
-				SizedMemory playerLoadPos = pack<glm::vec3>(currentPlayerTransform.position);
-				Network::sendClientCommand(ClientCommandType::CalculateLighting, playerLoadPos, peer);
-				g_memory_free(playerLoadPos.memory);
-				Network::sendClient(peer, NetworkEventType::PatchChunkNeighbors, nullptr, 0);
-				Network::sendClient(peer, NetworkEventType::NotifyChunkWorker, nullptr, 0);
-				enet_host_flush(server);
+
+				// The chunks get streamed over the next few updates, the player is sent once
+				// the chunks around them have been sent
+				g_logger_info("Streaming chunk data to player '%s'.", playerName);
+				ClientView& view = clientViews[peer];
+				view.peer = peer;
+				view.player = newPlayer;
+				view.sentChunks.clear();
+				view.unsentChunks.clear();
+				view.hasStreamCenter = false;
+				view.cachedChunks.clear();
+				view.bytesInFlight = 0;
+				view.joinTime = serverGameTime;
+				view.hasSpawned = false;
+				view.relevantEntities.clear();
+				view.transformEncoder.entities.clear();
+
+				// Older clients only send their name
+				uint8* cachedChunkData = (uint8*)clientCommandData + nameSize + 1;
+				size_t cachedChunkDataSize = command->sizeOfData - nameSize - 1;
+				uint32 numCachedChunks = 0;
+				if (cachedChunkDataSize >= sizeof(uint32))
+				{
+					g_memory_copyMem(&numCachedChunks, cachedChunkData, sizeof(uint32));
+					numCachedChunks = glm::min(numCachedChunks, ClientChunkCache::maxAdvertisedChunks);
+					numCachedChunks = glm::min(numCachedChunks, (uint32)((cachedChunkDataSize - sizeof(uint32)) / sizeof(CachedChunkVersion)));
+				}
+				for (uint32 i = 0; i < numCachedChunks; i++)
+				{
+					CachedChunkVersion cachedVersion;
+					g_memory_copyMem(&cachedVersion, cachedChunkData + sizeof(uint32) + i * sizeof(CachedChunkVersion), sizeof(CachedChunkVersion));
+					view.cachedChunks[cachedVersion.chunkCoords] = cachedVersion.version;
+				}
+				g_logger_info("Player '%s' still has %u chunks cached.", playerName, numCachedChunks);
+			}
+			break;
+			case ClientCommandType::ChunkCacheMiss:
+			{
+				glm::ivec2 chunkCoords;
+				SizedMemory sizedData = SizedMemory{ (uint8*)clientCommandData, command->sizeOfData };
+				unpack<glm::ivec2>(
+					sizedData,
+					&chunkCoords
+				);
+
+				// The client lost its copy before we told it to use it, or couldn't load the chunk yet, so it gets streamed again
+				auto iter = clientViews.find(peer);
+				if (iter != clientViews.end())
+				{
+					ClientView& view = iter->second;
+					view.sentChunks.erase(chunkCoords);
+					view.cachedChunks.erase(chunkCoords);
+					glm::ivec2 localChunkPos = chunkCoords - view.streamCenter;
+					if (view.hasStreamCenter &&
+						(localChunkPos.x * localChunkPos.x) + (localChunkPos.y * localChunkPos.y) <= World::ChunkRadius * World::ChunkRadius)
+					{
+						view.unsentChunks.insert(chunkCoords);
+					}
+				}
+			}
+			break;
+			case ClientCommandType::ChunkAck:
+			{
+				uint32 numBytesReceived;
+				SizedMemory sizedData = SizedMemory{ (uint8*)clientCommandData, command->sizeOfData };
+				unpack<uint32>(
+					sizedData,
+					&numBytesReceived
+				);
+
+				auto iter = clientViews.find(peer);
+				if (iter != clientViews.end())
+				{
+					ClientView& view = iter->second;
+					view.bytesInFlight -= glm::min(numBytesReceived, view.bytesInFlight);
+				}
 			}
 			break;
 			case ClientCommandType::SetTime:
@@ -611,5 +693,401 @@ namespace Minecraft
 				}
 			}
 		}
+
+		static void sendToChunkHoldersExcept(const ClientCommand* command, const SizedMemory& sizedData, const glm::vec3& worldPosition, const ENetPeer* peer)
+		{
+			// Only clients still holding the chunk need the edit. They let go of chunks past the stream
+			// margin, and anyone that hasn't been sent the chunk yet gets the edit along with it.
+			glm::ivec2 chunkCoords = World::toChunkCoords(worldPosition);
+			const int holdRadius = World::ChunkRadius + World::StreamUnloadMargin;
+			for (const auto& [viewPeer, view] : clientViews)
+			{
+				if (viewPeer == peer || !view.hasStreamCenter)
+				{
+					continue;
+				}
+
+				glm::ivec2 localChunkPos = chunkCoords - view.streamCenter;
+				bool isInViewRange = (localChunkPos.x * localChunkPos.x) + (localChunkPos.y * localChunkPos.y) <= holdRadius * holdRadius;
+				if (isInViewRange && view.sentChunks.find(chunkCoords) != view.sentChunks.end())
+				{
+					Network::sendClientCommand(command->type, sizedData, viewPeer);
+				}
+			}
+		}
+
+		static void streamChunks(ClientView& view)
+		{
+			if (view.bytesInFlight >= maxChunkBytesInFlight)
+			{
+				return;
+			}
+
+			Ecs::Registry* registry = Scene::getRegistry();
+			if (!registry->hasComponent<Transform>(view.player))
+			{
+				return;
+			}
+
+			glm::ivec2 playerChunkCoords = World::toChunkCoords(registry->getComponent<Transform>(view.player).position);
+			if (!view.hasStreamCenter || view.streamCenter != playerChunkCoords)
+			{
+				view.streamCenter = playerChunkCoords;
+				view.hasStreamCenter = true;
+				view.unsentChunks.clear();
+
+				// The client has let go of these by now, they get streamed again if the player comes back
+				const int forgetRadius = World::ChunkRadius + World::StreamUnloadMargin + 1;
+				for (auto iter = view.sentChunks.begin(); iter != view.sentChunks.end();)
+				{
+					glm::ivec2 localChunkPos = *iter - playerChunkCoords;
+					if ((localChunkPos.x * localChunkPos.x) + (localChunkPos.y * localChunkPos.y) > forgetRadius * forgetRadius)
+					{
+						iter = view.sentChunks.erase(iter);
+					}
+					else
+					{
+						iter++;
+					}
+				}
+				for (int z = -World::ChunkRadius; z <= World::ChunkRadius; z++)
+				{
+					for (int x = -World::ChunkRadius; x <= World::ChunkRadius; x++)
+					{
+						glm::ivec2 chunkCoords = playerChunkCoords + glm::ivec2(x, z);
+						if ((x * x) + (z * z) <= World::ChunkRadius * World::ChunkRadius &&
+							view.sentChunks.find(chunkCoords) == view.sentChunks.end())
+						{
+							view.unsentChunks.insert(chunkCoords);
+						}
+					}
+				}
+			}
+
+			if (view.unsentChunks.empty() && view.hasSpawned)
+			{
+				// Caught up, the client already has everything around the player
+				return;
+			}
+
+			// Only main thread code streams chunks, so the list gets reused between clients and updates
+			static std::vector<const Chunk*> chunksToSend;
+			chunksToSend.clear();
+			int numSpawnChunksLoading = 0;
+			for (const glm::ivec2& chunkCoords : view.unsentChunks)
+			{
+				glm::ivec2 localChunkPos = chunkCoords - playerChunkCoords;
+				int distanceSquared = (localChunkPos.x * localChunkPos.x) + (localChunkPos.y * localChunkPos.y);
+				const Chunk* chunk = ChunkManager::getChunk(chunkCoords);
+				if (chunk && isReadyToStream(*chunk))
+				{
+					chunksToSend.push_back(chunk);
+				}
+				else if (distanceSquared <= spawnRadius * spawnRadius)
+				{
+					numSpawnChunksLoading++;
+				}
+			}
+
+			// Nearest chunks first so the client can start meshing around the player right away
+			std::sort(chunksToSend.begin(), chunksToSend.end(), [playerChunkCoords](const Chunk* a, const Chunk* b)
+			{
+				glm::ivec2 aLocalPos = a->chunkCoords - playerChunkCoords;
+				glm::ivec2 bLocalPos = b->chunkCoords - playerChunkCoords;
+				return (aLocalPos.x * aLocalPos.x) + (aLocalPos.y * aLocalPos.y) <
+					(bLocalPos.x * bLocalPos.x) + (bLocalPos.y * bLocalPos.y);
+			});
+
+			// Each packet looks like this
+			// NumChunks (uint16) -> NumChunksRemaining (uint32) -> (CompressedSize (uint32) -> ChunkCodec data) * NumChunks
+			// A chunk the client already has an up to date copy of is sent as a CompressedSize of 0 followed by its coords (glm::ivec2)
+			size_t headerSize = sizeof(uint16) + sizeof(uint32);
+			size_t maxPacketDataSize = maxChunkPacketSize + sizeof(uint32) + ChunkCodec::maxEncodedSize;
+			size_t chunkIndex = 0;
+			while (chunkIndex < chunksToSend.size() && view.bytesInFlight < maxChunkBytesInFlight)
+			{
+				// The chunks get encoded straight into the packet, it gets trimmed down to size when it's sent
+				EventPacket eventPacket = Network::beginEvent(NetworkEventType::ChunkData, maxPacketDataSize);
+				uint8* packetData = eventPacket.data;
+				uint8* chunkPacketEnd = packetData + maxPacketDataSize;
+				uint8* chunkDataPtr = packetData + headerSize;
+				uint16 numChunks = 0;
+				// There's always room for one more chunk while we're under the packet size
+				while (chunkIndex < chunksToSend.size() && (size_t)(chunkDataPtr - packetData) < maxChunkPacketSize)
+				{
+					const Chunk* chunk = chunksToSend[chunkIndex];
+					chunkIndex++;
+
+					uint8* encodedPtr = chunkDataPtr + sizeof(uint32);
+					uint32 compressedChunkSize = (uint32)ChunkCodec::encode(chunk->data, chunk->chunkCoords, encodedPtr, chunkPacketEnd - encodedPtr);
+					if (compressedChunkSize == 0)
+					{
+						g_logger_error("Failed to encode chunk <%d, %d> for streaming.", chunk->chunkCoords.x, chunk->chunkCoords.y);
+						continue;
+					}
+
+					// Chunks the client has cached still get encoded, the version is a hash of the encoded data
+					auto cachedIter = view.cachedChunks.find(chunk->chunkCoords);
+					if (cachedIter != view.cachedChunks.end())
+					{
+						uint64 cachedVersion = cachedIter->second;
+						view.cachedChunks.erase(cachedIter);
+						if (cachedVersion == ChunkCodec::contentVersion(encodedPtr, compressedChunkSize))
+						{
+							compressedChunkSize = 0;
+							g_memory_copyMem(encodedPtr, &chunk->chunkCoords, sizeof(glm::ivec2));
+							g_memory_copyMem(chunkDataPtr, &compressedChunkSize, sizeof(uint32));
+							chunkDataPtr += sizeof(uint32) + sizeof(glm::ivec2);
+							view.sentChunks.insert(chunk->chunkCoords);
+							view.unsentChunks.erase(chunk->chunkCoords);
+							numChunks++;
+							continue;
+						}
+					}
+
+					g_memory_copyMem(chunkDataPtr, &compressedChunkSize, sizeof(uint32));
+					chunkDataPtr += sizeof(uint32) + compressedChunkSize;
+					view.sentChunks.insert(chunk->chunkCoords);
+					view.unsentChunks.erase(chunk->chunkCoords);
+					numChunks++;
+				}
+
+				uint32 numChunksRemaining = (uint32)(chunksToSend.size() - chunkIndex) + numSpawnChunksLoading;
+				g_memory_copyMem(packetData, &numChunks, sizeof(uint16));
+				g_memory_copyMem(packetData + sizeof(uint16), &numChunksRemaining, sizeof(uint32));
+				size_t packetSize = chunkDataPtr - packetData;
+				Network::sendEvent(view.peer, eventPacket, packetSize);
+				view.bytesInFlight += (uint32)packetSize;
+			}
+
+			if (!view.hasSpawned)
+			{
+				// Anything left to send is further out than the spawn radius
+				bool spawnChunksSent = numSpawnChunksLoading == 0 && chunkIndex == chunksToSend.size();
+				if (numSpawnChunksLoading == 0 && !spawnChunksSent)
+				{
+					glm::ivec2 localChunkPos = chunksToSend[chunkIndex]->chunkCoords - playerChunkCoords;
+					spawnChunksSent = (localChunkPos.x * localChunkPos.x) + (localChunkPos.y * localChunkPos.y) > spawnRadius * spawnRadius;
+				}
+
+				if (!spawnChunksSent && serverGameTime - view.joinTime >= maxSpawnWaitInMs)
+				{
+					g_logger_warning("%d chunks around a joining player still aren't loaded after %llu seconds, sending them in anyway.",
+						numSpawnChunksLoading, (unsigned long long)(maxSpawnWaitInMs / 1000));
+					spawnChunksSent = true;
+				}
+
+				if (spawnChunksSent)
+				{
+					finishJoin(view);
+				}
+			}
+		}
+
+		static void finishJoin(ClientView& view)
+		{
+			view.hasSpawned = true;
+
+			// Synchronize the ECS
+			Ecs::Registry* registry = Scene::getRegistry();
+			RawMemory entityMemory = registry->serialize();
+			Network::broadcast(NetworkEventType::EntityData, entityMemory.data, entityMemory.size);
+			// Then set the new local player
+			Network::sendClient(view.peer, NetworkEventType::LocalPlayer, &view.player, sizeof(Ecs::EntityId));
+			g_memory_free(entityMemory.data);
+
+			SizedMemory timeData = pack<int>(World::worldTime);
+			Network::sendClientCommand(ClientCommandType::SetTime, timeData, view.peer);
+			g_memory_free(timeData.memory);
+		}
+
+		static bool isReadyToStream(const Chunk& chunk)
+		{
+			// Lighting waits on the decorations around the chunk, so a lit chunk already has its trees
+			return chunk.state == ChunkState::Loaded && !chunk.needsToCalculateLighting;
+		}
+
+		static void updateClientTransforms()
+		{
+			// Players get moved every update instead of only when a transform from them comes in
+			Ecs::Registry* registry = Scene::getRegistry();
+			for (const auto& [entity, ring] : transformCommandBuffer.entities)
+			{
+				glm::vec3 position, orientation;
+				if (registry->hasComponent<Transform>(entity) && transformCommandBuffer.predict(lagInMs, entity, &position, &orientation))
+				{
+					Transform& transform = registry->getComponent<Transform>(entity);
+					transform.position = position;
+					transform.orientation = orientation;
+				}
+			}
+		}
+
+		static void sendTransforms()
+		{
+			if (latestTransforms.empty() || numConnectedClients == 0)
+			{
+				return;
+			}
+
+			updateEntityGrid();
+
+			static std::vector<EntityTransform> transforms;
+			static std::vector<Ecs::EntityId> leftEntities;
+			static std::vector<uint8> keyframeData;
+			static std::vector<uint8> deltaData;
+			static std::vector<uint8> leaveData;
+			size_t bytesSent = 0;
+			for (auto& [peer, view] : clientViews)
+			{
+				// They don't know about any entities until they get the ECS at the end of the join
+				if (!view.hasSpawned)
+				{
+					continue;
+				}
+
+				findRelevantEntities(view, transforms, leftEntities);
+
+				// Leaves and keyframes have to make it, dropping a delta just means the next one fixes it
+				if (!leftEntities.empty())
+				{
+					view.transformEncoder.remove(leftEntities, leaveData);
+					Network::sendUserCommand(UserCommandType::UpdateTransform, SizedMemory{ leaveData.data(), leaveData.size() }, peer, true);
+					bytesSent += sizeof(NetworkEvent) + sizeof(UserCommand) + leaveData.size();
+				}
+
+				view.transformEncoder.encode(transforms, keyframeData, deltaData);
+				if (!keyframeData.empty())
+				{
+					Network::sendUserCommand(UserCommandType::UpdateTransform, SizedMemory{ keyframeData.data(), keyframeData.size() }, peer, true);
+					bytesSent += sizeof(NetworkEvent) + sizeof(UserCommand) + keyframeData.size();
+				}
+				if (!deltaData.empty())
+				{
+					Network::sendUserCommand(UserCommandType::UpdateTransform, SizedMemory{ deltaData.data(), deltaData.size() }, peer, false);
+					bytesSent += sizeof(NetworkEvent) + sizeof(UserCommand) + deltaData.size();
+				}
+			}
+
+			// Compared against sending every transform to every client
+			DebugStats::transformBytesSent += bytesSent;
+			DebugStats::transformBytesUncompressed += latestTransforms.size() * TransformStream::uncompressedSize() * numConnectedClients;
+		}
+
+		static void updateEntityGrid()
+		{
+			// Cells get reused between updates so their vectors don't get reallocated every time
+			for (auto& [chunkCoords, entities] : entityGrid)
+			{
+				entities.clear();
+			}
+
+			for (const auto& [entity, entityTransform] : latestTransforms)
+			{
+				entityGrid[World::toChunkCoords(entityTransform.position)].push_back(entity);
+			}
+
+			for (auto iter = entityGrid.begin(); iter != entityGrid.end();)
+			{
+				if (iter->second.empty())
+				{
+					iter = entityGrid.erase(iter);
+				}
+				else
+				{
+					iter++;
+				}
+			}
+		}
+
+		static void findRelevantEntities(ClientView& view, std::vector<EntityTransform>& transforms, std::vector<Ecs::EntityId>& leftEntities)
+		{
+			transforms.clear();
+			leftEntities.clear();
+
+			glm::vec3 playerPosition;
+			auto playerIter = latestTransforms.find(view.player);
+			if (playerIter != latestTransforms.end())
+			{
+				playerPosition = playerIter->second.position;
+			}
+			else
+			{
+				Ecs::Registry* registry = Scene::getRegistry();
+				if (!registry->hasComponent<Transform>(view.player))
+				{
+					return;
+				}
+				playerPosition = registry->getComponent<Transform>(view.player).position;
+			}
+
+			// Entities become relevant once they're within view, but they have to make it a chunk past
+			// that before they leave again so nobody flickers in and out on the border
+			const int viewRadius = World::ChunkRadius;
+			const int leaveRadius = World::ChunkRadius + 1;
+			glm::ivec2 playerChunkCoords = World::toChunkCoords(playerPosition);
+			static robin_hood::unordered_flat_set<Ecs::EntityId> nextRelevantEntities;
+			nextRelevantEntities.clear();
+
+			auto addCell = [&](const glm::ivec2& chunkCoords, const std::vector<Ecs::EntityId>& entities)
+			{
+				glm::ivec2 localChunkPos = chunkCoords - playerChunkCoords;
+				int distanceSquared = (localChunkPos.x * localChunkPos.x) + (localChunkPos.y * localChunkPos.y);
+				if (distanceSquared > leaveRadius * leaveRadius)
+				{
+					return;
+				}
+
+				bool inView = distanceSquared <= viewRadius * viewRadius;
+				for (Ecs::EntityId entity : entities)
+				{
+					// Clients are in charge of their own player
+					if (entity == view.player)
+					{
+						continue;
+					}
+
+					if (inView || view.relevantEntities.find(entity) != view.relevantEntities.end())
+					{
+						nextRelevantEntities.insert(entity);
+						transforms.push_back(latestTransforms[entity]);
+					}
+				}
+			};
+
+			// Look up the cells around the player unless there are fewer occupied cells than that,
+			// either way this only touches the entities close to the player
+			int gridWidth = (leaveRadius * 2) + 1;
+			if (entityGrid.size() < (size_t)(gridWidth * gridWidth))
+			{
+				for (const auto& [chunkCoords, entities] : entityGrid)
+				{
+					addCell(chunkCoords, entities);
+				}
+			}
+			else
+			{
+				for (int z = playerChunkCoords.y - leaveRadius; z <= playerChunkCoords.y + leaveRadius; z++)
+				{
+					for (int x = playerChunkCoords.x - leaveRadius; x <= playerChunkCoords.x + leaveRadius; x++)
+					{
+						auto cellIter = entityGrid.find(glm::ivec2(x, z));
+						if (cellIter != entityGrid.end())
+						{
+							addCell(cellIter->first, cellIter->second);
+						}
+					}
+				}
+			}
+
+			for (Ecs::EntityId entity : view.relevantEntities)
+			{
+				if (nextRelevantEntities.find(entity) == nextRelevantEntities.end())
+				{
+					leftEntities.push_back(entity);
+				}
+			}
+			std::swap(view.relevantEntities, nextRelevantEntities);
+		}
 	}
-}
\ No newline at end of file
+}
@@ -1,174 +1,193 @@
 #include "network/TransformCommandBuffer.h"
 #include "network/Network.h"
-#include "core/Scene.h"
-#include "core/Components.h"
 
 namespace Minecraft
 {
-	void TransformCommandBuffer::init(int inMaxNumPositionCommands)
+	static_assert((TransformSnapshotRing::capacity & (TransformSnapshotRing::capacity - 1)) == 0, "The snapshot ring capacity must be a power of two.");
+
+	// Past the newest snapshot the entity keeps moving at its last velocity for at most this long,
+	// after that it just waits where it is
+	static constexpr uint64 maxExtrapolationInMs = 250;
+
+	// Internal functions
+	static uint32 findSnapshotBefore(TransformSnapshotRing& ring, uint64 time);
+	static glm::vec3 velocityBetween(const TransformSnapshot& a, const TransformSnapshot& b);
+	static glm::vec3 hermite(const glm::vec3& p0, const glm::vec3& m0, const glm::vec3& p1, const glm::vec3& m1, float t, float duration);
+
+	void TransformCommandBuffer::init(int maxNumEntities)
 	{
-		maxSize = inMaxNumPositionCommands;
-		buffer = (UpdateTransformCommand*)g_memory_allocate(sizeof(UpdateTransformCommand) * maxSize);
-		size = 0;
+		rings = new Pool<TransformSnapshotRing>(1, maxNumEntities);
+		entities.clear();
 	}
 
 	void TransformCommandBuffer::free()
 	{
-		if (buffer)
+		if (rings)
 		{
-			g_memory_free(buffer);
-			size = 0;
-			buffer = nullptr;
+			delete rings;
+			rings = nullptr;
 		}
+		entities.clear();
 	}
 
 	void TransformCommandBuffer::insert(const UpdateTransformCommand& command)
 	{
-		if (!buffer)
+		if (!rings)
 		{
 			return;
 		}
 
-		int indexToInsertAt = -1;
-		// Do binary search to find where we should put the new command based on timestamp
-		int left = 0;
-		int right = size;
-		while (left != right)
+		TransformSnapshotRing* ring;
+		auto iter = entities.find(command.entity);
+		if (iter != entities.end())
 		{
-			int mid = left + ((right - left) / 2);
-			if (command.timestamp < buffer[mid].timestamp)
-			{
-				// Search the left half
-				if (right == mid)
-				{
-					right = glm::max(mid - 1, left);
-				}
-				else
-				{
-					right = mid;
-				}
-			}
-			else if (command.timestamp > buffer[mid].timestamp)
+			ring = iter->second;
+		}
+		else
+		{
+			ring = rings->getNewPool();
+			if (!ring)
 			{
-				if (left == mid)
-				{
-					left = glm::min(mid + 1, right);
-				}
-				else
-				{
-					left = mid;
-				}
+				g_logger_error("Too many entities to buffer transforms for, dropping the transform for entity '%llu'.", command.entity);
+				return;
 			}
-			else
+			ring->head = 0;
+			ring->size = 0;
+			entities[command.entity] = ring;
+		}
+
+		TransformSnapshot snapshot;
+		snapshot.timestamp = command.timestamp;
+		snapshot.position = command.position;
+		snapshot.orientation = command.orientation;
+
+		if (ring->size > 0)
+		{
+			TransformSnapshot& newest = (*ring)[ring->size - 1];
+			if (snapshot.timestamp < newest.timestamp)
 			{
-				indexToInsertAt = mid;
-				break;
+				// The transforms channel keeps things in order, anything this old is stale anyways
+				return;
 			}
-
-			if (right == left)
+			else if (snapshot.timestamp == newest.timestamp)
 			{
-				indexToInsertAt = right;
-				break;
+				// More than one update in the same millisecond, the latest one wins
+				newest = snapshot;
+				return;
 			}
 		}
 
-		// Add the command to the end of the list if there's no room for it
-		if (indexToInsertAt == -1)
+		if (ring->size < TransformSnapshotRing::capacity)
 		{
-			indexToInsertAt = size;
+			ring->size++;
 		}
-
-		// Move the data as necessary to make room for the next command
-		if (indexToInsertAt >= maxSize)
+		else
 		{
-			indexToInsertAt = maxSize - 1;
-			size--;
-			// Otherwise move to the left
-			std::memmove(buffer, buffer + 1,
-				sizeof(UpdateTransformCommand) * indexToInsertAt);
+			// Full, so the oldest snapshot gets overwritten
+			ring->head = (ring->head + 1) & (TransformSnapshotRing::capacity - 1);
 		}
-		else if (indexToInsertAt < size)
+		(*ring)[ring->size - 1] = snapshot;
+	}
+
+	void TransformCommandBuffer::remove(Ecs::EntityId entity)
+	{
+		auto iter = entities.find(entity);
+		if (iter != entities.end())
 		{
-			if (size + 1 < maxSize)
-			{
-				// Move data to the right if we have room
-				std::memmove(buffer + indexToInsertAt + 1, buffer + indexToInsertAt,
-					sizeof(UpdateTransformCommand) * (size - indexToInsertAt));
-			}
-			else
-			{
-				if (indexToInsertAt == 0)
-				{
-					// If we're trying to insert an element at the beginning of the array
-					// and we have no more room for new stuff, just discard this because
-					// it's too old anyways and we don't care about it anymore
-					return;
-				}
-
-				// Otherwise move to the left
-				std::memmove(buffer, buffer + 1,
-					sizeof(UpdateTransformCommand) * indexToInsertAt);
-				size--;
-			}
+			rings->freePool(iter->second);
+			entities.erase(iter);
 		}
-
-		// Insert the command into the list and increment the number of commands
-		g_memory_copyMem(buffer + indexToInsertAt, (void*)&command, sizeof(UpdateTransformCommand));
-		size++;
 	}
 
 	bool TransformCommandBuffer::predict(uint64 lagCompensation, Ecs::EntityId entity, glm::vec3* position, glm::vec3* orientation)
 	{
-		bool predictionSuccess = false;
+		auto iter = entities.find(entity);
+		if (iter == entities.end() || iter->second->size == 0)
+		{
+			return false;
+		}
 
-		// Interpolate or extrapolate based on our commands
-		uint64 minTime = Network::now() - lagCompensation;
+		TransformSnapshotRing& ring = *iter->second;
+		uint64 now = Network::now();
+		uint64 renderTime = now > lagCompensation ? now - lagCompensation : 0;
 
-		for (int i = size - 1; i >= 0; i--)
+		const TransformSnapshot& oldest = ring[0];
+		const TransformSnapshot& newest = ring[ring.size - 1];
+		if (renderTime <= oldest.timestamp || ring.size == 1)
 		{
-			UpdateTransformCommand& currentUpdateCmd = (*this)[i];
-			if (currentUpdateCmd.timestamp < minTime && currentUpdateCmd.entity == entity)
-			{
-				for (int j = i + 1; j < size; j++)
-				{
-					UpdateTransformCommand& nextUpdateCmd = (*this)[j];
-					if (nextUpdateCmd.entity == entity)
-					{
-						predictionSuccess = true;
-						// Interpolate
-						uint64 deltaInMs = nextUpdateCmd.timestamp - currentUpdateCmd.timestamp;
-						float timeInterpolated = (float)((double)(minTime - currentUpdateCmd.timestamp) / (double)deltaInMs);
-						*position = currentUpdateCmd.position +
-							((nextUpdateCmd.position - currentUpdateCmd.position) * timeInterpolated);
-						*orientation = currentUpdateCmd.orientation +
-							((nextUpdateCmd.orientation - currentUpdateCmd.orientation) * timeInterpolated);
-					}
-				}
-
-				break;
-			}
+			*position = oldest.position;
+			*orientation = oldest.orientation;
+			return true;
+		}
+
+		if (renderTime >= newest.timestamp)
+		{
+			// Nothing this recent came in yet, keep going the way it was going for a little while
+			const TransformSnapshot& previous = ring[ring.size - 2];
+			float extrapolateInMs = (float)glm::min(renderTime - newest.timestamp, maxExtrapolationInMs);
+			*position = newest.position + velocityBetween(previous, newest) * extrapolateInMs;
+			*orientation = newest.orientation;
+			return true;
 		}
 
-		if (!predictionSuccess)
+		// Hermite interpolation between the two snapshots around the render time, with the tangents
+		// taken from their neighbours so the motion stays smooth across snapshots
+		uint32 index = findSnapshotBefore(ring, renderTime);
+		const TransformSnapshot& start = ring[index];
+		const TransformSnapshot& end = ring[index + 1];
+		glm::vec3 startVelocity = index > 0
+			? velocityBetween(ring[index - 1], end)
+			: velocityBetween(start, end);
+		glm::vec3 endVelocity = index + 2 < ring.size
+			? velocityBetween(start, ring[index + 2])
+			: velocityBetween(start, end);
+
+		float duration = (float)(end.timestamp - start.timestamp);
+		float t = (float)(renderTime - start.timestamp) / duration;
+		*position = hermite(start.position, startVelocity, end.position, endVelocity, t, duration);
+		// The decoder already unwraps the angles, so these never spin the long way around
+		*orientation = start.orientation + (end.orientation - start.orientation) * t;
+		return true;
+	}
+
+	// =====================================================
+	// Internal functions
+	// =====================================================
+	static uint32 findSnapshotBefore(TransformSnapshotRing& ring, uint64 time)
+	{
+		// The last snapshot at or before the time, the caller makes sure there's one after it too
+		uint32 left = 0;
+		uint32 right = ring.size - 1;
+		while (right - left > 1)
 		{
-			// Extrapolate if we have some history left
-			//g_logger_warning("Extrapolation being performed. This must be a laggy network.");
-			if (size > 1)
+			uint32 mid = left + ((right - left) / 2);
+			if (ring[mid].timestamp <= time)
 			{
-				//uint64 deltaInMs = positionCommandBuffer[positionCommandBuffer.size - 1].timestamp -
-				//	positionCommandBuffer[positionCommandBuffer.size - 2].timestamp;
-				//float timeInterpolated = (float)((double)(minTime - positionCommandBuffer[positionCommandBuffer.size - 1].timestamp) / (double)deltaInMs);
-				//position = positionCommandBuffer[positionCommandBuffer.size - 1].position +
-				//	((positionCommandBuffer[positionCommandBuffer.size - 1].position - positionCommandBuffer[positionCommandBuffer.size - 2].position) *
-				//		timeInterpolated);
-				//foundPosition = true;
+				left = mid;
 			}
 			else
 			{
-				g_logger_error("Failed to extrapolate or interpolate the position.");
+				right = mid;
 			}
 		}
 
-		return predictionSuccess;
+		return left;
+	}
+
+	static glm::vec3 velocityBetween(const TransformSnapshot& a, const TransformSnapshot& b)
+	{
+		// Per millisecond, timestamps in a ring are always strictly increasing
+		return (b.position - a.position) / (float)(b.timestamp - a.timestamp);
+	}
+
+	static glm::vec3 hermite(const glm::vec3& p0, const glm::vec3& m0, const glm::vec3& p1, const glm::vec3& m1, float t, float duration)
+	{
+		float t2 = t * t;
+		float t3 = t2 * t;
+		float h00 = 2.0f * t3 - 3.0f * t2 + 1.0f;
+		float h10 = t3 - 2.0f * t2 + t;
+		float h01 = -2.0f * t3 + 3.0f * t2;
+		float h11 = t3 - t2;
+		return h00 * p0 + h10 * duration * m0 + h01 * p1 + h11 * duration * m1;
 	}
-}
\ No newline at end of file
+}
@@ -0,0 +1,259 @@
+#include "network/TransformStream.h"
+#include "network/Network.h"
+
+namespace Minecraft
+{
+	// Packet layout
+	// TransformPacketType (uint8) -> numEntities (uint16) -> entity * numEntities
+	// Keyframe: entity (uint64) -> keyframeId (uint8) -> position (int32 * 3) -> orientation (uint16 * 3)
+	// Delta:    entity (uint64) -> keyframeId (uint8) -> offset from keyframe (int16 * 3) -> orientation (uint16 * 3)
+	// Leave:    entity (uint64)
+	enum class TransformPacketType : uint8
+	{
+		Delta,
+		Keyframe,
+		Leave
+	};
+
+	static const float positionScale = 64.0f;
+	static const float orientationScale = 65536.0f / 360.0f;
+	// Roughly once a second at 60 updates per second
+	static const uint16 keyframeInterval = 60;
+
+	// Internal functions
+	static glm::ivec3 quantizePosition(const glm::vec3& position);
+	static glm::u16vec3 quantizeOrientation(const glm::vec3& orientation);
+	static glm::vec3 dequantizeOrientation(const glm::u16vec3& orientation, const glm::vec3* previousOrientation);
+	static bool fitsInDelta(const glm::ivec3& offset);
+	static void beginPacket(std::vector<uint8>& data, TransformPacketType type);
+	static void finishPacket(std::vector<uint8>& data, uint16 numEntities);
+
+	template<typename T>
+	static void write(std::vector<uint8>& data, const T& value)
+	{
+		size_t offset = data.size();
+		data.resize(offset + sizeof(T));
+		g_memory_copyMem(data.data() + offset, (void*)&value, sizeof(T));
+	}
+
+	template<typename T>
+	static bool read(const uint8* data, size_t dataSize, size_t* offset, T* value)
+	{
+		if (*offset + sizeof(T) > dataSize)
+		{
+			return false;
+		}
+		g_memory_copyMem(value, (void*)(data + *offset), sizeof(T));
+		*offset += sizeof(T);
+		return true;
+	}
+
+	void TransformEncoder::encode(const std::vector<EntityTransform>& transforms, std::vector<uint8>& keyframeData, std::vector<uint8>& deltaData)
+	{
+		keyframeData.clear();
+		deltaData.clear();
+		uint16 numKeyframes = 0;
+		uint16 numDeltas = 0;
+		beginPacket(keyframeData, TransformPacketType::Keyframe);
+		beginPacket(deltaData, TransformPacketType::Delta);
+
+		for (const EntityTransform& transform : transforms)
+		{
+			glm::ivec3 position = quantizePosition(transform.position);
+			glm::u16vec3 orientation = quantizeOrientation(transform.orientation);
+
+			auto iter = entities.find(transform.entity);
+			bool isNewEntity = iter == entities.end();
+			if (isNewEntity)
+			{
+				iter = entities.emplace(transform.entity, EntityState{}).first;
+				iter->second.keyframeId = 0;
+			}
+
+			EntityState& state = iter->second;
+			state.updatesSinceKeyframe++;
+			glm::ivec3 offset = position - state.keyframePosition;
+			bool needsKeyframe = isNewEntity || state.updatesSinceKeyframe >= keyframeInterval || !fitsInDelta(offset);
+			if (needsKeyframe)
+			{
+				state.keyframePosition = position;
+				state.keyframeId++;
+				state.updatesSinceKeyframe = 0;
+
+				write<Ecs::EntityId>(keyframeData, transform.entity);
+				write<uint8>(keyframeData, state.keyframeId);
+				write<glm::ivec3>(keyframeData, position);
+				write<glm::u16vec3>(keyframeData, orientation);
+				numKeyframes++;
+			}
+			else if (position != state.lastPosition || orientation != state.lastOrientation)
+			{
+				write<Ecs::EntityId>(deltaData, transform.entity);
+				write<uint8>(deltaData, state.keyframeId);
+				write<glm::i16vec3>(deltaData, glm::i16vec3(offset));
+				write<glm::u16vec3>(deltaData, orientation);
+				numDeltas++;
+			}
+
+			state.lastPosition = position;
+			state.lastOrientation = orientation;
+		}
+
+		finishPacket(keyframeData, numKeyframes);
+		finishPacket(deltaData, numDeltas);
+	}
+
+	void TransformEncoder::remove(const std::vector<Ecs::EntityId>& leftEntities, std::vector<uint8>& leaveData)
+	{
+		leaveData.clear();
+		beginPacket(leaveData, TransformPacketType::Leave);
+		for (Ecs::EntityId entity : leftEntities)
+		{
+			// Forgetting the entity means it gets a fresh keyframe if it ever comes back
+			entities.erase(entity);
+			write<Ecs::EntityId>(leaveData, entity);
+		}
+		finishPacket(leaveData, (uint16)leftEntities.size());
+	}
+
+	bool TransformDecoder::decode(const uint8* data, size_t dataSize, std::vector<EntityTransform>& transforms)
+	{
+		size_t offset = 0;
+		TransformPacketType type;
+		uint16 numEntities;
+		if (!read<TransformPacketType>(data, dataSize, &offset, &type) || !read<uint16>(data, dataSize, &offset, &numEntities) ||
+			type > TransformPacketType::Leave)
+		{
+			return false;
+		}
+
+		for (uint16 i = 0; i < numEntities; i++)
+		{
+			Ecs::EntityId entity;
+			if (!read<Ecs::EntityId>(data, dataSize, &offset, &entity))
+			{
+				return false;
+			}
+
+			if (type == TransformPacketType::Leave)
+			{
+				entities.erase(entity);
+				continue;
+			}
+
+			uint8 keyframeId;
+			glm::ivec3 position;
+			glm::u16vec3 orientation;
+			if (!read<uint8>(data, dataSize, &offset, &keyframeId))
+			{
+				return false;
+			}
+
+			auto iter = entities.find(entity);
+			if (type == TransformPacketType::Keyframe)
+			{
+				if (!read<glm::ivec3>(data, dataSize, &offset, &position) || !read<glm::u16vec3>(data, dataSize, &offset, &orientation))
+				{
+					return false;
+				}
+
+				const glm::vec3* previousOrientation = iter != entities.end() ? &iter->second.lastOrientation : nullptr;
+				EntityState state;
+				state.keyframePosition = position;
+				state.lastOrientation = dequantizeOrientation(orientation, previousOrientation);
+				state.keyframeId = keyframeId;
+				entities[entity] = state;
+				transforms.push_back({ entity, glm::vec3(position) / positionScale, state.lastOrientation });
+			}
+			else
+			{
+				glm::i16vec3 positionOffset;
+				if (!read<glm::i16vec3>(data, dataSize, &offset, &positionOffset) || !read<glm::u16vec3>(data, dataSize, &offset, &orientation))
+				{
+					return false;
+				}
+
+				if (iter == entities.end() || iter->second.keyframeId != keyframeId)
+				{
+					// Joined after the keyframe went out, the next one will catch us up
+					continue;
+				}
+
+				EntityState& state = iter->second;
+				position = state.keyframePosition + glm::ivec3(positionOffset);
+				state.lastOrientation = dequantizeOrientation(orientation, &state.lastOrientation);
+				transforms.push_back({ entity, glm::vec3(position) / positionScale, state.lastOrientation });
+			}
+		}
+
+		return offset == dataSize;
+	}
+
+	namespace TransformStream
+	{
+		size_t uncompressedSize()
+		{
+			return sizeof(NetworkEvent) + sizeof(UserCommand) + sizeof(glm::vec3) * 2 + sizeof(Ecs::EntityId);
+		}
+	}
+
+	// =====================================================
+	// Internal functions
+	// =====================================================
+	static glm::ivec3 quantizePosition(const glm::vec3& position)
+	{
+		return glm::ivec3(glm::round(position * positionScale));
+	}
+
+	static glm::u16vec3 quantizeOrientation(const glm::vec3& orientation)
+	{
+		// Wraps around, so any angle ends up somewhere in a single turn
+		return glm::u16vec3(
+			(uint16)((int64)glm::round(orientation.x * orientationScale) & 0xFFFF),
+			(uint16)((int64)glm::round(orientation.y * orientationScale) & 0xFFFF),
+			(uint16)((int64)glm::round(orientation.z * orientationScale) & 0xFFFF));
+	}
+
+	static glm::vec3 dequantizeOrientation(const glm::u16vec3& orientation, const glm::vec3* previousOrientation)
+	{
+		glm::vec3 angles = glm::vec3(orientation) / orientationScale;
+		if (!previousOrientation)
+		{
+			// Keep angles like pitch centered around 0
+			return glm::vec3(
+				angles.x > 180.0f ? angles.x - 360.0f : angles.x,
+				angles.y > 180.0f ? angles.y - 360.0f : angles.y,
+				angles.z > 180.0f ? angles.z - 360.0f : angles.z);
+		}
+
+		// Take the shortest way around from the last orientation so interpolating between
+		// updates never spins the long way
+		glm::vec3 difference = angles - *previousOrientation;
+		difference -= 360.0f * glm::round(difference / 360.0f);
+		return *previousOrientation + difference;
+	}
+
+	static bool fitsInDelta(const glm::ivec3& offset)
+	{
+		return offset.x >= INT16_MIN && offset.x <= INT16_MAX &&
+			offset.y >= INT16_MIN && offset.y <= INT16_MAX &&
+			offset.z >= INT16_MIN && offset.z <= INT16_MAX;
+	}
+
+	static void beginPacket(std::vector<uint8>& data, TransformPacketType type)
+	{
+		write<TransformPacketType>(data, type);
+		write<uint16>(data, 0);
+	}
+
+	static void finishPacket(std::vector<uint8>& data, uint16 numEntities)
+	{
+		if (numEntities == 0)
+		{
+			data.clear();
+			return;
+		}
+
+		g_memory_copyMem(data.data() + sizeof(uint8), &numEntities, sizeof(uint16));
+	}
+}
@@ -99,6 +99,7 @@ namespace Minecraft
 
 					resolveStaticCollision(entity, rb, transform, boxCollider);
 
+#ifndef _HEADLESS
 					if (entity != World::getLocalPlayer())
 					{
 						Style redStyle = Styles::defaultStyle;
@@ -106,6 +107,7 @@ namespace Minecraft
 						redStyle.strokeWidth = 0.3f;
 						Renderer::drawBox(transform.position, boxCollider.size, redStyle);
 					}
+#endif
 				}
 			}
 		}
@@ -0,0 +1,380 @@
+#include "renderer/ChunkRenderer.h"
+#include "renderer/Shader.h"
+#include "renderer/Renderer.h"
+#include "renderer/Frustum.h"
+#include "renderer/Framebuffer.h"
+#include "renderer/Texture.h"
+#include "world/World.h"
+#include "world/ChunkManager.h"
+#include "core/Application.h"
+#include "utils/DebugStats.h"
+#include "utils/Constants.h"
+
+namespace Minecraft
+{
+	namespace ChunkRenderer
+	{
+		struct DrawCommand
+		{
+			DrawArraysIndirectCommand command;
+			int distanceToPlayer;
+			int level;
+		};
+
+		namespace DrawCommandUtil
+		{
+			bool operator<(const DrawCommand& a, const DrawCommand& b)
+			{
+				return a.distanceToPlayer < b.distanceToPlayer;
+			}
+
+			static bool operator>(const DrawCommand& a, const DrawCommand& b)
+			{
+				return a.distanceToPlayer > b.distanceToPlayer;
+			}
+		}
+
+		class CommandBufferContainer
+		{
+		public:
+			CommandBufferContainer(int maxNumCommands, bool isTransparent)
+			{
+				this->maxNumCommands = maxNumCommands;
+				this->isTransparent = isTransparent;
+				commandBuffer = nullptr;
+				chunkPosBuffer = nullptr;
+				biomeBuffer = nullptr;
+				numCommands = 0;
+			}
+
+			void init()
+			{
+				this->commandBuffer = (DrawCommand*)g_memory_allocate(sizeof(DrawCommand) * maxNumCommands);
+				this->chunkPosBuffer = (int32*)g_memory_allocate(sizeof(int32) * maxNumCommands * 2);
+				this->biomeBuffer = (int32*)g_memory_allocate(sizeof(int32) * maxNumCommands);
+				this->numCommands = 0;
+			}
+
+			void free()
+			{
+				if (commandBuffer)
+				{
+					g_memory_free(commandBuffer);
+					commandBuffer = nullptr;
+				}
+
+				if (chunkPosBuffer)
+				{
+					g_memory_free(chunkPosBuffer);
+					chunkPosBuffer = nullptr;
+				}
+
+				if (biomeBuffer)
+				{
+					g_memory_free(biomeBuffer);
+					biomeBuffer = nullptr;
+				}
+			}
+
+			void add(const DrawArraysIndirectCommand& command, const glm::ivec2& chunkCoords, int level, const glm::ivec2& playerPosChunkCoords, int biome)
+			{
+				g_logger_assert((numCommands + 1) < maxNumCommands, "Ran out of room in command buffer!");
+				glm::ivec2 d = chunkCoords - playerPosChunkCoords;
+				int dSquared = (d.x * d.x) + (d.y * d.y);
+				commandBuffer[numCommands] = { command, dSquared, level };
+				commandBuffer[numCommands].command.baseInstance = numCommands;
+				chunkPosBuffer[(numCommands * 2)] = chunkCoords.x;
+				chunkPosBuffer[(numCommands * 2) + 1] = chunkCoords.y;
+				biomeBuffer[numCommands] = biome;
+				numCommands++;
+			}
+
+			void sort(const glm::ivec2& playerPosChunkCoords)
+			{
+				if (!isTransparent)
+				{
+					// Sort chunks front to back
+					std::sort(commandBuffer, commandBuffer + numCommands, DrawCommandUtil::operator<);
+				}
+				else
+				{
+					std::sort(commandBuffer, commandBuffer + numCommands, DrawCommandUtil::operator>);
+				}
+			}
+
+			inline int getNumCommands() const
+			{
+				return numCommands;
+			}
+
+			inline const DrawCommand* getCommandBuffer() const
+			{
+				return commandBuffer;
+			}
+
+			inline const int32* getChunkPosBuffer() const
+			{
+				return chunkPosBuffer;
+			}
+
+			inline const int32* getBiomeBuffer() const
+			{
+				return biomeBuffer;
+			}
+
+			inline void softReset()
+			{
+				numCommands = 0;
+			}
+
+		private:
+			int maxNumCommands;
+			int numCommands;
+			bool isTransparent;
+			DrawCommand* commandBuffer;
+			int32* chunkPosBuffer;
+			int32* biomeBuffer;
+		};
+
+
+		// Internal variables
+		static uint32 chunkPosInstancedBuffer;
+		static uint32 biomeInstancedVbo;
+		static uint32 globalVao;
+		static uint32 globalRenderVbo;
+		// TODO: Make this better
+		static uint32 solidDrawCommandVbo;
+		static uint32 blendableDrawCommandVbo;
+		static Shader compositeShader;
+
+		static CommandBufferContainer* solidCommandBuffer = nullptr;
+		static CommandBufferContainer* blendableCommandBuffer = nullptr;
+
+		void init(Pool<SubChunk>& subChunks)
+		{
+			// A chunk uses 55,000 vertices on average, so a sub-chunk can be estimated to use about 
+			// 4,500 vertices on average. That's the default vertex bucket size
+			solidCommandBuffer = new CommandBufferContainer(subChunks.size(), false);
+			blendableCommandBuffer = new CommandBufferContainer(subChunks.size(), true);
+
+			compositeShader.compile("assets/shaders/CompositeShader.glsl");
+
+			// Set up draw commands to relate to our sub chunks
+			solidCommandBuffer->init();
+			glCreateBuffers(1, &solidDrawCommandVbo);
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, solidDrawCommandVbo);
+			glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawCommand) * subChunks.size(), NULL, GL_DYNAMIC_DRAW);
+
+			blendableCommandBuffer->init();
+			glCreateBuffers(1, &blendableDrawCommandVbo);
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, blendableDrawCommandVbo);
+			glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawCommand) * subChunks.size(), NULL, GL_DYNAMIC_DRAW);
+
+			// Initialize the SubChunks
+			// Generate a bunch of empty vertex buckets for GPU use
+			glCreateVertexArrays(1, &globalVao);
+			glBindVertexArray(globalVao);
+
+			glGenBuffers(1, &globalRenderVbo);
+			glBindBuffer(GL_ARRAY_BUFFER, globalRenderVbo);
+
+			size_t totalSizeOfSubChunkVertices = subChunks.size() * World::MaxVertsPerSubChunk * sizeof(Vertex);
+
+			// Set our vertex attribute pointers
+			glVertexAttribIPointer(0, 1, GL_UNSIGNED_INT, sizeof(Vertex), (void*)offsetof(Vertex, data1));
+			glVertexAttribDivisor(0, 0);
+			glEnableVertexAttribArray(0);
+
+			glVertexAttribIPointer(1, 1, GL_UNSIGNED_INT, sizeof(Vertex), (void*)(offsetof(Vertex, data2)));
+			glVertexAttribDivisor(1, 0);
+			glEnableVertexAttribArray(1);
+
+			// Set up our global immutable buffer
+			GLbitfield flags = GL_MAP_PERSISTENT_BIT | GL_MAP_WRITE_BIT | GL_MAP_COHERENT_BIT;
+			glBufferStorage(GL_ARRAY_BUFFER, totalSizeOfSubChunkVertices, NULL, flags);
+			Vertex* basePointer = (Vertex*)glMapBufferRange(GL_ARRAY_BUFFER, 0, subChunks.size() * World::MaxVertsPerSubChunk, flags);
+			for (uint32 i = 0; i < subChunks.size(); i++)
+			{
+				// Assign the pointers for the data on the CPU
+				subChunks[i]->first = (i * World::MaxVertsPerSubChunk);
+				subChunks[i]->data = basePointer + subChunks[i]->first;
+			}
+
+			// Set up the instanced chunk pos vertex buffer
+			glCreateBuffers(1, &chunkPosInstancedBuffer);
+			glBindBuffer(GL_ARRAY_BUFFER, chunkPosInstancedBuffer);
+			glBufferData(GL_ARRAY_BUFFER, sizeof(int32) * 2 * subChunks.size(), NULL, GL_DYNAMIC_DRAW);
+
+			glVertexAttribIPointer(10, 2, GL_INT, sizeof(int32) * 2, 0);
+			glVertexAttribDivisor(10, 1);
+			glEnableVertexAttribArray(10);
+
+			// Set up biome buffer
+			glCreateBuffers(1, &biomeInstancedVbo);
+			glBindBuffer(GL_ARRAY_BUFFER, biomeInstancedVbo);
+			glBufferData(GL_ARRAY_BUFFER, sizeof(int32) * subChunks.size(), NULL, GL_DYNAMIC_DRAW);
+
+			glVertexAttribIPointer(11, 1, GL_INT, sizeof(int32), 0);
+			glVertexAttribDivisor(11, 1);
+			glEnableVertexAttribArray(11);
+
+			// Subchunk = 16x16x16  Blocks
+			// BigChunk = 16x256x16 Blocks
+			g_logger_info("Vertex Pool Total Size: %2.3f Gb", (float)(totalSizeOfSubChunkVertices / (1024.0f * 1024 * 1024)));
+			DebugStats::totalChunkRamAvailable = DebugStats::totalChunkRamAvailable + (float)totalSizeOfSubChunkVertices;
+		}
+
+		void free()
+		{
+			// Delete GPU memory
+			// TODO: Do error checking on these VBOs to ensure they are valid
+			glDeleteBuffers(1, &solidDrawCommandVbo);
+			glDeleteBuffers(1, &blendableDrawCommandVbo);
+			glDeleteBuffers(1, &globalRenderVbo);
+			glDeleteBuffers(1, &chunkPosInstancedBuffer);
+			glDeleteBuffers(1, &biomeInstancedVbo);
+			glDeleteVertexArrays(1, &globalVao);
+
+			if (solidCommandBuffer)
+			{
+				solidCommandBuffer->free();
+				delete solidCommandBuffer;
+				solidCommandBuffer = nullptr;
+			}
+
+			if (blendableCommandBuffer)
+			{
+				blendableCommandBuffer->free();
+				delete blendableCommandBuffer;
+				blendableCommandBuffer = nullptr;
+			}
+
+			compositeShader.destroy();
+		}
+
+		void addSubChunk(const SubChunk& subChunk, const glm::ivec2& playerPositionInChunkCoords, const Frustum& cameraFrustum)
+		{
+			float yCenter = (float)subChunk.subChunkLevel * 16.0f;
+			glm::vec3 chunkPos = glm::vec3(subChunk.chunkCoordinates.x * World::ChunkDepth, yCenter, subChunk.chunkCoordinates.y * World::ChunkWidth);
+			if (cameraFrustum.isBoxVisible(chunkPos, chunkPos + glm::vec3(16, 16, 16)))
+			{
+				DrawArraysIndirectCommand drawCommand;
+				g_logger_assert(subChunk.numVertsUsed.load() > 0, "Sub Chunk should never have tried to upload 0 verts to GPU.");
+				drawCommand.baseInstance = 0;
+				drawCommand.instanceCount = 1;
+				drawCommand.count = subChunk.numVertsUsed;
+				drawCommand.first = subChunk.first;
+				if (subChunk.isBlendable)
+				{
+					blendableCommandBuffer->add(drawCommand, subChunk.chunkCoordinates, subChunk.subChunkLevel, playerPositionInChunkCoords, 0);
+				}
+				else
+				{
+					solidCommandBuffer->add(drawCommand, subChunk.chunkCoordinates, subChunk.subChunkLevel, playerPositionInChunkCoords, 0);
+				}
+			}
+		}
+
+		void render(const glm::vec3& playerPosition, const glm::ivec2& playerPositionInChunkCoords, Shader& opaqueShader, Shader& transparentShader)
+		{
+			glm::vec3 tint = glm::vec3(1.0f);
+			if (World::isPlayerUnderwater())
+			{
+				tint = "#497dd1"_hex;
+			}
+			if (solidCommandBuffer->getNumCommands() > 0)
+			{
+				// Render opaque geometry
+				glEnable(GL_CULL_FACE);
+				glEnable(GL_DEPTH_TEST);
+				glDepthFunc(GL_LESS);
+				glDepthMask(GL_TRUE);
+				glDisable(GL_BLEND);
+
+				solidCommandBuffer->sort(playerPositionInChunkCoords);
+				glBindBuffer(GL_ARRAY_BUFFER, chunkPosInstancedBuffer);
+				glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(int32) * 2 * solidCommandBuffer->getNumCommands(), solidCommandBuffer->getChunkPosBuffer());
+				glBindBuffer(GL_ARRAY_BUFFER, biomeInstancedVbo);
+				glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(int32) * solidCommandBuffer->getNumCommands(), solidCommandBuffer->getBiomeBuffer());
+				glBindBuffer(GL_DRAW_INDIRECT_BUFFER, solidDrawCommandVbo);
+				glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(DrawCommand) * solidCommandBuffer->getNumCommands(), solidCommandBuffer->getCommandBuffer());
+				DebugStats::numDrawCalls += solidCommandBuffer->getNumCommands();
+
+				glBindVertexArray(globalVao);
+				opaqueShader.bind();
+				opaqueShader.uploadVec3("uPlayerPosition", playerPosition);
+				opaqueShader.uploadInt("uChunkRadius", World::ChunkRadius);
+				opaqueShader.uploadVec3("uTint", tint);
+				glMultiDrawArraysIndirect(GL_TRIANGLES, NULL, solidCommandBuffer->getNumCommands(), sizeof(DrawCommand));
+				solidCommandBuffer->softReset();
+			}
+
+			if (blendableCommandBuffer->getNumCommands() > 0)
+			{
+				const GLenum blendableDrawBuffer[3] = { GL_NONE, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+				glDrawBuffers(3, blendableDrawBuffer);
+
+				const float zeroFillerVec[4] = { 0.0f, 0.0f, 0.0f };
+				glClearBufferfv(GL_COLOR, 1, &zeroFillerVec[0]);
+				const float oneFillerVec[4] = { 1.0f, 0.0f, 0.0f, 0.0f };
+				glClearBufferfv(GL_COLOR, 2, &oneFillerVec[0]);
+
+				// Render transparent geometry
+				// Disable depth writes so transparent objects don't interfere with solid passes depth values
+				glDepthMask(GL_FALSE);
+				glEnable(GL_BLEND);
+				glBlendFunci(1, GL_ONE, GL_ONE); // Accumulation blend target
+				glBlendFunci(2, GL_ZERO, GL_ONE_MINUS_SRC_COLOR); // Revealage blend target
+				glBlendEquation(GL_FUNC_ADD);
+
+				// We shouldn't need to even sort this...
+				//transparentCommandBuffer().sort(playerPositionInChunkCoords);
+				glBindBuffer(GL_ARRAY_BUFFER, chunkPosInstancedBuffer);
+				glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(int32) * 2 * blendableCommandBuffer->getNumCommands(), blendableCommandBuffer->getChunkPosBuffer());
+				glBindBuffer(GL_ARRAY_BUFFER, biomeInstancedVbo);
+				glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(int32) * blendableCommandBuffer->getNumCommands(), blendableCommandBuffer->getBiomeBuffer());
+				glBindBuffer(GL_DRAW_INDIRECT_BUFFER, blendableDrawCommandVbo);
+				glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(DrawCommand) * blendableCommandBuffer->getNumCommands(), blendableCommandBuffer->getCommandBuffer());
+				DebugStats::numDrawCalls += blendableCommandBuffer->getNumCommands();
+
+				transparentShader.bind();
+				transparentShader.uploadVec3("uPlayerPosition", playerPosition);
+				transparentShader.uploadInt("uChunkRadius", World::ChunkRadius);
+				transparentShader.uploadVec3("uTint", tint);
+
+				glBindVertexArray(globalVao);
+				glMultiDrawArraysIndirect(GL_TRIANGLES, NULL, blendableCommandBuffer->getNumCommands(), sizeof(DrawCommand));
+				blendableCommandBuffer->softReset();
+
+				// Reset render state
+				glEnable(GL_CULL_FACE);
+				glDepthMask(GL_TRUE);
+				glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+				const GLenum mainDrawBuffer[3] = { GL_COLOR_ATTACHMENT0, GL_NONE, GL_NONE };
+				glDrawBuffers(3, mainDrawBuffer);
+
+				// Blend the opaque and blended stuff together now...
+				// Set the render state for compositing our transparent and opaque buffers
+				glDepthFunc(GL_ALWAYS);
+				glEnable(GL_BLEND);
+				glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+				// Draw the screen quad
+				Framebuffer& mainFramebuffer = Application::getMainFramebuffer();
+				compositeShader.bind();
+				glActiveTexture(GL_TEXTURE0);
+				glBindTexture(GL_TEXTURE_2D, mainFramebuffer.getColorAttachment(1).graphicsId);
+				compositeShader.uploadInt("accumulationTexture", 0);
+				glActiveTexture(GL_TEXTURE1);
+				glBindTexture(GL_TEXTURE_2D, mainFramebuffer.getColorAttachment(2).graphicsId);
+				compositeShader.uploadInt("revealTexture", 1);
+
+				glBindVertexArray(Vertices::fullScreenSpaceRectangleVao);
+				glDrawArrays(GL_TRIANGLES, 0, 6);
+
+				glDepthFunc(GL_LESS);
+			}
+		}
+	}
+}
@@ -5,6 +5,10 @@
 #include "renderer/Renderer.h"
 #include "utils/CMath.h"
 #include "world/World.h"
+#include "core/Arena.hpp"
+#include "world/ChunkStandbyCache.h"
+#include "network/Network.h"
+#include "network/NetworkStats.h"
 
 namespace Minecraft
 {
@@ -16,6 +20,9 @@ namespace Minecraft
 		glm::vec3 playerOrientation = glm::vec3();
 		std::atomic<float> totalChunkRamUsed = 0.0f;
 		float totalChunkRamAvailable = 0.0f;
+		std::atomic<uint32> cancelledChunkCommands = 0;
+		std::atomic<uint64> transformBytesSent = 0;
+		std::atomic<uint64> transformBytesUncompressed = 0;
 		Block blockLookingAt = BlockMap::NULL_BLOCK;
 		Block airBlockLookingAt = BlockMap::NULL_BLOCK;
 
@@ -132,6 +139,121 @@ namespace Minecraft
 					Styles::defaultStyle);
 
 				Renderer::drawFilledSquare2D(playerPosPos - glm::vec2(0.02f, 0.01f), glm::vec2(5.1f, 0.1f), transparentSquare, -1);
+
+				// Draw fourth row of statistics
+				glm::vec2 cancelledWorkPos = glm::vec2(-2.95f, 0.99f);
+				std::string cancelledWorkStr = std::string("Cancelled chunk work: " + std::to_string(DebugStats::cancelledChunkCommands.load()));
+				Renderer::drawString(
+					cancelledWorkStr,
+					*font,
+					cancelledWorkPos,
+					textScale,
+					Styles::defaultStyle);
+
+				glm::vec2 heapAllocationsPos = glm::vec2(-1.45f, 0.99f);
+				std::string heapAllocationsStr = std::string("Pipeline heap allocs: " + std::to_string(MemoryStats::heapAllocations.load()));
+				Renderer::drawString(
+					heapAllocationsStr,
+					*font,
+					heapAllocationsPos,
+					textScale,
+					Styles::defaultStyle);
+
+				glm::vec2 standbyCachePos = glm::vec2(0.05f, 0.99f);
+				std::string standbyCacheStr = std::string("Standby chunks: " + std::to_string(ChunkStandbyCache::numChunks()) +
+					" (" + CMath::toString(ChunkStandbyCache::memoryUsed() / (1024.0f * 1024.0f)) + " Mb)");
+				Renderer::drawString(
+					standbyCacheStr,
+					*font,
+					standbyCachePos,
+					textScale,
+					Styles::defaultStyle);
+
+				Renderer::drawFilledSquare2D(cancelledWorkPos - glm::vec2(0.02f, 0.01f), glm::vec2(5.1f, 0.1f), transparentSquare, -1);
+
+				// Draw fifth row of statistics
+				uint64 transformBytesSent = DebugStats::transformBytesSent.load();
+				uint64 transformBytesUncompressed = DebugStats::transformBytesUncompressed.load();
+				float transformRatio = transformBytesUncompressed > 0 ? (float)transformBytesSent / (float)transformBytesUncompressed * 100.0f : 100.0f;
+				glm::vec2 transformBandwidthPos = glm::vec2(-2.95f, 0.87f);
+				std::string transformBandwidthStr = std::string("Transform bandwidth: " +
+					CMath::toString(transformBytesSent / 1024.0f) + " Kb sent, " +
+					CMath::toString(transformBytesUncompressed / 1024.0f) + " Kb uncompressed (" +
+					CMath::toString(transformRatio) + "%)");
+				Renderer::drawString(
+					transformBandwidthStr,
+					*font,
+					transformBandwidthPos,
+					textScale,
+					Styles::defaultStyle);
+
+				Renderer::drawFilledSquare2D(transformBandwidthPos - glm::vec2(0.02f, 0.01f), glm::vec2(5.1f, 0.1f), transparentSquare, -1);
+
+				if (Network::isNetworkEnabled())
+				{
+					// Draw sixth row of statistics
+					glm::vec2 networkTotalsPos = glm::vec2(-2.95f, 0.75f);
+					std::string networkTotalsStr = std::string("Network: " +
+						CMath::toString(NetworkStats::totalBytes(NetworkDirection::Sent) / 1024.0f) + " Kb in " +
+						std::to_string(NetworkStats::totalPackets(NetworkDirection::Sent)) + " packets sent, " +
+						CMath::toString(NetworkStats::totalBytes(NetworkDirection::Received) / 1024.0f) + " Kb in " +
+						std::to_string(NetworkStats::totalPackets(NetworkDirection::Received)) + " packets received");
+					Renderer::drawString(
+						networkTotalsStr,
+						*font,
+						networkTotalsPos,
+						textScale,
+						Styles::defaultStyle);
+
+					Renderer::drawFilledSquare2D(networkTotalsPos - glm::vec2(0.02f, 0.01f), glm::vec2(5.1f, 0.1f), transparentSquare, -1);
+
+					// Draw seventh row of statistics
+					glm::vec2 networkPeersPos = glm::vec2(-2.95f, 0.63f);
+					std::string networkPeersStr = std::string("RTT: " +
+						CMath::toString(NetworkStats::roundTripTime()) + " ms, Loss: " +
+						CMath::toString(NetworkStats::packetLoss() * 100.0f) + "%, In flight: " +
+						CMath::toString(NetworkStats::reliableBytesInFlight() / 1024.0f) + " Kb, Queued: " +
+						std::to_string(NetworkStats::queuedMessages()));
+					Renderer::drawString(
+						networkPeersStr,
+						*font,
+						networkPeersPos,
+						textScale,
+						Styles::defaultStyle);
+
+					Renderer::drawFilledSquare2D(networkPeersPos - glm::vec2(0.02f, 0.01f), glm::vec2(5.1f, 0.1f), transparentSquare, -1);
+
+					// Draw eighth row of statistics, the event type that costs the most each way
+					NetworkEventType biggestSent = NetworkEventType::ChunkData;
+					NetworkEventType biggestReceived = NetworkEventType::ChunkData;
+					for (int i = 0; i < (int)magic_enum::enum_count<NetworkEventType>(); i++)
+					{
+						NetworkEventType type = (NetworkEventType)i;
+						if (NetworkStats::getEventCounter(NetworkDirection::Sent, type).bytes > NetworkStats::getEventCounter(NetworkDirection::Sent, biggestSent).bytes)
+						{
+							biggestSent = type;
+						}
+						if (NetworkStats::getEventCounter(NetworkDirection::Received, type).bytes > NetworkStats::getEventCounter(NetworkDirection::Received, biggestReceived).bytes)
+						{
+							biggestReceived = type;
+						}
+					}
+
+					glm::vec2 networkBiggestPos = glm::vec2(-2.95f, 0.51f);
+					std::string networkBiggestStr = std::string("Most sent: " +
+						std::string(magic_enum::enum_name(biggestSent)) + " (" +
+						CMath::toString(NetworkStats::getEventCounter(NetworkDirection::Sent, biggestSent).bytes / 1024.0f) + " Kb), Most received: " +
+						std::string(magic_enum::enum_name(biggestReceived)) + " (" +
+						CMath::toString(NetworkStats::getEventCounter(NetworkDirection::Received, biggestReceived).bytes / 1024.0f) + " Kb)");
+					Renderer::drawString(
+						networkBiggestStr,
+						*font,
+						networkBiggestPos,
+						textScale,
+						Styles::defaultStyle);
+
+					Renderer::drawFilledSquare2D(networkBiggestPos - glm::vec2(0.02f, 0.01f), glm::vec2(5.1f, 0.1f), transparentSquare, -1);
+				}
 			}
 			else
 			{
@@ -9,5 +9,25 @@ namespace Minecraft
 			glm::vec4 clearColor = "#00000000"_hex;
 			const char* title = "Minecraft Clone";
 		}
+
+		namespace Chunks
+		{
+			size_t standbyCacheBudget = 64 * 1024 * 1024;
+			size_t clientCacheBudget = 32 * 1024 * 1024;
+		}
+
+		namespace Network
+		{
+			uint32 serviceTimeoutMs = 1;
+		}
+
+		namespace Server
+		{
+			const char* defaultWorldName = "Server World";
+			uint32 ticksPerSecond = 60;
+			uint32 maxPlayers = 4;
+			uint32 loadTestBots = 0;
+			uint32 loadTestSeconds = 60;
+		}
 	}
 }
\ No newline at end of file
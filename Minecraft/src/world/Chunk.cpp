@@ -7,105 +7,41 @@
 #include "utils/DebugStats.h"
 #include "network/Network.h"
 #include "core/File.h"
+#include "world/RegionFile.h"
+#include "world/ChunkCodec.h"
+#include "core/Arena.hpp"
 
 #include <xmmintrin.h>
 
 namespace Minecraft
 {
-	RawMemory Chunk::serialize() const
+	// Light propagation queues are rebuilt for every lighting task, so they live in the thread's arena
+	using BlockQueue = ArenaQueue<glm::ivec3>;
+
+	void Chunk::serialize(RawMemory& res) const
 	{
-		RawMemory res;
-		res.data = nullptr;
-		res.size = 0;
+		res.resetReadWriteCursor();
 
 		if (state == ChunkState::Saving)
 		{
-			res.init(sizeof(Block) * World::ChunkWidth & World::ChunkHeight * World::ChunkDepth);
-
-			res.setCursor(sizeof(uint32));
-
-			// Compressed chunk looks like this
-			// NumChunks -> ChunkSize (uint16) -> blockId (uint16) -> blockCount(uint16) -> ... ...
-			//		   -> blockId(uint16) -> blockCount(uint16)
-			//         -> chunkCoords (int32) * 2 -> chunkState (uint8)
-			uint16 lastBlockId = data[0].id;
-			uint16 lastBlockCount = 1;
-			for (uint32 i = 1; i < World::ChunkHeight * World::ChunkWidth * World::ChunkDepth; i++)
-			{
-				if (data[i].id != lastBlockId)
-				{
-					// Write to our memory
-					res.write<uint16>(&lastBlockId);
-					res.write<uint16>(&lastBlockCount);
-
-					// Set the next id
-					lastBlockId = data[i].id;
-					lastBlockCount = 0;
-				}
-				lastBlockCount++;
-			}
-			if (lastBlockCount > 0)
-			{
-				res.write<uint16>(&lastBlockId);
-				res.write<uint16>(&lastBlockCount);
-			}
-			size_t lastOffset = res.offset;
-			uint32 compressedChunkSize = (uint32)(lastOffset - sizeof(uint32));
-
-			// Write whatever the size is at the beginning of the memory block
-			res.setCursor(0);
-			res.write<uint32>(&compressedChunkSize);
-			res.setCursor(lastOffset);
-
-			res.write<int32>(&chunkCoords.x);
-			res.write<int32>(&chunkCoords.y);
-			res.shrinkToFit();
+			size_t encodedSize = ChunkCodec::encode(data, chunkCoords, res.data, res.size);
+			g_logger_assert(encodedSize > 0, "Chunk<%d, %d> did not fit in the serialization buffer.", chunkCoords.x, chunkCoords.y);
+			res.setCursor(encodedSize);
 		}
-
-		return res;
 	}
 
 	void Chunk::deserialize(RawMemory& memory)
 	{
 		memory.resetReadWriteCursor();
 
-		uint32 compressedChunkSize;
-		memory.read<uint32>(&compressedChunkSize);
-		g_memory_zeroMem(data, sizeof(Block) * World::ChunkWidth * World::ChunkDepth * World::ChunkHeight);
-
-		int blockIndex = 0;
-		while (memory.offset < compressedChunkSize + sizeof(uint32))
+		glm::ivec2 decodedCoords;
+		if (!ChunkCodec::decode(memory.data, memory.size, data, &decodedCoords))
 		{
-			uint16 blockId;
-			uint16 blockCount;
-			memory.read<uint16>(&blockId);
-			memory.read<uint16>(&blockCount);
-
-			g_logger_assert(blockIndex + blockCount <= World::ChunkWidth * World::ChunkDepth * World::ChunkHeight,
-				"Encountered bad data while deserializing chunk data.");
-			int maxBlockCount = glm::min((int)blockCount, World::ChunkWidth * World::ChunkDepth * World::ChunkHeight);
-
-			const BlockFormat& blockFormat = BlockMap::getBlock(blockId);
-			for (int blockCounter = 0; blockCounter < maxBlockCount; blockCounter++)
-			{
-				data[blockIndex].id = blockId;
-				data[blockIndex].setLightLevel(0);
-				data[blockIndex].setSkyLightLevel(0);
-				data[blockIndex].setLightColor(glm::ivec3(255, 255, 255));
-				data[blockIndex].setTransparent(blockFormat.isTransparent);
-				data[blockIndex].setIsBlendable(blockFormat.isBlendable);
-				data[blockIndex].setIsLightSource(blockFormat.isLightSource);
-				blockIndex++;
-			}
+			g_logger_error("Chunk<%d, %d> has corrupted save data, loading it as air.", chunkCoords.x, chunkCoords.y);
+			g_memory_zeroMem(data, sizeof(Block) * World::ChunkWidth * World::ChunkDepth * World::ChunkHeight);
+			return;
 		}
-		g_logger_assert(blockIndex == World::ChunkWidth * World::ChunkDepth * World::ChunkHeight,
-			"Deserialized invalid block data on client. Count was '%d', should be '%d'", blockIndex, World::ChunkWidth * World::ChunkHeight * World::ChunkDepth);
-
-		int32 chunkX, chunkZ;
-		memory.read<int32>(&chunkX);
-		memory.read<int32>(&chunkZ);
-		chunkCoords.x = chunkX;
-		chunkCoords.y = chunkZ;
+		chunkCoords = decodedCoords;
 	}
 
 	// ==================================================
@@ -151,20 +87,22 @@ namespace Minecraft
 		static const int BASE_17_WIDTH = 17;
 		static const int BASE_17_HEIGHT = 289;
 
+		static const size_t maxSerializedChunkSize = ChunkCodec::maxEncodedSize;
+
 		// Internal functions
 		static int to1DArray(int x, int y, int z);
 		static Block getBlockInternal(const Chunk* chunk, int x, int y, int z);
 		static bool setBlockInternal(Chunk* chunk, int x, int y, int z, Block newBlock);
 		static bool removeBlockInternal(Chunk* chunk, int x, int y, int z);
-		static std::string getFormattedFilepath(const glm::ivec2& chunkCoordinates, const std::string& worldSavePath);
 		static void loadBlock(Vertex* vertexData, const glm::ivec3& vert1, const glm::ivec3& vert2, const glm::ivec3& vert3, const glm::ivec3& vert4, const TextureFormat& texture, CUBE_FACE face, bool colorFaceBasedOnBiome, glm::vec<4, uint8, glm::defaultp>& lightLevels, glm::vec<4, uint8, glm::defaultp>& skyLevels, const glm::ivec3& lightColor);
-		static void calculateNextLightLevel(Chunk* originalChunk, const glm::ivec2& chunkCoordinates, robin_hood::unordered_flat_set<Chunk*>& chunksToRetesselate, std::queue<glm::ivec3>& blocksToCheck);
-		static void removeNextLightLevel(Chunk* originalChunk, const glm::ivec2& chunkCoordinates, robin_hood::unordered_flat_set<Chunk*>& chunksToRetesselate, std::queue<glm::ivec3>& blocksToCheck, std::queue<glm::ivec3>& lightSources, bool ignoreThisSolidBlock);
+		static void calculateNextLightLevel(Chunk* originalChunk, const glm::ivec2& chunkCoordinates, robin_hood::unordered_flat_set<Chunk*>& chunksToRetesselate, BlockQueue& blocksToCheck);
+		static void removeNextLightLevel(Chunk* originalChunk, const glm::ivec2& chunkCoordinates, robin_hood::unordered_flat_set<Chunk*>& chunksToRetesselate, BlockQueue& blocksToCheck, BlockQueue& lightSources, bool ignoreThisSolidBlock);
 		// TODO: Consider removing this duplication if it doesn't effect performance
-		static void calculateNextSkyLevel(Chunk* originalChunk, const glm::ivec2& chunkCoordinates, robin_hood::unordered_flat_set<Chunk*>& chunksToRetesselate, std::queue<glm::ivec3>& blocksToCheck);
-		static void removeNextSkyLevel(Chunk* originalChunk, const glm::ivec2& chunkCoordinates, robin_hood::unordered_flat_set<Chunk*>& chunksToRetesselate, std::queue<glm::ivec3>& blocksToCheck, std::queue<glm::ivec3>& lightSources, bool ignoreThisSolidBlock);
+		static void calculateNextSkyLevel(Chunk* originalChunk, const glm::ivec2& chunkCoordinates, robin_hood::unordered_flat_set<Chunk*>& chunksToRetesselate, BlockQueue& blocksToCheck);
+		static void removeNextSkyLevel(Chunk* originalChunk, const glm::ivec2& chunkCoordinates, robin_hood::unordered_flat_set<Chunk*>& chunksToRetesselate, BlockQueue& blocksToCheck, BlockQueue& lightSources, bool ignoreThisSolidBlock);
 		static void calculateChunkLighting(Chunk* chunk, const glm::ivec2& chunkCoordinates);
 		static void calculateChunkSkyBlocks(Chunk* chunk, const glm::ivec2& chunkCoordinates);
+		static void deserializeMappedChunk(const glm::ivec2& chunkCoords, RawMemory& memory, void* chunk);
 
 		void info()
 		{
@@ -268,127 +206,115 @@ namespace Minecraft
 			}
 		}
 
-		void generateDecorations(const glm::ivec2& lastPlayerLoadPosChunkCoords, float seed)
+		void generateDecorations(Chunk* chunk, uint32 seed)
 		{
-			for (int chunkZ = lastPlayerLoadPosChunkCoords.y - World::ChunkRadius; chunkZ <= lastPlayerLoadPosChunkCoords.y + World::ChunkRadius; chunkZ++)
+			if (!chunk->needsToGenerateDecorations)
 			{
-				for (int chunkX = lastPlayerLoadPosChunkCoords.x - World::ChunkRadius; chunkX <= lastPlayerLoadPosChunkCoords.x + World::ChunkRadius; chunkX++)
-				{
-					const int worldChunkX = chunkX * 16;
-					const int worldChunkZ = chunkZ * 16;
-
-					glm::ivec2 localChunkPos = glm::vec2(lastPlayerLoadPosChunkCoords.x - chunkX, lastPlayerLoadPosChunkCoords.y - chunkZ);
-					bool inRangeOfPlayer =
-						(localChunkPos.x * localChunkPos.x) + (localChunkPos.y * localChunkPos.y) <=
-						((World::ChunkRadius - 1) * (World::ChunkRadius - 1));
-					if (!inRangeOfPlayer)
-					{
-						// Skip over all chunks in range radius - 1
-						continue;
-					}
+				return;
+			}
+			chunk->needsToGenerateDecorations = false;
 
-					Chunk* chunk = ChunkManager::getChunk(glm::vec3(worldChunkX, 128.0f, worldChunkZ));
-					if (!chunk)
-					{
-						// TODO: Is this a problem...? It should only effect chunks on the edge of the border
-						// g_logger_error("Bad chunk when generating terrain. Skipping chunk.");
-						continue;
-					}
+			const int worldChunkX = chunk->chunkCoords.x * 16;
+			const int worldChunkZ = chunk->chunkCoords.y * 16;
 
-					if (!chunk->needsToGenerateDecorations)
-					{
-						continue;
-					}
-					chunk->needsToGenerateDecorations = false;
+			// This runs on the chunk workers, so every chunk gets its own generator. Seeding it from the
+			// world seed and the chunk coords also puts the trees in the same spots every time.
+			uint32 chunkSeed = seed ^
+				((uint32)chunk->chunkCoords.x * 73856093u) ^
+				((uint32)chunk->chunkCoords.y * 19349663u);
+			std::minstd_rand rng(chunkSeed);
+
+			for (int x = 0; x < World::ChunkDepth; x++)
+			{
+				for (int z = 0; z < World::ChunkWidth; z++)
+				{
+					// Generate some trees if needed
+					int num = (int)(rng() % 100);
+					bool generateTree = num > 98;
 
-					for (int x = 0; x < World::ChunkDepth; x++)
+					if (generateTree)
 					{
-						for (int z = 0; z < World::ChunkWidth; z++)
-						{
-							// Generate some trees if needed
-							int num = (rand() % 100);
-							bool generateTree = num > 98;
+						int16 y = TerrainGenerator::getHeight(x + worldChunkX, z + worldChunkZ, minBiomeHeight, maxBiomeHeight) + 1;
 
-							if (generateTree)
+						if (y > oceanLevel + 2)
+						{
+							// Generate a tree
+							int treeHeight = (int)(rng() % 3) + 3;
+							int leavesBottomY = glm::clamp(treeHeight - 3, 3, (int)World::ChunkHeight - 1);
+							int leavesTopY = treeHeight + 1;
+							if (generateTree && (y + 1 + leavesTopY < World::ChunkHeight))
 							{
-								int16 y = TerrainGenerator::getHeight(x + worldChunkX, z + worldChunkZ, minBiomeHeight, maxBiomeHeight) + 1;
+								for (int treeY = 0; treeY <= treeHeight; treeY++)
+								{
+									chunk->data[to1DArray(x, treeY + y, z)].id = 8;
+									chunk->data[to1DArray(x, treeY + y, z)].setIsBlendable(false);
+									chunk->data[to1DArray(x, treeY + y, z)].setTransparent(false);
+									chunk->data[to1DArray(x, treeY + y, z)].setIsLightSource(false);
+								}
+								chunk->markModified();
 
-								if (y > oceanLevel + 2)
+								int ringLevel = 0;
+								for (int leavesY = leavesBottomY + y; leavesY <= leavesTopY + y; leavesY++)
 								{
-									// Generate a tree
-									int treeHeight = (rand() % 3) + 3;
-									int leavesBottomY = glm::clamp(treeHeight - 3, 3, (int)World::ChunkHeight - 1);
-									int leavesTopY = treeHeight + 1;
-									if (generateTree && (y + 1 + leavesTopY < World::ChunkHeight))
+									int leafRadius = leavesY == leavesTopY ? 2 : 1;
+									for (int leavesX = x - leafRadius; leavesX <= x + leafRadius; leavesX++)
 									{
-										for (int treeY = 0; treeY <= treeHeight; treeY++)
-										{
-											chunk->data[to1DArray(x, treeY + y, z)].id = 8;
-											chunk->data[to1DArray(x, treeY + y, z)].setIsBlendable(false);
-											chunk->data[to1DArray(x, treeY + y, z)].setTransparent(false);
-											chunk->data[to1DArray(x, treeY + y, z)].setIsLightSource(false);
-										}
-
-										int ringLevel = 0;
-										for (int leavesY = leavesBottomY + y; leavesY <= leavesTopY + y; leavesY++)
+										for (int leavesZ = z - leafRadius; leavesZ <= z + leafRadius; leavesZ++)
 										{
-											int leafRadius = leavesY == leavesTopY ? 2 : 1;
-											for (int leavesX = x - leafRadius; leavesX <= x + leafRadius; leavesX++)
+											if (leavesX < World::ChunkDepth && leavesX >= 0 && leavesZ < World::ChunkWidth && leavesZ >= 0)
+											{
+												chunk->data[to1DArray(leavesX, leavesY, leavesZ)].id = 9;
+												chunk->data[to1DArray(leavesX, leavesY, leavesZ)].setIsBlendable(false);
+												chunk->data[to1DArray(leavesX, leavesY, leavesZ)].setTransparent(true);
+												chunk->data[to1DArray(leavesX, leavesY, leavesZ)].setIsLightSource(false);
+											}
+											else if (leavesX < 0)
+											{
+												if (chunk->bottomNeighbor)
+												{
+													chunk->bottomNeighbor->data[to1DArray(World::ChunkDepth + leavesX, leavesY, leavesZ)].id = 9;
+													chunk->bottomNeighbor->markModified();
+													chunk->data[to1DArray(World::ChunkDepth + leavesX, leavesY, leavesZ)].setIsBlendable(false);
+													chunk->data[to1DArray(World::ChunkDepth + leavesX, leavesY, leavesZ)].setTransparent(true);
+													chunk->data[to1DArray(World::ChunkDepth + leavesX, leavesY, leavesZ)].setIsLightSource(false);
+												}
+											}
+											else if (leavesX >= World::ChunkDepth)
+											{
+												if (chunk->topNeighbor)
+												{
+													chunk->topNeighbor->data[to1DArray(leavesX - World::ChunkDepth, leavesY, leavesZ)].id = 9;
+													chunk->topNeighbor->markModified();
+													chunk->data[to1DArray(leavesX - World::ChunkDepth, leavesY, leavesZ)].setIsBlendable(false);
+													chunk->data[to1DArray(leavesX - World::ChunkDepth, leavesY, leavesZ)].setTransparent(true);
+													chunk->data[to1DArray(leavesX - World::ChunkDepth, leavesY, leavesZ)].setIsLightSource(false);
+												}
+											}
+											else if (leavesZ < 0)
+											{
+												if (chunk->leftNeighbor)
+												{
+													chunk->leftNeighbor->data[to1DArray(leavesX, leavesY, World::ChunkWidth + leavesZ)].id = 9;
+													chunk->leftNeighbor->markModified();
+													chunk->data[to1DArray(leavesX, leavesY, World::ChunkWidth + leavesZ)].setIsBlendable(false);
+													chunk->data[to1DArray(leavesX, leavesY, World::ChunkWidth + leavesZ)].setTransparent(true);
+													chunk->data[to1DArray(leavesX, leavesY, World::ChunkWidth + leavesZ)].setIsLightSource(false);
+												}
+											}
+											else if (leavesZ >= World::ChunkWidth)
 											{
-												for (int leavesZ = z - leafRadius; leavesZ <= z + leafRadius; leavesZ++)
+												if (chunk->rightNeighbor)
 												{
-													if (leavesX < World::ChunkDepth && leavesX >= 0 && leavesZ < World::ChunkWidth && leavesZ >= 0)
-													{
-														chunk->data[to1DArray(leavesX, leavesY, leavesZ)].id = 9;
-														chunk->data[to1DArray(leavesX, leavesY, leavesZ)].setIsBlendable(false);
-														chunk->data[to1DArray(leavesX, leavesY, leavesZ)].setTransparent(true);
-														chunk->data[to1DArray(leavesX, leavesY, leavesZ)].setIsLightSource(false);
-													}
-													else if (leavesX < 0)
-													{
-														if (chunk->bottomNeighbor)
-														{
-															chunk->bottomNeighbor->data[to1DArray(World::ChunkDepth + leavesX, leavesY, leavesZ)].id = 9;
-															chunk->data[to1DArray(World::ChunkDepth + leavesX, leavesY, leavesZ)].setIsBlendable(false);
-															chunk->data[to1DArray(World::ChunkDepth + leavesX, leavesY, leavesZ)].setTransparent(true);
-															chunk->data[to1DArray(World::ChunkDepth + leavesX, leavesY, leavesZ)].setIsLightSource(false);
-														}
-													}
-													else if (leavesX >= World::ChunkDepth)
-													{
-														if (chunk->topNeighbor)
-														{
-															chunk->topNeighbor->data[to1DArray(leavesX - World::ChunkDepth, leavesY, leavesZ)].id = 9;
-															chunk->data[to1DArray(leavesX - World::ChunkDepth, leavesY, leavesZ)].setIsBlendable(false);
-															chunk->data[to1DArray(leavesX - World::ChunkDepth, leavesY, leavesZ)].setTransparent(true);
-															chunk->data[to1DArray(leavesX - World::ChunkDepth, leavesY, leavesZ)].setIsLightSource(false);
-														}
-													}
-													else if (leavesZ < 0)
-													{
-														if (chunk->leftNeighbor)
-														{
-															chunk->leftNeighbor->data[to1DArray(leavesX, leavesY, World::ChunkWidth + leavesZ)].id = 9;
-															chunk->data[to1DArray(leavesX, leavesY, World::ChunkWidth + leavesZ)].setIsBlendable(false);
-															chunk->data[to1DArray(leavesX, leavesY, World::ChunkWidth + leavesZ)].setTransparent(true);
-															chunk->data[to1DArray(leavesX, leavesY, World::ChunkWidth + leavesZ)].setIsLightSource(false);
-														}
-													}
-													else if (leavesZ >= World::ChunkWidth)
-													{
-														if (chunk->rightNeighbor)
-														{
-															chunk->rightNeighbor->data[to1DArray(leavesX, leavesY, leavesZ - World::ChunkWidth)].id = 9;
-															chunk->data[to1DArray(leavesX, leavesY, leavesZ - World::ChunkWidth)].setIsBlendable(false);
-															chunk->data[to1DArray(leavesX, leavesY, leavesZ - World::ChunkWidth)].setTransparent(true);
-															chunk->data[to1DArray(leavesX, leavesY, leavesZ - World::ChunkWidth)].setIsLightSource(false);
-														}
-													}
+													chunk->rightNeighbor->data[to1DArray(leavesX, leavesY, leavesZ - World::ChunkWidth)].id = 9;
+													chunk->rightNeighbor->markModified();
+													chunk->data[to1DArray(leavesX, leavesY, leavesZ - World::ChunkWidth)].setIsBlendable(false);
+													chunk->data[to1DArray(leavesX, leavesY, leavesZ - World::ChunkWidth)].setTransparent(true);
+													chunk->data[to1DArray(leavesX, leavesY, leavesZ - World::ChunkWidth)].setIsLightSource(false);
 												}
 											}
-											ringLevel++;
 										}
 									}
+									ringLevel++;
 								}
 							}
 						}
@@ -397,54 +323,27 @@ namespace Minecraft
 			}
 		}
 
-		void calculateLighting(const glm::ivec2& lastPlayerLoadPosChunkCoords)
+		void calculateSkyLighting(Chunk* chunk)
 		{
-			for (int i = 0; i < 2; i++)
+			if (!chunk->needsToCalculateLighting)
 			{
-				for (int chunkZ = lastPlayerLoadPosChunkCoords.y - World::ChunkRadius; chunkZ <= lastPlayerLoadPosChunkCoords.y + World::ChunkRadius; chunkZ++)
-				{
-					for (int chunkX = lastPlayerLoadPosChunkCoords.x - World::ChunkRadius; chunkX <= lastPlayerLoadPosChunkCoords.x + World::ChunkRadius; chunkX++)
-					{
-						const int worldChunkX = chunkX * 16;
-						const int worldChunkZ = chunkZ * 16;
-
-						glm::ivec2 localChunkPos = glm::vec2(lastPlayerLoadPosChunkCoords.x - chunkX, lastPlayerLoadPosChunkCoords.y - chunkZ);
-						bool inRangeOfPlayer =
-							(localChunkPos.x * localChunkPos.x) + (localChunkPos.y * localChunkPos.y) <=
-							((World::ChunkRadius) * (World::ChunkRadius));
-						if (!inRangeOfPlayer)
-						{
-							// Skip over all chunks in range radius - 1
-							continue;
-						}
-
-						Chunk* chunk = ChunkManager::getChunk(glm::vec3(worldChunkX, 128.0f, worldChunkZ));
-						if (!chunk)
-						{
-							// TODO: Is this a problem...? It should only effect chunks on the edge of the border
-							// g_logger_error("Bad chunk when generating terrain. Skipping chunk.");
-							continue;
-						}
+				return;
+			}
 
-						if (!chunk->needsToCalculateLighting)
-						{
-							continue;
-						}
+			// Sky light levels have to be set for every chunk before any light is propagated
+			calculateChunkSkyBlocks(chunk, chunk->chunkCoords);
+		}
 
-						if (i == 0)
-						{
-							// First iteration calculate all sky light levels
-							calculateChunkSkyBlocks(chunk, glm::ivec2(chunkX, chunkZ));
-						}
-						else if (i == 1)
-						{
-							// Second iteration calculate all sky "sources" and light sources
-							calculateChunkLighting(chunk, glm::ivec2(chunkX, chunkZ));
-							chunk->needsToCalculateLighting = false;
-						}
-					}
-				}
+		void calculateLighting(Chunk* chunk)
+		{
+			if (!chunk->needsToCalculateLighting)
+			{
+				return;
 			}
+
+			// Calculate all sky "sources" and light sources
+			calculateChunkLighting(chunk, chunk->chunkCoords);
+			chunk->needsToCalculateLighting = false;
 		}
 
 		static void calculateChunkSkyBlocks(Chunk* chunk, const glm::ivec2& chunkCoordinates)
@@ -472,8 +371,10 @@ namespace Minecraft
 
 		static void calculateChunkLighting(Chunk* chunk, const glm::ivec2& chunkCoordinates)
 		{
+			ArenaScope arenaScope;
+
 			// Propagate any sky blocks that are acting like "sources"
-			std::queue<glm::ivec3> skyBlocksToUpdate = {};
+			BlockQueue skyBlocksToUpdate;
 			for (int y = World::ChunkHeight - 1; y >= 0; y--)
 			{
 				bool anyBlocksTransparent = false;
@@ -511,14 +412,17 @@ namespace Minecraft
 					break;
 				}
 			}
-			robin_hood::unordered_flat_set<Chunk*> skyChunksToRetesselate = {};
+			// Nothing needs retesselating yet while the chunk is still being loaded. The set is kept
+			// per thread since clearing it holds on to its memory for the next chunk.
+			static thread_local robin_hood::unordered_flat_set<Chunk*> chunksToRetesselate;
+			chunksToRetesselate.clear();
 			while (!skyBlocksToUpdate.empty())
 			{
-				calculateNextSkyLevel(chunk, chunkCoordinates, skyChunksToRetesselate, skyBlocksToUpdate);
+				calculateNextSkyLevel(chunk, chunkCoordinates, chunksToRetesselate, skyBlocksToUpdate);
 			}
 
 			// Then calculate all light sources
-			std::queue<glm::ivec3> blocksToUpdate = {};
+			BlockQueue blocksToUpdate;
 			for (int y = 0; y < World::ChunkHeight; y++)
 			{
 				for (int x = 0; x < World::ChunkDepth; x++)
@@ -536,7 +440,6 @@ namespace Minecraft
 				}
 			}
 
-			robin_hood::unordered_flat_set<Chunk*> chunksToRetesselate = {};
 			while (!blocksToUpdate.empty())
 			{
 				calculateNextLightLevel(chunk, chunkCoordinates, chunksToRetesselate, blocksToUpdate);
@@ -545,6 +448,8 @@ namespace Minecraft
 
 		void calculateLightingUpdate(Chunk* chunk, const glm::ivec2& chunkCoordinates, const glm::vec3& blockPosition, bool removedLightSource, robin_hood::unordered_flat_set<Chunk*>& chunksToRetesselate)
 		{
+			ArenaScope arenaScope;
+
 			glm::ivec3 localPosition = glm::floor(blockPosition - glm::vec3(chunkCoordinates.x * 16.0f, 0.0f, chunkCoordinates.y * 16.0f));
 			int localX = localPosition.x;
 			int localY = localPosition.y;
@@ -553,8 +458,8 @@ namespace Minecraft
 			if (!blockThatsUpdating.isTransparent() && !blockThatsUpdating.isLightSource() && !removedLightSource)
 			{
 				// Just placed a solid block
-				std::queue<glm::ivec3> blocksToZero = {};
-				std::queue<glm::ivec3> blocksToUpdate = {};
+				BlockQueue blocksToZero;
+				BlockQueue blocksToUpdate;
 				blocksToZero.push({ localX, localY, localZ });
 				bool ignoreThisSolidBlock = true;
 				// Zero out
@@ -588,8 +493,8 @@ namespace Minecraft
 			else if (removedLightSource)
 			{
 				// Just removed a light source
-				std::queue<glm::ivec3> blocksToZero = {};
-				std::queue<glm::ivec3> blocksToUpdate = {};
+				BlockQueue blocksToZero;
+				BlockQueue blocksToUpdate;
 				blocksToZero.push({ localX, localY, localZ });
 				// Zero out
 				while (!blocksToZero.empty())
@@ -606,7 +511,7 @@ namespace Minecraft
 			else if (blockThatsUpdating.isLightSource())
 			{
 				// Just added a light source
-				std::queue<glm::ivec3> blocksToUpdate = {};
+				BlockQueue blocksToUpdate;
 				blocksToUpdate.push({ localX, localY, localZ });
 				int arrayExpansion = to1DArray(localX, localY, localZ);
 				chunk->data[arrayExpansion].setLightLevel(BlockMap::getBlock(chunk->data[arrayExpansion].id).lightLevel);
@@ -618,7 +523,7 @@ namespace Minecraft
 			else
 			{
 				// Just removed a block
-				std::queue<glm::ivec3> blocksToUpdate = {};
+				BlockQueue blocksToUpdate;
 				blocksToUpdate.push({ localX, localY, localZ });
 				int arrayExpansion = to1DArray(localX, localY, localZ);
 
@@ -1009,17 +914,16 @@ namespace Minecraft
 		{
 			if ((Network::isNetworkEnabled() && Network::isLanServer()) || (!Network::isNetworkEnabled()))
 			{
-				std::string filepath = getFormattedFilepath(chunk.chunkCoords, pathToSaveTo);
-				FILE* fp = fopen(filepath.c_str(), "wb");
-				if (!fp)
+				ArenaScope arenaScope;
+				RawMemory chunkData;
+				chunkData.size = maxSerializedChunkSize;
+				chunkData.data = Arena::threadLocal().allocate<uint8>(chunkData.size);
+				chunkData.offset = 0;
+				chunk.serialize(chunkData);
+				if (!RegionFile::writeChunk(pathToSaveTo, chunk.chunkCoords, chunkData.data, chunkData.offset))
 				{
-					g_logger_error("Failed to serialize chunk<%d, %d>");
-					return;
+					g_logger_error("Failed to serialize chunk<%d, %d>", chunk.chunkCoords.x, chunk.chunkCoords.y);
 				}
-				RawMemory chunkData = chunk.serialize();
-				fwrite(chunkData.data, chunkData.size, 1, fp);
-				chunkData.free();
-				fclose(fp);
 			}
 			else
 			{
@@ -1031,28 +935,11 @@ namespace Minecraft
 		{
 			if (!Network::isNetworkEnabled())
 			{
-				std::string filepath = getFormattedFilepath(chunk.chunkCoords, worldSavePath);
-				FILE* fp = fopen(filepath.c_str(), "rb");
-				if (!fp)
+				// Decode straight out of the region file mapping
+				if (!RegionFile::readChunk(worldSavePath, chunk.chunkCoords, deserializeMappedChunk, &chunk))
 				{
-					g_logger_error("Could not open file '%s'", filepath.c_str());
-					return;
+					g_logger_error("Could not read chunk<%d, %d> from its region file.", chunk.chunkCoords.x, chunk.chunkCoords.y);
 				}
-
-				// Get file size
-				fseek(fp, 0L, SEEK_END);
-				size_t fileSize = ftell(fp);
-				rewind(fp);
-
-				// Read file into raw memory and deserialize
-				RawMemory memory;
-				memory.init(fileSize);
-				fread(memory.data, memory.size, 1, fp);
-				chunk.deserialize(memory);
-				memory.free();
-
-				// Close file
-				fclose(fp);
 			}
 			else
 			{
@@ -1062,8 +949,7 @@ namespace Minecraft
 
 		bool exists(const std::string& worldSavePath, const glm::ivec2& chunkCoordinates)
 		{
-			std::string filepath = getFormattedFilepath(chunkCoordinates, worldSavePath);
-			return File::isFile(filepath.c_str());
+			return RegionFile::chunkExists(worldSavePath, chunkCoordinates);
 		}
 
 		// =====================================================
@@ -1147,6 +1033,7 @@ namespace Minecraft
 			chunk->data[index].id = newBlock.id;
 			chunk->data[index].setTransparent(blockFormat.isTransparent);
 			chunk->data[index].setIsLightSource(blockFormat.isLightSource);
+			chunk->markModified();
 
 			return true;
 		}
@@ -1188,6 +1075,7 @@ namespace Minecraft
 			chunk->data[index].setLightColor(glm::ivec3(255, 255, 255));
 			chunk->data[index].setTransparent(true);
 			chunk->data[index].setIsLightSource(false);
+			chunk->markModified();
 
 			return true;
 		}
@@ -1240,7 +1128,7 @@ namespace Minecraft
 			return true;
 		}
 
-		static void calculateNextLightLevel(Chunk* originalChunk, const glm::ivec2& chunkCoordinates, robin_hood::unordered_flat_set<Chunk*>& chunksToRetesselate, std::queue<glm::ivec3>& blocksToCheck)
+		static void calculateNextLightLevel(Chunk* originalChunk, const glm::ivec2& chunkCoordinates, robin_hood::unordered_flat_set<Chunk*>& chunksToRetesselate, BlockQueue& blocksToCheck)
 		{
 			glm::ivec3 blockToUpdate = blocksToCheck.front();
 			blocksToCheck.pop();
@@ -1298,7 +1186,7 @@ namespace Minecraft
 			}
 		}
 
-		static void removeNextLightLevel(Chunk* originalChunk, const glm::ivec2& chunkCoordinates, robin_hood::unordered_flat_set<Chunk*>& chunksToRetesselate, std::queue<glm::ivec3>& blocksToCheck, std::queue<glm::ivec3>& lightSources, bool ignoreThisSolidBlock)
+		static void removeNextLightLevel(Chunk* originalChunk, const glm::ivec2& chunkCoordinates, robin_hood::unordered_flat_set<Chunk*>& chunksToRetesselate, BlockQueue& blocksToCheck, BlockQueue& lightSources, bool ignoreThisSolidBlock)
 		{
 			glm::ivec3 blockToUpdate = blocksToCheck.front();
 			blocksToCheck.pop();
@@ -1365,7 +1253,7 @@ namespace Minecraft
 		}
 
 		// TODO: Think about removing this duplication if it doesn't effect performance
-		static void calculateNextSkyLevel(Chunk* originalChunk, const glm::ivec2& chunkCoordinates, robin_hood::unordered_flat_set<Chunk*>& chunksToRetesselate, std::queue<glm::ivec3>& blocksToCheck)
+		static void calculateNextSkyLevel(Chunk* originalChunk, const glm::ivec2& chunkCoordinates, robin_hood::unordered_flat_set<Chunk*>& chunksToRetesselate, BlockQueue& blocksToCheck)
 		{
 			glm::ivec3 blockToUpdate = blocksToCheck.front();
 			blocksToCheck.pop();
@@ -1422,7 +1310,7 @@ namespace Minecraft
 			}
 		}
 
-		static void removeNextSkyLevel(Chunk* originalChunk, const glm::ivec2& chunkCoordinates, robin_hood::unordered_flat_set<Chunk*>& chunksToRetesselate, std::queue<glm::ivec3>& blocksToCheck, std::queue<glm::ivec3>& lightSources, bool ignoreThisSolidBlock)
+		static void removeNextSkyLevel(Chunk* originalChunk, const glm::ivec2& chunkCoordinates, robin_hood::unordered_flat_set<Chunk*>& chunksToRetesselate, BlockQueue& blocksToCheck, BlockQueue& lightSources, bool ignoreThisSolidBlock)
 		{
 			glm::ivec3 blockToUpdate = blocksToCheck.front();
 			blocksToCheck.pop();
@@ -1487,9 +1375,9 @@ namespace Minecraft
 			}
 		}
 
-		static std::string getFormattedFilepath(const glm::ivec2& chunkCoordinates, const std::string& worldSavePath)
+		static void deserializeMappedChunk(const glm::ivec2& chunkCoords, RawMemory& memory, void* chunk)
 		{
-			return worldSavePath + "/" + std::to_string(chunkCoordinates.x) + "_" + std::to_string(chunkCoordinates.y) + ".bin";
+			((Chunk*)chunk)->deserialize(memory);
 		}
 
 		static int toCompressedVec3(int x, int y, int z)
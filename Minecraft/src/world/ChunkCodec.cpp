@@ -0,0 +1,497 @@
+#include "world/ChunkCodec.h"
+#include "world/BlockMap.h"
+#include "core/Arena.hpp"
+
+#if defined(_M_X64) || defined(__SSE2__)
+#define MINECRAFT_CODEC_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace Minecraft
+{
+	namespace ChunkCodec
+	{
+		// Chunk layout
+		// Header:  magic (uint8) -> version (uint8) -> chunkX (int32) -> chunkZ (int32)
+		// Section: bitsPerBlock (uint8), one per section from the bottom of the chunk up
+		//   0:     blockId (uint16), the whole section is one block
+		//   1-8:   paletteSize (uint16) -> blockId (uint16) * paletteSize -> packed indices (uint64) * numWords
+		//   16:    blockId (uint16) * BlocksPerSection
+		//
+		// Old saves start with the size of their run length data (uint32), which is always a multiple
+		// of 4. The magic byte has its low bits set so the two can never be confused.
+		static const uint8 Magic = 0xCB;
+		static const uint8 DirectBits = 16;
+		static const uint16 UnusedPaletteIndex = UINT16_MAX;
+		static const int BlocksPerChunk = World::ChunkWidth * World::ChunkDepth * World::ChunkHeight;
+		// Eight bits per block is the most a palette ever needs
+		static const int MaxPackedWords = BlocksPerSection / (64 / 8);
+
+		struct ByteWriter
+		{
+			uint8* data;
+			size_t size;
+			size_t offset;
+			bool overflowed;
+
+			template<typename T>
+			void write(const T& value)
+			{
+				if (offset + sizeof(T) > size)
+				{
+					overflowed = true;
+					return;
+				}
+				g_memory_copyMem(data + offset, (void*)&value, sizeof(T));
+				offset += sizeof(T);
+			}
+		};
+
+		struct ByteReader
+		{
+			const uint8* data;
+			size_t size;
+			size_t offset;
+
+			template<typename T>
+			bool read(T* value)
+			{
+				if (offset + sizeof(T) > size)
+				{
+					return false;
+				}
+				g_memory_copyMem(value, (void*)(data + offset), sizeof(T));
+				offset += sizeof(T);
+				return true;
+			}
+		};
+
+		// Internal functions
+		static void encodeSection(const Block* sectionBlocks, uint16* paletteLookup, ByteWriter& writer);
+		static bool decodeSection(ByteReader& reader, Block* sectionBlocks);
+		static bool decodeLegacy(ByteReader& reader, Block* blocks, glm::ivec2* chunkCoords);
+		static void fillIndices(uint64* words, int start, int end, uint64 paletteIndex, uint8 bitsPerBlock, uint64 ones);
+		static uint64 repeatedOnes(uint8 bitsPerBlock);
+		static uint8 bitsNeeded(uint32 paletteSize);
+		static Block toBlock(uint16 blockId);
+
+		size_t encode(const Block* blocks, const glm::ivec2& chunkCoords, uint8* dst, size_t dstSize)
+		{
+			ByteWriter writer = { dst, dstSize, 0, false };
+			writer.write<uint8>(Magic);
+			writer.write<uint8>(CurrentVersion);
+			writer.write<int32>(chunkCoords.x);
+			writer.write<int32>(chunkCoords.y);
+
+			// Maps a block id to its index in the current section's palette
+			ArenaScope arenaScope;
+			uint16* paletteLookup = Arena::threadLocal().allocate<uint16>(UINT16_MAX + 1);
+			std::fill(paletteLookup, paletteLookup + UINT16_MAX + 1, UnusedPaletteIndex);
+
+			for (int section = 0; section < NumSections; section++)
+			{
+				encodeSection(blocks + section * BlocksPerSection, paletteLookup, writer);
+			}
+
+			return writer.overflowed ? 0 : writer.offset;
+		}
+
+		bool decode(const uint8* data, size_t dataSize, Block* blocks, glm::ivec2* chunkCoords)
+		{
+			ByteReader reader = { data, dataSize, 0 };
+			if (dataSize == 0)
+			{
+				return false;
+			}
+
+			if ((data[0] & 0x3) == 0)
+			{
+				return decodeLegacy(reader, blocks, chunkCoords);
+			}
+
+			uint8 magic, version;
+			int32 chunkX, chunkZ;
+			if (!reader.read<uint8>(&magic) || !reader.read<uint8>(&version) || magic != Magic)
+			{
+				return false;
+			}
+
+			if (version != CurrentVersion)
+			{
+				g_logger_error("Cannot decode chunk with unknown format version '%d'.", version);
+				return false;
+			}
+
+			if (!reader.read<int32>(&chunkX) || !reader.read<int32>(&chunkZ))
+			{
+				return false;
+			}
+
+			for (int section = 0; section < NumSections; section++)
+			{
+				if (!decodeSection(reader, blocks + section * BlocksPerSection))
+				{
+					return false;
+				}
+			}
+
+			chunkCoords->x = chunkX;
+			chunkCoords->y = chunkZ;
+			return true;
+		}
+
+		bool peekChunkCoords(const uint8* data, size_t dataSize, glm::ivec2* chunkCoords)
+		{
+			ByteReader reader = { data, dataSize, 0 };
+			if (dataSize == 0)
+			{
+				return false;
+			}
+
+			int32 chunkX, chunkZ;
+			if ((data[0] & 0x3) == 0)
+			{
+				// Old saves keep the coordinates after the run length data
+				uint32 runLengthSize;
+				if (!reader.read<uint32>(&runLengthSize) || runLengthSize > reader.size - reader.offset)
+				{
+					return false;
+				}
+				reader.offset += runLengthSize;
+			}
+			else
+			{
+				uint8 magic, version;
+				if (!reader.read<uint8>(&magic) || !reader.read<uint8>(&version) || magic != Magic || version != CurrentVersion)
+				{
+					return false;
+				}
+			}
+
+			if (!reader.read<int32>(&chunkX) || !reader.read<int32>(&chunkZ))
+			{
+				return false;
+			}
+
+			chunkCoords->x = chunkX;
+			chunkCoords->y = chunkZ;
+			return true;
+		}
+
+		uint64 contentVersion(const uint8* data, size_t dataSize)
+		{
+			// FNV-1a
+			uint64 hash = 14695981039346656037ull;
+			for (size_t i = 0; i < dataSize; i++)
+			{
+				hash = (hash ^ data[i]) * 1099511628211ull;
+			}
+			return hash;
+		}
+
+		int findRunEnd(const Block* blocks, int start, int end)
+		{
+#ifdef MINECRAFT_CODEC_SSE2
+			uint16 blockId = blocks[start].id;
+			int i = start + 1;
+			// Blocks are 8 bytes so a register holds two of them. Four blocks get compared per loop,
+			// only the id in the first two bytes of each one counts since the lighting can differ.
+			static_assert(sizeof(Block) == 8 && offsetof(Block, id) == 0, "The run detector expects the id at the start of an 8 byte block.");
+			const __m128i ids = _mm_set1_epi16((int16)blockId);
+			const int idBytes = 0x03030303;
+			for (; i + 4 <= end; i += 4)
+			{
+				__m128i firstPair = _mm_loadu_si128((const __m128i*)(blocks + i));
+				__m128i secondPair = _mm_loadu_si128((const __m128i*)(blocks + i + 2));
+				int matches = (_mm_movemask_epi8(_mm_cmpeq_epi16(firstPair, ids)) & 0x0303) |
+					((_mm_movemask_epi8(_mm_cmpeq_epi16(secondPair, ids)) & 0x0303) << 16);
+				if (matches != idBytes)
+				{
+					// Every block owns 8 bits of the mask
+					return i + glm::findLSB(~matches & idBytes) / 8;
+				}
+			}
+
+			// Block i - 1 is still part of the run, the rest is shorter than a register
+			return findRunEndScalar(blocks, i - 1, end);
+#else
+			return findRunEndScalar(blocks, start, end);
+#endif
+		}
+
+		int findRunEndScalar(const Block* blocks, int start, int end)
+		{
+			uint16 blockId = blocks[start].id;
+			for (int i = start + 1; i < end; i++)
+			{
+				if (blocks[i].id != blockId)
+				{
+					return i;
+				}
+			}
+			return end;
+		}
+
+		// =====================================================
+		// Internal functions
+		// =====================================================
+		static void encodeSection(const Block* sectionBlocks, uint16* paletteLookup, ByteWriter& writer)
+		{
+			uint16 palette[MaxPaletteSize];
+			uint32 paletteSize = 0;
+			bool paletteOverflowed = false;
+			// Terrain is mostly long runs of the same block, so only the first block of every run
+			// needs a palette lookup
+			for (int runStart = 0, runEnd = 0; runStart < BlocksPerSection; runStart = runEnd)
+			{
+				runEnd = findRunEnd(sectionBlocks, runStart, BlocksPerSection);
+				uint16 blockId = sectionBlocks[runStart].id;
+				if (paletteLookup[blockId] != UnusedPaletteIndex)
+				{
+					continue;
+				}
+
+				if (paletteSize == MaxPaletteSize)
+				{
+					paletteOverflowed = true;
+					break;
+				}
+
+				paletteLookup[blockId] = (uint16)paletteSize;
+				palette[paletteSize] = blockId;
+				paletteSize++;
+			}
+
+			if (paletteOverflowed)
+			{
+				writer.write<uint8>(DirectBits);
+				for (int i = 0; i < BlocksPerSection; i++)
+				{
+					writer.write<uint16>(sectionBlocks[i].id);
+				}
+			}
+			else if (paletteSize == 1)
+			{
+				writer.write<uint8>(0);
+				writer.write<uint16>(palette[0]);
+			}
+			else
+			{
+				uint8 bitsPerBlock = bitsNeeded(paletteSize);
+				writer.write<uint8>(bitsPerBlock);
+				writer.write<uint16>((uint16)paletteSize);
+				for (uint32 i = 0; i < paletteSize; i++)
+				{
+					writer.write<uint16>(palette[i]);
+				}
+
+				// Indices never straddle two words, so decoding a block is one shift and mask
+				int indicesPerWord = 64 / bitsPerBlock;
+				int numWords = (BlocksPerSection + indicesPerWord - 1) / indicesPerWord;
+				uint64 words[MaxPackedWords] = {};
+				uint64 ones = repeatedOnes(bitsPerBlock);
+				for (int runStart = 0, runEnd = 0; runStart < BlocksPerSection; runStart = runEnd)
+				{
+					runEnd = findRunEnd(sectionBlocks, runStart, BlocksPerSection);
+					fillIndices(words, runStart, runEnd, paletteLookup[sectionBlocks[runStart].id], bitsPerBlock, ones);
+				}
+
+				for (int i = 0; i < numWords; i++)
+				{
+					writer.write<uint64>(words[i]);
+				}
+			}
+
+			// Only reset what we touched so the next section starts with an empty lookup
+			for (uint32 i = 0; i < paletteSize; i++)
+			{
+				paletteLookup[palette[i]] = UnusedPaletteIndex;
+			}
+		}
+
+		static bool decodeSection(ByteReader& reader, Block* sectionBlocks)
+		{
+			uint8 bitsPerBlock;
+			if (!reader.read<uint8>(&bitsPerBlock))
+			{
+				return false;
+			}
+
+			if (bitsPerBlock == 0)
+			{
+				uint16 blockId;
+				if (!reader.read<uint16>(&blockId))
+				{
+					return false;
+				}
+
+				std::fill(sectionBlocks, sectionBlocks + BlocksPerSection, toBlock(blockId));
+				return true;
+			}
+
+			if (bitsPerBlock == DirectBits)
+			{
+				for (int i = 0; i < BlocksPerSection; i++)
+				{
+					uint16 blockId;
+					if (!reader.read<uint16>(&blockId))
+					{
+						return false;
+					}
+					sectionBlocks[i] = toBlock(blockId);
+				}
+				return true;
+			}
+
+			uint16 paletteSize;
+			if (bitsPerBlock > 8 || !reader.read<uint16>(&paletteSize) || paletteSize == 0 || paletteSize > (1u << bitsPerBlock))
+			{
+				return false;
+			}
+
+			Block palette[MaxPaletteSize];
+			for (uint16 i = 0; i < paletteSize; i++)
+			{
+				uint16 blockId;
+				if (!reader.read<uint16>(&blockId))
+				{
+					return false;
+				}
+				palette[i] = toBlock(blockId);
+			}
+
+			int indicesPerWord = 64 / bitsPerBlock;
+			uint64 mask = (1ull << bitsPerBlock) - 1;
+			uint64 ones = repeatedOnes(bitsPerBlock);
+			for (int wordStart = 0; wordStart < BlocksPerSection; wordStart += indicesPerWord)
+			{
+				uint64 word;
+				if (!reader.read<uint64>(&word))
+				{
+					return false;
+				}
+
+				int wordEnd = glm::min(wordStart + indicesPerWord, BlocksPerSection);
+				uint64 firstIndex = word & mask;
+				if (word == firstIndex * ones && firstIndex < paletteSize)
+				{
+					// Every index in the word is the same, which is most of them
+					std::fill(sectionBlocks + wordStart, sectionBlocks + wordEnd, palette[firstIndex]);
+					continue;
+				}
+
+				for (int i = wordStart; i < wordEnd; i++)
+				{
+					uint64 paletteIndex = (word >> ((i - wordStart) * bitsPerBlock)) & mask;
+					if (paletteIndex >= paletteSize)
+					{
+						return false;
+					}
+					sectionBlocks[i] = palette[paletteIndex];
+				}
+			}
+
+			return true;
+		}
+
+		static bool decodeLegacy(ByteReader& reader, Block* blocks, glm::ivec2* chunkCoords)
+		{
+			// Old format: runLengthSize (uint32) -> (blockId (uint16) -> blockCount (uint16)) * n -> chunkX (int32) -> chunkZ (int32)
+			uint32 runLengthSize;
+			if (!reader.read<uint32>(&runLengthSize) || runLengthSize > reader.size - reader.offset)
+			{
+				return false;
+			}
+
+			size_t runLengthEnd = reader.offset + runLengthSize;
+			int blockIndex = 0;
+			while (reader.offset < runLengthEnd)
+			{
+				uint16 blockId;
+				uint16 blockCount;
+				if (!reader.read<uint16>(&blockId) || !reader.read<uint16>(&blockCount) ||
+					blockIndex + blockCount > BlocksPerChunk)
+				{
+					return false;
+				}
+
+				std::fill(blocks + blockIndex, blocks + blockIndex + blockCount, toBlock(blockId));
+				blockIndex += blockCount;
+			}
+
+			int32 chunkX, chunkZ;
+			if (blockIndex != BlocksPerChunk || !reader.read<int32>(&chunkX) || !reader.read<int32>(&chunkZ))
+			{
+				return false;
+			}
+
+			chunkCoords->x = chunkX;
+			chunkCoords->y = chunkZ;
+			return true;
+		}
+
+		static void fillIndices(uint64* words, int start, int end, uint64 paletteIndex, uint8 bitsPerBlock, uint64 ones)
+		{
+			// The words start out zeroed, so index 0 is already there
+			if (paletteIndex == 0)
+			{
+				return;
+			}
+
+			int indicesPerWord = 64 / bitsPerBlock;
+			int i = start;
+			for (; i < end && i % indicesPerWord != 0; i++)
+			{
+				words[i / indicesPerWord] |= paletteIndex << ((i % indicesPerWord) * bitsPerBlock);
+			}
+
+			// Words the run covers completely get written in one go
+			uint64 fullWord = paletteIndex * ones;
+			for (; i + indicesPerWord <= end; i += indicesPerWord)
+			{
+				words[i / indicesPerWord] = fullWord;
+			}
+
+			for (; i < end; i++)
+			{
+				words[i / indicesPerWord] |= paletteIndex << ((i % indicesPerWord) * bitsPerBlock);
+			}
+		}
+
+		static uint64 repeatedOnes(uint8 bitsPerBlock)
+		{
+			// A 1 in every index slot, times an index it fills a whole word with that index
+			uint64 ones = 0;
+			for (int shift = 0; shift + bitsPerBlock <= 64; shift += bitsPerBlock)
+			{
+				ones |= 1ull << shift;
+			}
+			return ones;
+		}
+
+		static uint8 bitsNeeded(uint32 paletteSize)
+		{
+			uint8 bits = 1;
+			while ((1u << bits) < paletteSize)
+			{
+				bits++;
+			}
+			return bits;
+		}
+
+		static Block toBlock(uint16 blockId)
+		{
+			const BlockFormat& blockFormat = BlockMap::getBlock(blockId);
+			Block block;
+			g_memory_zeroMem(&block, sizeof(Block));
+			block.id = blockId;
+			block.setLightLevel(0);
+			block.setSkyLightLevel(0);
+			block.setLightColor(glm::ivec3(255, 255, 255));
+			block.setTransparent(blockFormat.isTransparent);
+			block.setIsBlendable(blockFormat.isBlendable);
+			block.setIsLightSource(blockFormat.isLightSource);
+			return block;
+		}
+	}
+}
@@ -8,262 +8,86 @@
 #include "utils/DebugStats.h"
 #include "utils/CMath.h"
 #include "utils/Constants.h"
-#include "renderer/Shader.h"
-#include "renderer/Renderer.h"
-#include "renderer/Frustum.h"
-#include "renderer/Framebuffer.h"
-#include "renderer/Texture.h"
+#include "renderer/ChunkRenderer.h"
 #include "core/Application.h"
+#include "core/GlobalThreadPool.h"
 #include "network/Network.h"
 #include "world/ChunkThreadWorker.h"
+#include "world/ChunkStandbyCache.h"
 
 namespace Minecraft
 {
 	namespace ChunkManager
 	{
-		struct DrawCommand
+		struct PrefetchJob
 		{
-			DrawArraysIndirectCommand command;
-			int distanceToPlayer;
-			int level;
-		};
-
-		namespace DrawCommandUtil
-		{
-			bool operator<(const DrawCommand& a, const DrawCommand& b)
-			{
-				return a.distanceToPlayer < b.distanceToPlayer;
-			}
-
-			static bool operator>(const DrawCommand& a, const DrawCommand& b)
-			{
-				return a.distanceToPlayer > b.distanceToPlayer;
-			}
-		}
-
-		class CommandBufferContainer
-		{
-		public:
-			CommandBufferContainer(int maxNumCommands, bool isTransparent)
-			{
-				this->maxNumCommands = maxNumCommands;
-				this->isTransparent = isTransparent;
-				commandBuffer = nullptr;
-				chunkPosBuffer = nullptr;
-				biomeBuffer = nullptr;
-				numCommands = 0;
-			}
-
-			void init()
-			{
-				this->commandBuffer = (DrawCommand*)g_memory_allocate(sizeof(DrawCommand) * maxNumCommands);
-				this->chunkPosBuffer = (int32*)g_memory_allocate(sizeof(int32) * maxNumCommands * 2);
-				this->biomeBuffer = (int32*)g_memory_allocate(sizeof(int32) * maxNumCommands);
-				this->numCommands = 0;
-			}
-
-			void free()
-			{
-				if (commandBuffer)
-				{
-					g_memory_free(commandBuffer);
-					commandBuffer = nullptr;
-				}
-
-				if (chunkPosBuffer)
-				{
-					g_memory_free(chunkPosBuffer);
-					chunkPosBuffer = nullptr;
-				}
-
-				if (biomeBuffer)
-				{
-					g_memory_free(biomeBuffer);
-					biomeBuffer = nullptr;
-				}
-			}
-
-			void add(const DrawArraysIndirectCommand& command, const glm::ivec2& chunkCoords, int level, const glm::ivec2& playerPosChunkCoords, int biome)
-			{
-				g_logger_assert((numCommands + 1) < maxNumCommands, "Ran out of room in command buffer!");
-				glm::ivec2 d = chunkCoords - playerPosChunkCoords;
-				int dSquared = (d.x * d.x) + (d.y * d.y);
-				commandBuffer[numCommands] = { command, dSquared, level };
-				commandBuffer[numCommands].command.baseInstance = numCommands;
-				chunkPosBuffer[(numCommands * 2)] = chunkCoords.x;
-				chunkPosBuffer[(numCommands * 2) + 1] = chunkCoords.y;
-				biomeBuffer[numCommands] = biome;
-				numCommands++;
-			}
-
-			void sort(const glm::ivec2& playerPosChunkCoords)
-			{
-				if (!isTransparent)
-				{
-					// Sort chunks front to back
-					std::sort(commandBuffer, commandBuffer + numCommands, DrawCommandUtil::operator<);
-				}
-				else
-				{
-					std::sort(commandBuffer, commandBuffer + numCommands, DrawCommandUtil::operator>);
-				}
-			}
-
-			inline int getNumCommands() const
-			{
-				return numCommands;
-			}
-
-			inline const DrawCommand* getCommandBuffer() const
-			{
-				return commandBuffer;
-			}
-
-			inline const int32* getChunkPosBuffer() const
-			{
-				return chunkPosBuffer;
-			}
-
-			inline const int32* getBiomeBuffer() const
-			{
-				return biomeBuffer;
-			}
-
-			inline void softReset()
-			{
-				numCommands = 0;
-			}
-
-		private:
-			int maxNumCommands;
-			int numCommands;
-			bool isTransparent;
-			DrawCommand* commandBuffer;
-			int32* chunkPosBuffer;
-			int32* biomeBuffer;
+			std::vector<glm::ivec2> chunkCoords;
 		};
 
 		// Internal functions
 		static void retesselateChunkBlockUpdate(const glm::ivec2& chunkCoords, const glm::vec3& worldPosition, Chunk* blockData);
+		static void prefetchSavedChunks(void* data, size_t dataSize);
+		static void cacheSavedChunk(const glm::ivec2& chunkCoords, RawMemory& memory, void* userData);
+		static void queueLightingPasses(const std::vector<Chunk*>& chunksToLight);
+		static bool isInRange(const glm::ivec2& chunkCoords, const std::vector<glm::ivec2>& centers, int radius);
+		static bool freeUnloadedChunks();
+		static void freeChunk(Chunk& chunk);
+		static Block* newChunkBlocks();
+		static void freeChunkBlocks(Block* blocks);
+
+		// How many rings of chunks past the player's heading get read ahead of time
+		static const int PrefetchRings = 2;
+		// Below this speed in blocks per second there's no heading worth predicting
+		static const float MinPrefetchSpeed = 2.0f;
+		static const int BlocksPerChunk = World::ChunkWidth * World::ChunkDepth * World::ChunkHeight;
+		// Once the first ChunkCapacity slots are in use the block pools grow this many chunks at a time
+		static const uint32 ChunkSlotsPerGrowth = 128;
 
 		// Internal variables
 		static std::mutex chunkMtx;
 		static robin_hood::unordered_node_map<glm::ivec2, Chunk> chunks = {};
 
-		static uint32 chunkPosInstancedBuffer;
-		static uint32 biomeInstancedVbo;
-		static uint32 globalVao;
-		static uint32 globalRenderVbo;
-		// TODO: Make this better
-		static uint32 solidDrawCommandVbo;
-		static uint32 blendableDrawCommandVbo;
-		static Shader compositeShader;
-
 		static ChunkThreadWorker* chunkWorker = nullptr;
 		static Pool<SubChunk>* subChunks = nullptr;
-		static Pool<Block>* blockPool = nullptr;
-		static CommandBufferContainer* solidCommandBuffer = nullptr;
-		static CommandBufferContainer* blendableCommandBuffer = nullptr;
+		// Chunks only get loaded and freed from the thread running checkChunkRadius, so growing this doesn't need a lock
+		static std::vector<Pool<Block>*> blockPools = {};
+		static uint32 numChunkSlots = 0;
+		static std::atomic<uint32> numPrefetchJobsInFlight = 0;
 
 		void init()
 		{
-			// A chunk uses 55,000 vertices on average, so a sub-chunk can be estimated to use about 
-			// 4,500 vertices on average. That's the default vertex bucket size
-
 			// Initialize the singletons
 			chunkWorker = new ChunkThreadWorker();
-			subChunks = new Pool<SubChunk>(1, World::ChunkCapacity * 16);
-			blockPool = new Pool<Block>(World::ChunkDepth * World::ChunkWidth * World::ChunkHeight, World::ChunkCapacity);
-			solidCommandBuffer = new CommandBufferContainer(subChunks->size(), false);
-			blendableCommandBuffer = new CommandBufferContainer(subChunks->size(), true);
+			subChunks = new Pool<SubChunk>(1, World::getChunkCapacity() * 16);
+			blockPools.push_back(new Pool<Block>(BlocksPerChunk, World::ChunkCapacity));
+			numChunkSlots = World::ChunkCapacity;
 			chunks.clear();
 
-			compositeShader.compile("assets/shaders/CompositeShader.glsl");
-
-			// Set up draw commands to relate to our sub chunks
-			solidCommandBuffer->init();
-			glCreateBuffers(1, &solidDrawCommandVbo);
-			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, solidDrawCommandVbo);
-			glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawCommand) * subChunks->size(), NULL, GL_DYNAMIC_DRAW);
-
-			blendableCommandBuffer->init();
-			glCreateBuffers(1, &blendableDrawCommandVbo);
-			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, blendableDrawCommandVbo);
-			glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawCommand) * subChunks->size(), NULL, GL_DYNAMIC_DRAW);
-
-			// Initialize the SubChunks
-			// Generate a bunch of empty vertex buckets for GPU use
-			glCreateVertexArrays(1, &globalVao);
-			glBindVertexArray(globalVao);
-
-			glGenBuffers(1, &globalRenderVbo);
-			glBindBuffer(GL_ARRAY_BUFFER, globalRenderVbo);
-
-			size_t totalSizeOfSubChunkVertices = subChunks->size() * World::MaxVertsPerSubChunk * sizeof(Vertex);
-
-			// Set our vertex attribute pointers
-			glVertexAttribIPointer(0, 1, GL_UNSIGNED_INT, sizeof(Vertex), (void*)offsetof(Vertex, data1));
-			glVertexAttribDivisor(0, 0);
-			glEnableVertexAttribArray(0);
-
-			glVertexAttribIPointer(1, 1, GL_UNSIGNED_INT, sizeof(Vertex), (void*)(offsetof(Vertex, data2)));
-			glVertexAttribDivisor(1, 0);
-			glEnableVertexAttribArray(1);
-
-			// Set up our global immutable buffer
-			GLbitfield flags = GL_MAP_PERSISTENT_BIT | GL_MAP_WRITE_BIT | GL_MAP_COHERENT_BIT;
-			glBufferStorage(GL_ARRAY_BUFFER, totalSizeOfSubChunkVertices, NULL, flags);
-			Vertex* basePointer = (Vertex*)glMapBufferRange(GL_ARRAY_BUFFER, 0, subChunks->size() * World::MaxVertsPerSubChunk, flags);
 			for (uint32 i = 0; i < subChunks->size(); i++)
 			{
-				// Assign the pointers for the data on the CPU
-				(*subChunks)[i]->first = (i * World::MaxVertsPerSubChunk);
-				(*subChunks)[i]->data = basePointer + (*subChunks)[i]->first;
+				(*subChunks)[i]->first = 0;
+				(*subChunks)[i]->data = nullptr;
 				(*subChunks)[i]->numVertsUsed = 0;
 				(*subChunks)[i]->drawCommandIndex = i;
 				(*subChunks)[i]->state = SubChunkState::Unloaded;
 			}
 
-			// Set up the instanced chunk pos vertex buffer
-			glCreateBuffers(1, &chunkPosInstancedBuffer);
-			glBindBuffer(GL_ARRAY_BUFFER, chunkPosInstancedBuffer);
-			glBufferData(GL_ARRAY_BUFFER, sizeof(int32) * 2 * subChunks->size(), NULL, GL_DYNAMIC_DRAW);
-
-			glVertexAttribIPointer(10, 2, GL_INT, sizeof(int32) * 2, 0);
-			glVertexAttribDivisor(10, 1);
-			glEnableVertexAttribArray(10);
-
-			// Set up biome buffer
-			glCreateBuffers(1, &biomeInstancedVbo);
-			glBindBuffer(GL_ARRAY_BUFFER, biomeInstancedVbo);
-			glBufferData(GL_ARRAY_BUFFER, sizeof(int32) * subChunks->size(), NULL, GL_DYNAMIC_DRAW);
+			g_logger_info("Block Pool Total Size: %2.3f Gb", (float)(blockPools[0]->totalSize() / (1024.0f * 1024 * 1024)));
+			DebugStats::totalChunkRamAvailable = (float)blockPools[0]->totalSize();
 
-			glVertexAttribIPointer(11, 1, GL_INT, sizeof(int32), 0);
-			glVertexAttribDivisor(11, 1);
-			glEnableVertexAttribArray(11);
-
-			// Subchunk = 16x16x16  Blocks
-			// BigChunk = 16x256x16 Blocks
-			g_logger_info("Vertex Pool Total Size: %2.3f Gb", (float)(totalSizeOfSubChunkVertices / (1024.0f * 1024 * 1024)));
-			g_logger_info("Block Pool Total Size: %2.3f Gb", (float)(blockPool->totalSize() / (1024.0f * 1024 * 1024)));
-			DebugStats::totalChunkRamAvailable = totalSizeOfSubChunkVertices + (float)blockPool->totalSize();
+#ifndef _HEADLESS
+			ChunkRenderer::init(*subChunks);
+#endif
 		}
 
 		void free()
 		{
-			// Delete GPU memory
-			// TODO: Do error checking on these VBOs to ensure they are valid
-			glDeleteBuffers(1, &solidDrawCommandVbo);
-			glDeleteBuffers(1, &blendableDrawCommandVbo);
-
-			chunks.clear();
-
-			glDeleteBuffers(1, &globalRenderVbo);
-			glDeleteBuffers(1, &chunkPosInstancedBuffer);
-			glDeleteBuffers(1, &biomeInstancedVbo);
-			glDeleteVertexArrays(1, &globalVao);
+#ifndef _HEADLESS
+			ChunkRenderer::free();
+#endif
 
 			// Delete CPU memory
+			// The worker still has to flush pending saves, so it has to go before the chunks
 			if (chunkWorker)
 			{
 				chunkWorker->free();
@@ -271,33 +95,28 @@ namespace Minecraft
 				chunkWorker = nullptr;
 			}
 
-			if (subChunks)
+			// Prefetches read straight out of the region files, so they have to finish before those get closed
+			while (numPrefetchJobsInFlight > 0)
 			{
-				delete subChunks;
-				subChunks = nullptr;
+				std::this_thread::yield();
 			}
+			ChunkStandbyCache::clear();
 
-			if (blockPool)
-			{
-				delete blockPool;
-				blockPool = nullptr;
-			}
+			chunks.clear();
+			RegionFile::closeAll();
 
-			if (solidCommandBuffer)
+			if (subChunks)
 			{
-				solidCommandBuffer->free();
-				delete solidCommandBuffer;
-				solidCommandBuffer = nullptr;
+				delete subChunks;
+				subChunks = nullptr;
 			}
 
-			if (blendableCommandBuffer)
+			for (Pool<Block>* blockPool : blockPools)
 			{
-				blendableCommandBuffer->free();
-				delete blendableCommandBuffer;
-				blendableCommandBuffer = nullptr;
+				delete blockPool;
 			}
-
-			compositeShader.destroy();
+			blockPools.clear();
+			numChunkSlots = 0;
 		}
 
 		void serialize()
@@ -306,7 +125,8 @@ namespace Minecraft
 			{
 				Chunk& chunk = chunkIter.second;
 				Block* blockData = chunk.data;
-				if (chunk.state != ChunkState::Saving && blockData &&
+				if (chunk.state != ChunkState::Saving && blockData && chunk.isDirty() &&
+					chunk.state != ChunkState::Loading &&
 					chunk.state != ChunkState::Unloaded &&
 					chunk.state != ChunkState::Unloading)
 				{
@@ -315,22 +135,36 @@ namespace Minecraft
 			}
 		}
 
+		void readSavedChunks(const std::vector<glm::ivec2>& chunkCoords, RegionChunkCallback callback, void* userData)
+		{
+			RegionFile::readChunks(World::chunkSavePath, chunkCoords, callback, userData);
+		}
+
+		void flushSaves()
+		{
+			chunkWorker->flushSaves();
+		}
+
 		void serializeSynchronous() 
 		{
 			for (robin_hood::pair<const glm::ivec2, Chunk>& chunkIter : chunks)
 			{
 				Chunk& chunk = chunkIter.second;
 				Block* blockData = chunk.data;
-				if (chunk.state != ChunkState::Saving && blockData &&
+				if (chunk.state != ChunkState::Saving && blockData && chunk.isDirty() &&
+					chunk.state != ChunkState::Loading &&
 					chunk.state != ChunkState::Unloaded &&
 					chunk.state != ChunkState::Unloading)
 				{
 					ChunkState oldState = chunk.state;
+					uint32 epoch = chunk.modifiedEpoch;
 					chunk.state = ChunkState::Saving;
 					ChunkPrivate::serialize(World::chunkSavePath, chunk);
+					chunk.savedEpoch = epoch;
 					chunk.state = oldState;
 				}
 			}
+			RegionFile::commit(World::chunkSavePath);
 		}
 
 		robin_hood::unordered_node_map<glm::ivec2, Chunk>& getAllChunks()
@@ -338,6 +172,66 @@ namespace Minecraft
 			return chunks;
 		}
 
+		void prefetchAhead(const glm::vec3& playerPosition, const glm::vec3& playerVelocity)
+		{
+			// Network clients get their chunks from the server
+			if (Network::isNetworkEnabled())
+			{
+				return;
+			}
+
+			glm::vec2 horizontalVelocity = glm::vec2(playerVelocity.x, playerVelocity.z);
+			float speed = glm::length(horizontalVelocity);
+			if (speed < MinPrefetchSpeed)
+			{
+				return;
+			}
+
+			// Only look again once the player moves into a new chunk or turns
+			static glm::ivec2 lastPlayerPosChunkCoords = glm::ivec2(INT32_MAX);
+			static glm::ivec2 lastHeading = glm::ivec2(0);
+			glm::ivec2 playerPosChunkCoords = World::toChunkCoords(playerPosition);
+			glm::vec2 direction = horizontalVelocity / speed;
+			glm::ivec2 heading = glm::ivec2(glm::round(direction));
+			if (playerPosChunkCoords == lastPlayerPosChunkCoords && heading == lastHeading)
+			{
+				return;
+			}
+			lastPlayerPosChunkCoords = playerPosChunkCoords;
+			lastHeading = heading;
+
+			PrefetchJob* job = new PrefetchJob();
+			for (int ring = 1; ring <= PrefetchRings; ring++)
+			{
+				glm::ivec2 predictedChunkCoords = playerPosChunkCoords + glm::ivec2(glm::round(direction * (float)ring));
+				for (int y = predictedChunkCoords.y - World::ChunkRadius; y <= predictedChunkCoords.y + World::ChunkRadius; y++)
+				{
+					for (int x = predictedChunkCoords.x - World::ChunkRadius; x <= predictedChunkCoords.x + World::ChunkRadius; x++)
+					{
+						glm::ivec2 position = glm::ivec2(x, y);
+						glm::ivec2 localPos = predictedChunkCoords - position;
+						bool inPredictedRadius = (localPos.x * localPos.x) + (localPos.y * localPos.y) <= (World::ChunkRadius * World::ChunkRadius);
+						if (inPredictedRadius && !getChunk(position) &&
+							RegionFile::chunkExists(World::chunkSavePath, position) &&
+							ChunkStandbyCache::beginPrefetch(position))
+						{
+							job->chunkCoords.push_back(position);
+						}
+					}
+				}
+			}
+
+			if (job->chunkCoords.empty())
+			{
+				delete job;
+				return;
+			}
+
+			numPrefetchJobsInFlight++;
+			Application::getGlobalThreadPool().queueTask(prefetchSavedChunks, "PrefetchSavedChunks", job, sizeof(PrefetchJob), Priority::Low);
+			Application::getGlobalThreadPool().beginWork(false);
+		}
+
 		void queueCommand(FillChunkCommand& command) 
 		{
 			chunkWorker->queueCommand(command);
@@ -347,19 +241,47 @@ namespace Minecraft
 		{
 			// Only upload if we need to
 			Chunk* chunk = getChunk(chunkCoordinates);
-			if (!chunk)
+			if (chunk && chunk->state == ChunkState::Unloaded)
 			{
-				if (!blockPool->empty())
+				// The fill got cancelled but the rest of its commands haven't drained yet, so the chunk
+				// is still around. Queue it again instead of waiting for the next radius check to free it.
+				chunk->state = ChunkState::Loading;
+				chunk->needsToGenerateDecorations = true;
+				chunk->needsToCalculateLighting = true;
+				chunk->decorationsQueued = false;
+				chunk->lightingQueued = false;
+				chunk->modifiedEpoch = 0;
+				chunk->savedEpoch = 0;
+				chunk->loadGeneration++;
+
+				FillChunkCommand cmd;
+				cmd.type = CommandType::GenerateTerrain;
+				cmd.chunk = chunk;
+				cmd.subChunks = subChunks;
+				cmd.isRetesselating = false;
+				chunkWorker->queueCommand(cmd);
+			}
+			else if (!chunk)
+			{
+				Block* blocks = newChunkBlocks();
+				if (blocks)
 				{
 					Chunk newChunk;
-					newChunk.data = blockPool->getNewPool();
+					newChunk.data = blocks;
 
 					newChunk.chunkCoords = chunkCoordinates;
 					newChunk.topNeighbor = getChunk(chunkCoordinates + INormals2::Up);
 					newChunk.bottomNeighbor = getChunk(chunkCoordinates + INormals2::Down);
 					newChunk.leftNeighbor = getChunk(chunkCoordinates + INormals2::Left);
 					newChunk.rightNeighbor = getChunk(chunkCoordinates + INormals2::Right);
-					newChunk.state = ChunkState::Loaded;
+					newChunk.state = ChunkState::Loading;
+					newChunk.needsToGenerateDecorations = true;
+					newChunk.needsToCalculateLighting = true;
+					newChunk.decorationsQueued = false;
+					newChunk.lightingQueued = false;
+					newChunk.modifiedEpoch = 0;
+					newChunk.savedEpoch = 0;
+					newChunk.loadGeneration = 0;
 
 					{
 						// TODO: Ensure this is only ever accessed from the main thread
@@ -373,28 +295,108 @@ namespace Minecraft
 					cmd.subChunks = subChunks;
 					cmd.isRetesselating = false;
 
-					// Queue the fill command
-					chunkWorker->queueCommand(cmd);
-					// Queue the tesselate command
-					cmd.type = CommandType::TesselateVertices;
+					// Queue the fill command, decorations, lighting and tesselation get queued
+					// once the surrounding chunks have been queued too
 					chunkWorker->queueCommand(cmd);
 
-					DebugStats::totalChunkRamUsed = DebugStats::totalChunkRamUsed + blockPool->poolSize() * sizeof(Block);
+					DebugStats::totalChunkRamUsed = DebugStats::totalChunkRamUsed + BlocksPerChunk * sizeof(Block);
 				}
 				else
 				{
-					// What do we do if there were no free blocks?
-					g_logger_warning("No free pools for block data.");
+					// Nothing else will try to load this chunk again, so say why it's missing
+					g_logger_error("Chunk <%d, %d> can't be loaded, all %u chunk slots are in use.", chunkCoordinates.x, chunkCoordinates.y, numChunkSlots);
 				}
 			}
 		}
 
 		void queueCalculateLighting(const glm::ivec2& lastPlayerPosInChunkCoords)
 		{
-			FillChunkCommand cmd;
-			cmd.type = CommandType::CalculateLighting;
-			cmd.playerPosChunkCoords = lastPlayerPosInChunkCoords;
-			chunkWorker->queueCommand(cmd);
+			// Every pass has to be queued for all the chunks before the next pass, so the
+			// worker orders each chunk after the passes of the chunks around it
+			std::vector<Chunk*> chunksToLight;
+			for (int chunkZ = lastPlayerPosInChunkCoords.y - World::ChunkRadius; chunkZ <= lastPlayerPosInChunkCoords.y + World::ChunkRadius; chunkZ++)
+			{
+				for (int chunkX = lastPlayerPosInChunkCoords.x - World::ChunkRadius; chunkX <= lastPlayerPosInChunkCoords.x + World::ChunkRadius; chunkX++)
+				{
+					glm::ivec2 localChunkPos = glm::ivec2(lastPlayerPosInChunkCoords.x - chunkX, lastPlayerPosInChunkCoords.y - chunkZ);
+					bool inRangeOfPlayer =
+						(localChunkPos.x * localChunkPos.x) + (localChunkPos.y * localChunkPos.y) <=
+						(World::ChunkRadius * World::ChunkRadius);
+					if (!inRangeOfPlayer)
+					{
+						continue;
+					}
+
+					Chunk* chunk = getChunk(glm::ivec2(chunkX, chunkZ));
+					if (chunk && chunk->needsToCalculateLighting && !chunk->lightingQueued)
+					{
+						chunk->lightingQueued = true;
+						chunksToLight.push_back(chunk);
+					}
+				}
+			}
+
+			queueLightingPasses(chunksToLight);
+		}
+
+		void queueStreamedChunkLighting(bool streamCaughtUp)
+		{
+			patchChunkPointers();
+
+			// Lighting and faces along the edges would be wrong if they were calculated against
+			// neighbors that haven't arrived yet
+			std::vector<Chunk*> chunksToLight;
+			robin_hood::unordered_flat_set<glm::ivec2> chunksBeingLit;
+			for (auto& pair : chunks)
+			{
+				Chunk& chunk = pair.second;
+				if (!chunk.needsToCalculateLighting || chunk.lightingQueued)
+				{
+					continue;
+				}
+
+				bool hasAllNeighbors = true;
+				for (int z = -1; z <= 1 && hasAllNeighbors; z++)
+				{
+					for (int x = -1; x <= 1; x++)
+					{
+						if (chunks.find(chunk.chunkCoords + glm::ivec2(x, z)) == chunks.end())
+						{
+							hasAllNeighbors = false;
+							break;
+						}
+					}
+				}
+
+				if (hasAllNeighbors || streamCaughtUp)
+				{
+					chunk.lightingQueued = true;
+					chunksToLight.push_back(&chunk);
+					chunksBeingLit.insert(chunk.chunkCoords);
+				}
+			}
+
+			queueLightingPasses(chunksToLight);
+
+			// Neighbors that were already meshed need their edges redone against the new chunks
+			robin_hood::unordered_flat_set<glm::ivec2> chunksToRetesselate;
+			for (Chunk* chunk : chunksToLight)
+			{
+				Chunk* neighbors[4] = { chunk->topNeighbor, chunk->bottomNeighbor, chunk->leftNeighbor, chunk->rightNeighbor };
+				for (Chunk* neighbor : neighbors)
+				{
+					if (neighbor && neighbor->lightingQueued && chunksBeingLit.find(neighbor->chunkCoords) == chunksBeingLit.end())
+					{
+						chunksToRetesselate.insert(neighbor->chunkCoords);
+					}
+				}
+			}
+			for (const glm::ivec2& chunkCoords : chunksToRetesselate)
+			{
+				queueRetesselateChunk(chunkCoords);
+			}
+
+			chunkWorker->beginWork();
 		}
 
 		float percentWorkDone()
@@ -470,16 +472,35 @@ namespace Minecraft
 			}
 		}
 
-		void queueClientLoadChunk(void* chunkData, const glm::ivec2& chunkCoordinates, ChunkState state)
+		bool queueClientLoadChunk(uint8* compressedData, size_t compressedDataSize, const glm::ivec2& chunkCoordinates, ChunkState state)
 		{
 			// Only upload if we need to
 			Chunk* chunk = getChunk(chunkCoordinates);
+			if (chunk && chunk->state == ChunkState::Loaded)
+			{
+				// The server only sends a chunk twice when its idea of where our player is lags a chunk
+				// behind ours, so it forgot about this one before we let go of it
+				g_memory_free(compressedData);
+				return true;
+			}
+
+			if (chunk && !chunkWorker->hasPendingWork(chunkCoordinates))
+			{
+				// It came back into range before it got freed, the server's copy replaces ours
+				auto iter = chunks.find(chunkCoordinates);
+				freeChunk(iter->second);
+				chunks.erase(iter);
+				patchChunkPointers();
+				chunk = nullptr;
+			}
+
 			if (!chunk)
 			{
-				if (!blockPool->empty())
+				Block* blocks = newChunkBlocks();
+				if (blocks)
 				{
 					Chunk newChunk;
-					newChunk.data = blockPool->getNewPool();
+					newChunk.data = blocks;
 
 					newChunk.chunkCoords = chunkCoordinates;
 					newChunk.topNeighbor = getChunk(chunkCoordinates + INormals2::Up);
@@ -487,6 +508,13 @@ namespace Minecraft
 					newChunk.leftNeighbor = getChunk(chunkCoordinates + INormals2::Left);
 					newChunk.rightNeighbor = getChunk(chunkCoordinates + INormals2::Right);
 					newChunk.state = state;
+					newChunk.needsToGenerateDecorations = false;
+					newChunk.needsToCalculateLighting = true;
+					newChunk.decorationsQueued = false;
+					newChunk.lightingQueued = false;
+					newChunk.modifiedEpoch = 0;
+					newChunk.savedEpoch = 0;
+					newChunk.loadGeneration = 0;
 
 					{
 						// TODO: Ensure this is only ever accessed from the main thread
@@ -498,30 +526,54 @@ namespace Minecraft
 					cmd.type = CommandType::ClientLoadChunk;
 					cmd.chunk = &chunks[newChunk.chunkCoords];
 					cmd.subChunks = subChunks;
-					cmd.clientChunkData = chunkData;
+					cmd.clientChunkData = compressedData;
+					cmd.clientChunkDataSize = compressedDataSize;
 
-					// Queue the fill command
-					chunkWorker->queueCommand(cmd);
-					// Queue the tesselate command
-					cmd.type = CommandType::TesselateVertices;
+					// Queue the fill command, decorations, lighting and tesselation get queued
+					// once the surrounding chunks have been queued too
 					chunkWorker->queueCommand(cmd);
 
-					DebugStats::totalChunkRamUsed = DebugStats::totalChunkRamUsed + blockPool->poolSize() * sizeof(Block);
+					DebugStats::totalChunkRamUsed = DebugStats::totalChunkRamUsed + BlocksPerChunk * sizeof(Block);
+					return true;
 				}
 				else
 				{
-					// What do we do if there were no free blocks?
-					g_logger_warning("No free pools for block data.");
+					// Nothing else will try to load this chunk again, so say why it's missing
+					g_logger_error("Chunk <%d, %d> can't be loaded, all %u chunk slots are in use.", chunkCoordinates.x, chunkCoordinates.y, numChunkSlots);
 				}
 			}
+
+			return false;
 		}
 
 		void queueGenerateDecorations(const glm::ivec2& lastPlayerLoadChunkPos)
 		{
 			FillChunkCommand cmd;
 			cmd.type = CommandType::GenerateDecorations;
-			cmd.playerPosChunkCoords = lastPlayerLoadChunkPos;
-			chunkWorker->queueCommand(cmd);
+			cmd.subChunks = subChunks;
+			for (int chunkZ = lastPlayerLoadChunkPos.y - World::ChunkRadius; chunkZ <= lastPlayerLoadChunkPos.y + World::ChunkRadius; chunkZ++)
+			{
+				for (int chunkX = lastPlayerLoadChunkPos.x - World::ChunkRadius; chunkX <= lastPlayerLoadChunkPos.x + World::ChunkRadius; chunkX++)
+				{
+					glm::ivec2 localChunkPos = glm::ivec2(lastPlayerLoadChunkPos.x - chunkX, lastPlayerLoadChunkPos.y - chunkZ);
+					bool inRangeOfPlayer =
+						(localChunkPos.x * localChunkPos.x) + (localChunkPos.y * localChunkPos.y) <=
+						((World::ChunkRadius - 1) * (World::ChunkRadius - 1));
+					if (!inRangeOfPlayer)
+					{
+						// Skip over all chunks in range radius - 1, their neighbors might not exist yet
+						continue;
+					}
+
+					Chunk* chunk = getChunk(glm::ivec2(chunkX, chunkZ));
+					if (chunk && chunk->needsToGenerateDecorations && !chunk->decorationsQueued)
+					{
+						chunk->decorationsQueued = true;
+						cmd.chunk = chunk;
+						chunkWorker->queueCommand(cmd);
+					}
+				}
+			}
 		}
 
 		Block getBlock(const glm::vec3& worldPosition)
@@ -631,11 +683,6 @@ namespace Minecraft
 			chunkWorker->beginWork();
 		}
 
-		void wakeUpCv2()
-		{
-			chunkWorker->wakeupCv2();
-		}
-
 		void render(const glm::vec3& playerPosition, const glm::ivec2& playerPositionInChunkCoords, Shader& opaqueShader, Shader& transparentShader, const Frustum& cameraFrustum)
 		{
 			chunkWorker->setPlayerPosChunkCoords(playerPositionInChunkCoords);
@@ -664,25 +711,7 @@ namespace Minecraft
 						if ((*subChunks)[i]->state == SubChunkState::Uploaded || (*subChunks)[i]->state == SubChunkState::RetesselateVertices)
 						{
 							g_logger_assert((*subChunks)[i]->numVertsUsed.load() > 0, "Sub Chunk should never have tried to upload 0 verts to GPU.");
-							float yCenter = (float)(*subChunks)[i]->subChunkLevel * 16.0f;
-							glm::vec3 chunkPos = glm::vec3((*subChunks)[i]->chunkCoordinates.x * World::ChunkDepth, yCenter, (*subChunks)[i]->chunkCoordinates.y * World::ChunkWidth);
-							if (cameraFrustum.isBoxVisible(chunkPos, chunkPos + glm::vec3(16, 16, 16)))
-							{
-								DrawArraysIndirectCommand drawCommand;
-								g_logger_assert((*subChunks)[i]->numVertsUsed.load() > 0, "Sub Chunk should never have tried to upload 0 verts to GPU.");
-								drawCommand.baseInstance = 0;
-								drawCommand.instanceCount = 1;
-								drawCommand.count = (*subChunks)[i]->numVertsUsed;
-								drawCommand.first = (*subChunks)[i]->first;
-								if ((*subChunks)[i]->isBlendable)
-								{
-									blendableCommandBuffer->add(drawCommand, (*subChunks)[i]->chunkCoordinates, (*subChunks)[i]->subChunkLevel, playerPositionInChunkCoords, 0);
-								}
-								else
-								{
-									solidCommandBuffer->add(drawCommand, (*subChunks)[i]->chunkCoordinates, (*subChunks)[i]->subChunkLevel, playerPositionInChunkCoords, 0);
-								}
-							}
+							ChunkRenderer::addSubChunk(*(*subChunks)[i], playerPositionInChunkCoords, cameraFrustum);
 
 							if ((*subChunks)[i]->state == SubChunkState::DoneRetesselating)
 							{
@@ -695,104 +724,7 @@ namespace Minecraft
 				}
 			}
 
-			glm::vec3 tint = glm::vec3(1.0f);
-			if (World::isPlayerUnderwater())
-			{
-				tint = "#497dd1"_hex;
-			}
-			if (solidCommandBuffer->getNumCommands() > 0)
-			{
-				// Render opaque geometry
-				glEnable(GL_CULL_FACE);
-				glEnable(GL_DEPTH_TEST);
-				glDepthFunc(GL_LESS);
-				glDepthMask(GL_TRUE);
-				glDisable(GL_BLEND);
-
-				solidCommandBuffer->sort(playerPositionInChunkCoords);
-				glBindBuffer(GL_ARRAY_BUFFER, chunkPosInstancedBuffer);
-				glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(int32) * 2 * solidCommandBuffer->getNumCommands(), solidCommandBuffer->getChunkPosBuffer());
-				glBindBuffer(GL_ARRAY_BUFFER, biomeInstancedVbo);
-				glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(int32) * solidCommandBuffer->getNumCommands(), solidCommandBuffer->getBiomeBuffer());
-				glBindBuffer(GL_DRAW_INDIRECT_BUFFER, solidDrawCommandVbo);
-				glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(DrawCommand) * solidCommandBuffer->getNumCommands(), solidCommandBuffer->getCommandBuffer());
-				DebugStats::numDrawCalls += solidCommandBuffer->getNumCommands();
-
-				glBindVertexArray(globalVao);
-				opaqueShader.bind();
-				opaqueShader.uploadVec3("uPlayerPosition", playerPosition);
-				opaqueShader.uploadInt("uChunkRadius", World::ChunkRadius);
-				opaqueShader.uploadVec3("uTint", tint);
-				glMultiDrawArraysIndirect(GL_TRIANGLES, NULL, solidCommandBuffer->getNumCommands(), sizeof(DrawCommand));
-				solidCommandBuffer->softReset();
-			}
-
-			if (blendableCommandBuffer->getNumCommands() > 0)
-			{
-				const GLenum blendableDrawBuffer[3] = { GL_NONE, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
-				glDrawBuffers(3, blendableDrawBuffer);
-
-				const float zeroFillerVec[4] = { 0.0f, 0.0f, 0.0f };
-				glClearBufferfv(GL_COLOR, 1, &zeroFillerVec[0]);
-				const float oneFillerVec[4] = { 1.0f, 0.0f, 0.0f, 0.0f };
-				glClearBufferfv(GL_COLOR, 2, &oneFillerVec[0]);
-
-				// Render transparent geometry
-				// Disable depth writes so transparent objects don't interfere with solid passes depth values
-				glDepthMask(GL_FALSE);
-				glEnable(GL_BLEND);
-				glBlendFunci(1, GL_ONE, GL_ONE); // Accumulation blend target
-				glBlendFunci(2, GL_ZERO, GL_ONE_MINUS_SRC_COLOR); // Revealage blend target
-				glBlendEquation(GL_FUNC_ADD);
-
-				// We shouldn't need to even sort this...
-				//transparentCommandBuffer().sort(playerPositionInChunkCoords);
-				glBindBuffer(GL_ARRAY_BUFFER, chunkPosInstancedBuffer);
-				glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(int32) * 2 * blendableCommandBuffer->getNumCommands(), blendableCommandBuffer->getChunkPosBuffer());
-				glBindBuffer(GL_ARRAY_BUFFER, biomeInstancedVbo);
-				glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(int32) * blendableCommandBuffer->getNumCommands(), blendableCommandBuffer->getBiomeBuffer());
-				glBindBuffer(GL_DRAW_INDIRECT_BUFFER, blendableDrawCommandVbo);
-				glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(DrawCommand) * blendableCommandBuffer->getNumCommands(), blendableCommandBuffer->getCommandBuffer());
-				DebugStats::numDrawCalls += blendableCommandBuffer->getNumCommands();
-
-				transparentShader.bind();
-				transparentShader.uploadVec3("uPlayerPosition", playerPosition);
-				transparentShader.uploadInt("uChunkRadius", World::ChunkRadius);
-				transparentShader.uploadVec3("uTint", tint);
-
-				glBindVertexArray(globalVao);
-				glMultiDrawArraysIndirect(GL_TRIANGLES, NULL, blendableCommandBuffer->getNumCommands(), sizeof(DrawCommand));
-				blendableCommandBuffer->softReset();
-
-				// Reset render state
-				glEnable(GL_CULL_FACE);
-				glDepthMask(GL_TRUE);
-				glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-				const GLenum mainDrawBuffer[3] = { GL_COLOR_ATTACHMENT0, GL_NONE, GL_NONE };
-				glDrawBuffers(3, mainDrawBuffer);
-
-				// Blend the opaque and blended stuff together now...
-				// Set the render state for compositing our transparent and opaque buffers
-				glDepthFunc(GL_ALWAYS);
-				glEnable(GL_BLEND);
-				glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-				// Draw the screen quad
-				Framebuffer& mainFramebuffer = Application::getMainFramebuffer();
-				compositeShader.bind();
-				glActiveTexture(GL_TEXTURE0);
-				glBindTexture(GL_TEXTURE_2D, mainFramebuffer.getColorAttachment(1).graphicsId);
-				compositeShader.uploadInt("accumulationTexture", 0);
-				glActiveTexture(GL_TEXTURE1);
-				glBindTexture(GL_TEXTURE_2D, mainFramebuffer.getColorAttachment(2).graphicsId);
-				compositeShader.uploadInt("revealTexture", 1);
-
-				glBindVertexArray(Vertices::fullScreenSpaceRectangleVao);
-				glDrawArrays(GL_TRIANGLES, 0, 6);
-
-				glDepthFunc(GL_LESS);
-			}
+			ChunkRenderer::render(playerPosition, playerPositionInChunkCoords, opaqueShader, transparentShader);
 		}
 
 		void setPlayerChunkPos(const glm::ivec2& playerChunkPos) 
@@ -802,96 +734,258 @@ namespace Minecraft
 
 		void checkChunkRadius(const glm::vec3& playerPosition, bool isClient)
 		{
+			checkChunkRadius(std::vector<glm::vec3>{ playerPosition }, isClient);
+		}
+
+		void checkChunkRadius(const std::vector<glm::vec3>& loadPositions, bool isClient)
+		{
 #ifdef _USE_OPTICK
 			OPTICK_EVENT();
 #endif
+			g_logger_assert(loadPositions.size() > 0, "Need at least one position to load chunks around.");
 
-			glm::ivec2 playerPosChunkCoords = World::toChunkCoords(playerPosition);
-			setPlayerChunkPos(playerPosChunkCoords);
-			static glm::ivec2 lastPlayerPosChunkCoords = playerPosChunkCoords;
+			std::vector<glm::ivec2> loadChunkCoords;
+			for (const glm::vec3& position : loadPositions)
+			{
+				loadChunkCoords.push_back(World::toChunkCoords(position));
+			}
+			// Queued work is ordered by whichever of these positions it's closest to
+			chunkWorker->setLoadPositions(loadChunkCoords);
+			static std::vector<glm::ivec2> lastLoadChunkCoords = loadChunkCoords;
 
 			if (isClient)
 			{
+				// The server streams in whatever comes into range, we only have to let go of what leaves it.
+				// Streamed chunks never get saved, the ClientChunkCache still has them if we come back.
+				for (auto& [chunkCoords, chunk] : chunks)
+				{
+					if (chunk.state == ChunkState::Loaded && !isInRange(chunkCoords, loadChunkCoords, World::ChunkRadius + World::StreamUnloadMargin))
+					{
+						chunk.state = ChunkState::Unloading;
+					}
+				}
+
+				if (freeUnloadedChunks())
+				{
+					patchChunkPointers();
+				}
 				chunkWorker->beginWork();
 				return;
 			}
 
 			// Remove out of range chunks
-			for (int i = 0; i < (int)subChunks->size(); i++)
+			for (auto& [chunkCoords, chunk] : chunks)
 			{
-				if ((*subChunks)[i]->state != SubChunkState::Unloaded)
+				if (chunk.state == ChunkState::Loaded && !isInRange(chunkCoords, loadChunkCoords, World::ChunkRadius))
 				{
-					glm::ivec2 chunkPos = (*subChunks)[i]->chunkCoordinates;
-					const glm::ivec2 localChunkPos = chunkPos - playerPosChunkCoords;
-					bool inRangeOfPlayer =
-						(localChunkPos.x * localChunkPos.x) + (localChunkPos.y * localChunkPos.y) <=
-						(World::ChunkRadius * World::ChunkRadius);
-					if (!inRangeOfPlayer)
+					queueSaveChunk(chunkCoords);
+				}
+			}
+
+			// Unload any chunks that have been serialized or were cancelled before they loaded
+			freeUnloadedChunks();
+
+			// Load/retesselate any chunks that need to be
+			bool needsWork = false;
+			std::vector<glm::ivec2> chunksToRetesselate;
+			std::vector<glm::ivec2> chunksToCreate;
+			robin_hood::unordered_flat_set<glm::ivec2> chunksVisited;
+			for (const glm::ivec2& loadPosChunkCoords : loadChunkCoords)
+			{
+				for (int y = loadPosChunkCoords.y - World::ChunkRadius; y <= loadPosChunkCoords.y + World::ChunkRadius; y++)
+				{
+					for (int x = loadPosChunkCoords.x - World::ChunkRadius; x <= loadPosChunkCoords.x + World::ChunkRadius; x++)
 					{
-						auto iter = chunks.find(chunkPos);
-						if (iter != chunks.end() && iter->second.state != ChunkState::Saving)
+						glm::ivec2 position(x, y);
+						glm::ivec2 localPos = loadPosChunkCoords - position;
+						if ((localPos.x * localPos.x) + (localPos.y * localPos.y) <= (World::ChunkRadius * World::ChunkRadius) &&
+							chunksVisited.insert(position).second)
 						{
-							queueSaveChunk((*subChunks)[i]->chunkCoordinates);
+							// We have to expand in a circle that exceeds the range of chunks in this radius,
+							// so we also have to make sure that we check if the chunk is in range before we
+							// try to queue it. Otherwise, we end up with infinite queues that instantly get deleted
+							// which clog our threads with empty work.
+							needsWork = true;
+							// A chunk that was cancelled before it loaded has nothing to retesselate, it gets queued again
+							Chunk* existingChunk = getChunk(position);
+							bool retesselateThisChunk = existingChunk != nullptr &&
+								existingChunk->state != ChunkState::Unloaded &&
+								!isInRange(position, lastLoadChunkCoords, World::ChunkRadius - 2);
+							if (retesselateThisChunk)
+							{
+								chunksToRetesselate.push_back(position);
+							}
+							else
+							{
+								chunksToCreate.push_back(position);
+							}
 						}
 					}
 				}
 			}
 
-			// Unload any chunks that have been serialized
-			for (auto iter = chunks.begin(); iter != chunks.end();)
+			// Start paging in the saved chunks we're about to load so the workers don't stall on disk reads
+			RegionFile::prefetchChunks(World::chunkSavePath, chunksToCreate);
+			for (const glm::ivec2& position : chunksToCreate)
+			{
+				ChunkManager::queueCreateChunk(position);
+			}
+
+			for (const glm::ivec2& loadPosChunkCoords : loadChunkCoords)
+			{
+				ChunkManager::queueGenerateDecorations(loadPosChunkCoords);
+				ChunkManager::queueCalculateLighting(loadPosChunkCoords);
+			}
+			// Old edge chunks get retesselated after the new chunks next to them are lit
+			for (const glm::ivec2& position : chunksToRetesselate)
+			{
+				ChunkManager::queueRetesselateChunk(position);
+			}
+			lastLoadChunkCoords = loadChunkCoords;
+
+			if (needsWork)
+			{
+				patchChunkPointers();
+				chunkWorker->beginWork();
+			}
+		}
+
+		static void prefetchSavedChunks(void* data, size_t dataSize)
+		{
+			PrefetchJob* job = (PrefetchJob*)data;
+			readSavedChunks(job->chunkCoords, cacheSavedChunk, nullptr);
+			// Chunks that failed to read, or whose region file or location was gone, never got their data
+			for (const glm::ivec2& chunkCoords : job->chunkCoords)
+			{
+				ChunkStandbyCache::cancelPrefetch(chunkCoords);
+			}
+			delete job;
+			numPrefetchJobsInFlight--;
+		}
+
+		static void cacheSavedChunk(const glm::ivec2& chunkCoords, RawMemory& memory, void* userData)
+		{
+			// Keep it compressed, it only gets decoded if the player actually gets here
+			ChunkStandbyCache::finishPrefetch(chunkCoords, memory.data, memory.size);
+		}
+
+		static void queueLightingPasses(const std::vector<Chunk*>& chunksToLight)
+		{
+			FillChunkCommand cmd;
+			cmd.subChunks = subChunks;
+			cmd.isRetesselating = false;
+
+			cmd.type = CommandType::CalculateSkyLighting;
+			for (Chunk* chunk : chunksToLight)
+			{
+				cmd.chunk = chunk;
+				chunkWorker->queueCommand(cmd);
+			}
+
+			cmd.type = CommandType::CalculateLighting;
+			for (Chunk* chunk : chunksToLight)
+			{
+				cmd.chunk = chunk;
+				chunkWorker->queueCommand(cmd);
+			}
+
+			// Lighting only happens once per chunk, so this is the chunk's first tesselation
+			cmd.type = CommandType::TesselateVertices;
+			for (Chunk* chunk : chunksToLight)
+			{
+				cmd.chunk = chunk;
+				chunkWorker->queueCommand(cmd);
+			}
+		}
+
+		static bool isInRange(const glm::ivec2& chunkCoords, const std::vector<glm::ivec2>& centers, int radius)
+		{
+			for (const glm::ivec2& center : centers)
 			{
-				if (iter->second.state == ChunkState::Unloading)
+				glm::ivec2 localChunkPos = chunkCoords - center;
+				if ((localChunkPos.x * localChunkPos.x) + (localChunkPos.y * localChunkPos.y) <= radius * radius)
 				{
-					DebugStats::totalChunkRamUsed = DebugStats::totalChunkRamUsed - (float)(blockPool->poolSize() * sizeof(Block));
+					return true;
+				}
+			}
+			return false;
+		}
 
-					blockPool->freePool(iter->second.data);
+		static bool freeUnloadedChunks()
+		{
+			bool freedChunk = false;
+			for (auto iter = chunks.begin(); iter != chunks.end();)
+			{
+				bool isUnloaded = iter->second.state == ChunkState::Unloading || iter->second.state == ChunkState::Unloaded;
+				if (isUnloaded && !chunkWorker->hasPendingWork(iter->first))
+				{
+					freeChunk(iter->second);
 					iter = chunks.erase(iter);
+					freedChunk = true;
 				}
 				else
 				{
 					iter++;
 				}
 			}
+			return freedChunk;
+		}
 
-			// Load/retesselate any chunks that need to be
-			bool needsWork = false;
-			for (int y = playerPosChunkCoords.y - World::ChunkRadius; y <= playerPosChunkCoords.y + World::ChunkRadius; y++)
+		static void freeChunk(Chunk& chunk)
+		{
+			// Saved chunks gave their sub-chunks back already, streamed chunks still have theirs
+			for (int i = 0; i < (int)subChunks->size(); i++)
 			{
-				for (int x = playerPosChunkCoords.x - World::ChunkRadius; x <= playerPosChunkCoords.x + World::ChunkRadius; x++)
+				if ((*subChunks)[i]->state != SubChunkState::Unloaded && (*subChunks)[i]->chunkCoordinates == chunk.chunkCoords)
 				{
-					glm::ivec2 position(x, y);
-					glm::ivec2 localPos = playerPosChunkCoords - position;
-					if ((localPos.x * localPos.x) + (localPos.y * localPos.y) <= (World::ChunkRadius * World::ChunkRadius))
-					{
-						// We have to expand in a circle that exceeds the range of chunks in this radius,
-						// so we also have to make sure that we check if the chunk is in range before we
-						// try to queue it. Otherwise, we end up with infinite queues that instantly get deleted
-						// which clog our threads with empty work.
-						needsWork = true;
-						glm::ivec2 lastLocalPos = lastPlayerPosChunkCoords - position;
-						bool retesselateThisChunk = getChunk(position) != nullptr &&
-							(lastLocalPos.x * lastLocalPos.x) + (lastLocalPos.y * lastLocalPos.y) >= ((World::ChunkRadius - 2) * (World::ChunkRadius - 2));
-						if (retesselateThisChunk)
-						{
-							ChunkManager::queueRetesselateChunk(position);
-						}
-						else
-						{
-							ChunkManager::queueCreateChunk(position);
-						}
-					}
+					(*subChunks)[i]->state = SubChunkState::Unloaded;
+					(*subChunks)[i]->numVertsUsed = 0;
+					subChunks->freePool(i);
+					DebugStats::totalChunkRamUsed = DebugStats::totalChunkRamUsed - (World::MaxVertsPerSubChunk * sizeof(Vertex));
 				}
 			}
 
-			ChunkManager::queueGenerateDecorations(playerPosChunkCoords);
-			ChunkManager::queueCalculateLighting(playerPosChunkCoords);
-			lastPlayerPosChunkCoords = playerPosChunkCoords;
+			DebugStats::totalChunkRamUsed = DebugStats::totalChunkRamUsed - (float)(BlocksPerChunk * sizeof(Block));
+			freeChunkBlocks(chunk.data);
+		}
 
-			if (needsWork)
+		static Block* newChunkBlocks()
+		{
+			for (Pool<Block>* blockPool : blockPools)
 			{
-				patchChunkPointers();
-				chunkWorker->beginWork();
+				if (!blockPool->empty())
+				{
+					return blockPool->getNewPool();
+				}
 			}
+
+			// Every slot is taken, add another pool unless that would go past what the world allows
+			uint32 numNewSlots = glm::min(ChunkSlotsPerGrowth, World::getChunkCapacity() - numChunkSlots);
+			if (numNewSlots == 0)
+			{
+				return nullptr;
+			}
+
+			Pool<Block>* blockPool = new Pool<Block>(BlocksPerChunk, numNewSlots);
+			blockPools.push_back(blockPool);
+			numChunkSlots += numNewSlots;
+			DebugStats::totalChunkRamAvailable = DebugStats::totalChunkRamAvailable + (float)blockPool->totalSize();
+			g_logger_info("Grew the block pools to %u chunk slots.", numChunkSlots);
+			return blockPool->getNewPool();
+		}
+
+		static void freeChunkBlocks(Block* blocks)
+		{
+			for (Pool<Block>* blockPool : blockPools)
+			{
+				if (blockPool->contains(blocks))
+				{
+					blockPool->freePool(blocks);
+					return;
+				}
+			}
+
+			g_logger_assert(false, "Chunk blocks '%zu' don't belong to any block pool.", blocks);
 		}
 
 		// TODO: Simplify me!
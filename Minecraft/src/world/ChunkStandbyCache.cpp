@@ -0,0 +1,187 @@
+#include "world/ChunkStandbyCache.h"
+#include "world/ChunkCodec.h"
+#include "core/Arena.hpp"
+#include "utils/Settings.h"
+
+#include <list>
+
+namespace Minecraft
+{
+	namespace ChunkStandbyCache
+	{
+		struct StandbyChunk
+		{
+			// Null while the chunk is still being read
+			uint8* data;
+			size_t size;
+			// Only valid once the data is here, chunks still being read can't be evicted
+			std::list<glm::ivec2>::iterator lruPosition;
+		};
+
+		// Internal members
+		static std::mutex cacheMtx;
+		static robin_hood::unordered_flat_map<glm::ivec2, StandbyChunk> standbyChunks;
+		// Most recently used at the front
+		static std::list<glm::ivec2> lruOrder;
+		static size_t totalBytes = 0;
+
+		// Internal functions
+		static void store(StandbyChunk& standbyChunk, const glm::ivec2& chunkCoords, const uint8* encodedData, size_t encodedSize);
+		static void release(StandbyChunk& standbyChunk);
+		static void evictToBudget();
+
+		bool beginPrefetch(const glm::ivec2& chunkCoords)
+		{
+			std::lock_guard<std::mutex> lock(cacheMtx);
+			if (standbyChunks.find(chunkCoords) != standbyChunks.end())
+			{
+				return false;
+			}
+
+			standbyChunks[chunkCoords] = { nullptr, 0, lruOrder.end() };
+			return true;
+		}
+
+		void finishPrefetch(const glm::ivec2& chunkCoords, const uint8* encodedData, size_t encodedSize)
+		{
+			std::lock_guard<std::mutex> lock(cacheMtx);
+			auto iter = standbyChunks.find(chunkCoords);
+			if (iter == standbyChunks.end() || iter->second.data)
+			{
+				return;
+			}
+
+			store(iter->second, chunkCoords, encodedData, encodedSize);
+			evictToBudget();
+		}
+
+		void cancelPrefetch(const glm::ivec2& chunkCoords)
+		{
+			// Placeholders aren't in the LRU list, so nothing else would ever drop them
+			std::lock_guard<std::mutex> lock(cacheMtx);
+			auto iter = standbyChunks.find(chunkCoords);
+			if (iter != standbyChunks.end() && !iter->second.data)
+			{
+				standbyChunks.erase(iter);
+			}
+		}
+
+		void insert(const glm::ivec2& chunkCoords, const Block* blocks)
+		{
+			ArenaScope arenaScope;
+			uint8* encodedData = Arena::threadLocal().allocate<uint8>(ChunkCodec::maxEncodedSize);
+			size_t encodedSize = ChunkCodec::encode(blocks, chunkCoords, encodedData, ChunkCodec::maxEncodedSize);
+			if (encodedSize == 0)
+			{
+				return;
+			}
+
+			std::lock_guard<std::mutex> lock(cacheMtx);
+			auto iter = standbyChunks.find(chunkCoords);
+			if (iter != standbyChunks.end())
+			{
+				release(iter->second);
+			}
+			else
+			{
+				iter = standbyChunks.emplace(chunkCoords, StandbyChunk{ nullptr, 0, lruOrder.end() }).first;
+			}
+
+			store(iter->second, chunkCoords, encodedData, encodedSize);
+			evictToBudget();
+		}
+
+		bool take(const glm::ivec2& chunkCoords, Block* blocks)
+		{
+			StandbyChunk standbyChunk;
+			{
+				std::lock_guard<std::mutex> lock(cacheMtx);
+				auto iter = standbyChunks.find(chunkCoords);
+				if (iter == standbyChunks.end())
+				{
+					return false;
+				}
+
+				standbyChunk = iter->second;
+				if (standbyChunk.data)
+				{
+					lruOrder.erase(standbyChunk.lruPosition);
+					totalBytes -= standbyChunk.size;
+				}
+				standbyChunks.erase(iter);
+			}
+
+			if (!standbyChunk.data)
+			{
+				// Still being read, the prefetch gets dropped when it finishes
+				return false;
+			}
+
+			glm::ivec2 decodedCoords;
+			bool decoded = ChunkCodec::decode(standbyChunk.data, standbyChunk.size, blocks, &decodedCoords);
+			g_memory_free(standbyChunk.data);
+			return decoded && decodedCoords == chunkCoords;
+		}
+
+		void clear()
+		{
+			std::lock_guard<std::mutex> lock(cacheMtx);
+			for (auto& [chunkCoords, standbyChunk] : standbyChunks)
+			{
+				if (standbyChunk.data)
+				{
+					g_memory_free(standbyChunk.data);
+				}
+			}
+			standbyChunks.clear();
+			lruOrder.clear();
+			totalBytes = 0;
+		}
+
+		size_t numChunks()
+		{
+			std::lock_guard<std::mutex> lock(cacheMtx);
+			return standbyChunks.size();
+		}
+
+		size_t memoryUsed()
+		{
+			std::lock_guard<std::mutex> lock(cacheMtx);
+			return totalBytes;
+		}
+
+		// =====================================================
+		// Internal functions
+		// =====================================================
+		static void store(StandbyChunk& standbyChunk, const glm::ivec2& chunkCoords, const uint8* encodedData, size_t encodedSize)
+		{
+			standbyChunk.data = (uint8*)g_memory_allocate(encodedSize);
+			standbyChunk.size = encodedSize;
+			g_memory_copyMem(standbyChunk.data, (void*)encodedData, encodedSize);
+			lruOrder.push_front(chunkCoords);
+			standbyChunk.lruPosition = lruOrder.begin();
+			totalBytes += encodedSize;
+		}
+
+		static void release(StandbyChunk& standbyChunk)
+		{
+			if (standbyChunk.data)
+			{
+				g_memory_free(standbyChunk.data);
+				lruOrder.erase(standbyChunk.lruPosition);
+				totalBytes -= standbyChunk.size;
+			}
+			standbyChunk = { nullptr, 0, lruOrder.end() };
+		}
+
+		static void evictToBudget()
+		{
+			while (totalBytes > Settings::Chunks::standbyCacheBudget && !lruOrder.empty())
+			{
+				auto iter = standbyChunks.find(lruOrder.back());
+				release(iter->second);
+				standbyChunks.erase(iter);
+			}
+		}
+	}
+}
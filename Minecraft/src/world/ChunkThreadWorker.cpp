@@ -2,6 +2,9 @@
 #include "world/Chunk.hpp"
 #include "world/World.h"
 #include "world/BlockMap.h"
+#include "world/RegionFile.h"
+#include "world/ChunkStandbyCache.h"
+#include "world/ChunkCodec.h"
 #include "core/Application.h"
 #include "core/GlobalThreadPool.h"
 #include "network/Network.h"
@@ -10,64 +13,138 @@
 namespace Minecraft
 {
 	// Internal functions
-	static void freeChunkCmd(void* fillChunkCmd, size_t dataSize);
+	static void runTask(void* chunkTask, size_t dataSize);
+	static void finishTask(void* chunkTask, size_t dataSize);
 	static void clientLoadChunk(void* fillChunkCmd, size_t dataSize);
 	static void generateTerrain(void* fillChunkCmd, size_t dataSize);
 	static void generateDecorations(FillChunkCommand* fillChunkCmd);
+	static void calculateSkyLighting(FillChunkCommand* fillChunkCmd);
 	static void calculateLighting(FillChunkCommand* fillChunkCmd);
 	static void recalculateLighting(void* fillChunkCmd, size_t dataSize);
 	static void tesselateVertices(void* fillChunkCmd, size_t dataSize);
 	static void saveBlockData(void* fillChunkCmd, size_t dataSize);
-	static bool isSynchronous(FillChunkCommand* command);
+
+	// Which chunks a command touches, as a manhattan radius around the command's chunk,
+	// and whether it writes to the block data in that area or only reads it
+	struct TaskFootprint
+	{
+		int radius;
+		bool writesBlockData;
+	};
+
+	static const TaskFootprint taskFootprints[(uint8)CommandType::Length] = {
+		// SaveBlockData, counts as a write since it releases the chunk
+		{ 0, true },
+		// ClientLoadChunk
+		{ 0, true },
+		// GenerateTerrain
+		{ 0, true },
+		// GenerateDecorations, trees spill leaves into the neighboring chunks
+		{ 1, true },
+		// CalculateSkyLighting
+		{ 0, true },
+		// CalculateLighting, light levels can travel up to two chunks away
+		{ 2, true },
+		// RecalculateLighting
+		{ 2, true },
+		// TesselateVertices, reads the border blocks of the neighboring chunks
+		{ 1, false },
+	};
+	static const int maxFootprintRadius = 2;
 
 	// Internal members
-	static uint32 barrierSyncCounter = 0;
-	static uint32 barrierSyncPoint = 0;
 	// Used for tracking progress
 	static uint32 totalCommandCount = 0;
 	static uint32 totalCommandsDone = 0;
-	static std::mutex barrierMtx;
+	// The task currently running on this thread. Commands queued from inside a task
+	// are released once that task completes instead of waiting for beginWork
+	static thread_local ChunkTask* currentTask = nullptr;
 
 	bool CompareFillChunkCommand::operator()(const FillChunkCommand& a, const FillChunkCommand& b) const
 	{
-		if (a.type != b.type)
+		if (a.type != b.type && (a.type == CommandType::SaveBlockData || b.type == CommandType::SaveBlockData))
 		{
-			// Order of priorities is listed in the CommandType least to greatest
-			return (uint8)a.type > (uint8)b.type;
+			// Saves always go first since they free up chunk memory
+			return b.type == CommandType::SaveBlockData;
 		}
 
-		if (a.type != CommandType::CalculateLighting && a.type != CommandType::GenerateDecorations)
+		// The chunk closer to a player has higher priority
+		glm::ivec2 tmpA = a.playerPosChunkCoords - a.chunk->chunkCoords;
+		int32 aDistanceSquared = (tmpA.x * tmpA.x) + (tmpA.y * tmpA.y);
+		glm::ivec2 tmpB = b.playerPosChunkCoords - b.chunk->chunkCoords;
+		int32 bDistanceSquared = (tmpB.x * tmpB.x) + (tmpB.y * tmpB.y);
+		if (aDistanceSquared != bDistanceSquared)
 		{
-			// They are the same type of command, the chunk closer to the player has higher priority
-			glm::ivec2 tmpA = a.playerPosChunkCoords - a.chunk->chunkCoords;
-			int32 aDistanceSquared = (tmpA.x * tmpA.x) + (tmpA.y * tmpA.y);
-			glm::ivec2 tmpB = b.playerPosChunkCoords - b.chunk->chunkCoords;
-			int32 bDistanceSquared = (tmpB.x * tmpB.x) + (tmpB.y * tmpB.y);
 			return aDistanceSquared > bDistanceSquared;
 		}
 
-		return false;
+		// Order of priorities is listed in the CommandType least to greatest
+		return (uint8)a.type > (uint8)b.type;
+	}
+
+	bool CompareChunkTask::operator()(const ChunkTask* a, const ChunkTask* b) const
+	{
+		return CompareFillChunkCommand()(a->command, b->command);
 	}
 
 	ChunkThreadWorker::ChunkThreadWorker()
-		: cv(), cv2(), mtx(), queueMtx(), doWork(true)
+		: numTasksInFlight(0), numSavesInFlight(0), numSavesPending(0), loadPositions(1, glm::ivec2(0, 0)), cv(), ioCv(), graphMtx(), doWork(true)
 	{
-		std::lock_guard<std::mutex> barrierLock(barrierMtx);
-		barrierSyncCounter = 0;
-		barrierSyncPoint = 0;
+		std::lock_guard<std::mutex> lock(graphMtx);
+		totalCommandCount = 0;
+		totalCommandsDone = 0;
+
+		// Every chunk can have one of each command pending, so reserving that much up front keeps
+		// the task graph from going back to the heap once it's running
+		const size_t maxTasks = (size_t)World::getChunkCapacity() * (size_t)CommandType::Length;
+		pendingStages.reserve(World::getChunkCapacity());
+		allTasks.reserve(maxTasks);
+		stagedTasks.reserve(maxTasks);
+		readyTasks.reserve(maxTasks);
+		readySaves.reserve(World::getChunkCapacity());
+		ioQueue.reserve(maxSavesInFlight);
+
 		workerThread = std::thread(&ChunkThreadWorker::threadWorker, this);
+		ioThread = std::thread(&ChunkThreadWorker::ioWorker, this);
 	}
 
 	void ChunkThreadWorker::free()
 	{
 		{
-			std::lock_guard lock(mtx);
+			std::lock_guard<std::mutex> lock(graphMtx);
 			doWork = false;
 		}
 		cv.notify_all();
-		cv2.notify_all();
-
+		ioCv.notify_all();
 		workerThread.join();
+		// The I/O thread drains whatever saves it was already given before it exits
+		ioThread.join();
+
+		// Let the thread pool finish anything we already handed off
+		{
+			std::unique_lock<std::mutex> lock(graphMtx);
+			cv.wait(lock, [&] { return numTasksInFlight == 0; });
+		}
+
+		// Only save commands still matter once we're shutting down, everything else is dropped
+		for (ChunkTask* task : allTasks)
+		{
+			if (task->command.type == CommandType::SaveBlockData)
+			{
+				saveBlockData(&task->command, sizeof(FillChunkCommand));
+			}
+		}
+		RegionFile::commit(World::chunkSavePath);
+
+		for (ChunkTask* task : allTasks)
+		{
+			taskPool.release(task);
+		}
+		allTasks.clear();
+		pendingStages.clear();
+		stagedTasks.clear();
+		readyTasks.clear();
+		readySaves.clear();
 	}
 
 	void ChunkThreadWorker::threadWorker()
@@ -75,142 +152,328 @@ namespace Minecraft
 #ifdef _USE_OPTICK
 		OPTICK_THREAD("ChunkThreadWorker");
 #endif
+		MemoryStats::isPipelineThread = true;
 
-		bool shouldContinue = true;
-		while (shouldContinue)
+		while (true)
 		{
-			if (commands.empty())
+			ChunkTask* task = nullptr;
+			bool handedOffSaves = false;
+			bool cancelTask = false;
 			{
 				// Wait until we need to do some work
-				std::unique_lock<std::mutex> lock(mtx);
-				if (doWork)
+				std::unique_lock<std::mutex> lock(graphMtx);
+				cv.wait(lock, [&] {
+					return !doWork || !readyTasks.empty() ||
+						(!readySaves.empty() && numSavesInFlight < maxSavesInFlight);
+				});
+				if (!doWork)
 				{
-					cv.wait(lock, [&] { return (!doWork || !commands.empty()) && !waitingOnCommand; });
-					shouldContinue = true;
+					break;
 				}
-				else
+
+				// Saves go to the I/O thread, but only up to the budget so the I/O queue stays bounded
+				while (!readySaves.empty() && numSavesInFlight < maxSavesInFlight)
+				{
+					ioQueue.push_back(readySaves.back());
+					readySaves.pop_back();
+					numSavesInFlight++;
+					numTasksInFlight++;
+					handedOffSaves = true;
+				}
+
+				if (!readyTasks.empty())
 				{
-					shouldContinue = false;
+					std::pop_heap(readyTasks.begin(), readyTasks.end(), CompareChunkTask());
+					task = readyTasks.back();
+					readyTasks.pop_back();
+					numTasksInFlight++;
+					// The load positions can only be read under the lock
+					cancelTask = shouldCancel(task);
 				}
 			}
 
-			FillChunkCommand* command = (FillChunkCommand*)g_memory_allocate(sizeof(FillChunkCommand));
-			bool processCommand = false;
+			if (handedOffSaves)
+			{
+				ioCv.notify_one();
+			}
+
+			if (!task)
+			{
+				continue;
+			}
+
+			if (cancelTask)
+			{
+				DebugStats::cancelledChunkCommands++;
+				completeTask(task);
+				continue;
+			}
+
+			dispatchTask(task);
+		}
+	}
+
+	void ChunkThreadWorker::ioWorker()
+	{
+#ifdef _USE_OPTICK
+		OPTICK_THREAD("ChunkIoWorker");
+#endif
+		MemoryStats::isPipelineThread = true;
+
+		while (true)
+		{
+			ChunkTask* task = nullptr;
 			{
-				std::lock_guard<std::mutex> queueLock(queueMtx);
-				if (!commands.empty())
+				std::unique_lock<std::mutex> lock(graphMtx);
+				ioCv.wait(lock, [&] { return !doWork || !ioQueue.empty(); });
+				if (ioQueue.empty())
 				{
-					// Only process all commands if we're not stopping the thread worker.
-					// If we are stopping the thread worker, then only process save commands
-					do
-					{
-						g_memory_copyMem(command, (void*)&commands.top(), sizeof(FillChunkCommand));
-						commands.pop();
-						processCommand = (!doWork && command->type == CommandType::SaveBlockData) || doWork;
-					} while (!doWork && command->type != CommandType::SaveBlockData && commands.size() > 0);
+					// Only stop once every save we were handed has been written
+					break;
 				}
+
+				task = ioQueue.back();
+				ioQueue.pop_back();
+			}
+
+			runTask(task, sizeof(ChunkTask));
+
+			// Saves are committed in batches, one fsync group each time we run out of queued saves
+			bool batchDone;
+			{
+				std::lock_guard<std::mutex> lock(graphMtx);
+				batchDone = ioQueue.empty();
+			}
+			if (batchDone)
+			{
+				RegionFile::commit(World::chunkSavePath);
+			}
+			completeTask(task);
+		}
+	}
+
+	void ChunkThreadWorker::flushSaves()
+	{
+		// Anything still staged has to be released, otherwise the saves would never run
+		beginWork();
+
+		std::unique_lock<std::mutex> lock(graphMtx);
+		cv.wait(lock, [&] { return numSavesPending == 0; });
+	}
+
+	bool ChunkThreadWorker::shouldCancel(ChunkTask* task)
+	{
+		FillChunkCommand& command = task->command;
+		switch (command.type)
+		{
+		case CommandType::GenerateTerrain:
+		{
+			// Only drop chunks that haven't been filled yet, anything else has to go through a save
+			if (command.chunk->state != ChunkState::Loading)
+			{
+				return false;
+			}
+
+			// Only the nearest position matters, if it's out of range of that one it's out of range of all of them
+			glm::ivec2 localChunkPos = nearestLoadPosition(command.chunk->chunkCoords) - command.chunk->chunkCoords;
+			bool inRangeOfPlayer =
+				(localChunkPos.x * localChunkPos.x) + (localChunkPos.y * localChunkPos.y) <=
+				(World::ChunkRadius * World::ChunkRadius);
+			if (inRangeOfPlayer)
+			{
+				return false;
 			}
 
-			if (isSynchronous(command))
+			// The chunk manager erases the chunk once nothing else is queued on it
+			command.chunk->state = ChunkState::Unloaded;
+			return true;
+		}
+		case CommandType::GenerateDecorations:
+		case CommandType::CalculateSkyLighting:
+		case CommandType::CalculateLighting:
+		case CommandType::TesselateVertices:
+			// Everything queued behind a cancelled fill goes with it, even if the chunk got queued again since
+			return command.chunk->state == ChunkState::Unloaded || command.loadGeneration != command.chunk->loadGeneration;
+		}
+
+		return false;
+	}
+
+	void ChunkThreadWorker::dispatchTask(ChunkTask* task)
+	{
+		switch (task->command.type)
+		{
+		case CommandType::ClientLoadChunk:
+			Application::getGlobalThreadPool().queueTask(runTask, "ClientLoadChunk", task, sizeof(ChunkTask), Priority::High, finishTask);
+			break;
+		case CommandType::GenerateTerrain:
+			Application::getGlobalThreadPool().queueTask(runTask, "GenerateTerrain", task, sizeof(ChunkTask), Priority::High, finishTask);
+			break;
+		case CommandType::GenerateDecorations:
+			Application::getGlobalThreadPool().queueTask(runTask, "GenerateDecorations", task, sizeof(ChunkTask), Priority::High, finishTask);
+			break;
+		case CommandType::CalculateSkyLighting:
+			Application::getGlobalThreadPool().queueTask(runTask, "CalculateSkyLighting", task, sizeof(ChunkTask), Priority::High, finishTask);
+			break;
+		case CommandType::CalculateLighting:
+			Application::getGlobalThreadPool().queueTask(runTask, "CalculateLighting", task, sizeof(ChunkTask), Priority::High, finishTask);
+			break;
+		case CommandType::RecalculateLighting:
+			Application::getGlobalThreadPool().queueTask(runTask, "RecalculateLighting", task, sizeof(ChunkTask), Priority::High, finishTask);
+			break;
+		case CommandType::TesselateVertices:
+			Application::getGlobalThreadPool().queueTask(runTask, "TesselateVertices", task, sizeof(ChunkTask), Priority::High, finishTask);
+			break;
+		}
+
+		Application::getGlobalThreadPool().beginWork(false);
+	}
+
+	void ChunkThreadWorker::queueCommand(FillChunkCommand& command)
+	{
+#ifdef _HEADLESS
+		// Nothing gets drawn on a dedicated server, so there's no point building meshes
+		if (command.type == CommandType::TesselateVertices)
+		{
+			return;
+		}
+#endif
+
+		command.loadGeneration = command.chunk->loadGeneration;
+
+		ChunkTask* task = taskPool.acquire();
+		task->command = command;
+		task->worker = this;
+		task->dependents.clear();
+		// The extra dependency holds the task back until it gets released
+		task->numDependencies = 1;
+
+		{
+			std::lock_guard<std::mutex> lock(graphMtx);
+			task->command.playerPosChunkCoords = nearestLoadPosition(command.chunk->chunkCoords);
+			addDependencies(task);
+			pendingStages[command.chunk->chunkCoords].pending[(uint8)command.type] = task;
+			allTasks.insert(task);
+			totalCommandCount++;
+			if (command.type == CommandType::SaveBlockData)
 			{
-				std::unique_lock<std::mutex> lock(mtx);
-				cv2.wait(lock, [&] { return !doWork || barrierSyncCounter >= barrierSyncPoint; });
+				numSavesPending++;
+			}
 
-				std::lock_guard<std::mutex> barrierLock(barrierMtx);
-				barrierSyncCounter = 0;
-				barrierSyncPoint = 0;
+			if (currentTask)
+			{
+				currentTask->dependents.push_back(task);
 			}
 			else
 			{
-				std::lock_guard<std::mutex> lock(barrierMtx);
-				barrierSyncPoint++;
+				stagedTasks.push_back(task);
 			}
+		}
+	}
 
-			if (processCommand)
+	void ChunkThreadWorker::addDependencies(ChunkTask* task)
+	{
+		const glm::ivec2 chunkCoords = task->command.chunk->chunkCoords;
+		const uint8 type = (uint8)task->command.type;
+		const TaskFootprint& footprint = taskFootprints[type];
+
+		const int searchRadius = footprint.radius + maxFootprintRadius;
+		for (int z = -searchRadius; z <= searchRadius; z++)
+		{
+			const int xRadius = searchRadius - glm::abs(z);
+			for (int x = -xRadius; x <= xRadius; x++)
 			{
-				switch (command->type)
+				auto iter = pendingStages.find(chunkCoords + glm::ivec2(x, z));
+				if (iter == pendingStages.end())
 				{
-				case CommandType::SaveBlockData:
-				{
-					// SYNCHRONOUS for now, once we switch to unlimited height, this can become asynchronous
-					//Application::getGlobalThreadPool().queueTask(saveBlockData, command, sizeof(FillChunkCommand), Priority::High, freeChunkCmd);
-					saveBlockData(command, sizeof(FillChunkCommand));
-					freeChunkCmd(command, sizeof(FillChunkCommand));
-					break;
+					continue;
 				}
-				case CommandType::ClientLoadChunk:
-					Application::getGlobalThreadPool().queueTask(clientLoadChunk, "ClientLoadChunk", command, sizeof(FillChunkCommand), Priority::High, freeChunkCmd);
-					break;
-				case CommandType::GenerateTerrain:
+
+				const int distance = glm::abs(x) + glm::abs(z);
+				for (uint8 otherType = 0; otherType < (uint8)CommandType::Length; otherType++)
 				{
-#ifdef _USE_OPTICK
-					OPTICK_EVENT("GenerateTerrain");
-#endif
-					Application::getGlobalThreadPool().queueTask(generateTerrain, "GenerateTerrain", command, sizeof(FillChunkCommand), Priority::High, freeChunkCmd);
-					break;
+					ChunkTask* other = iter->second.pending[otherType];
+					if (!other)
+					{
+						continue;
+					}
+
+					const TaskFootprint& otherFootprint = taskFootprints[otherType];
+					bool sameStage = distance == 0 && otherType == type;
+					bool overlaps = distance <= footprint.radius + otherFootprint.radius &&
+						(footprint.writesBlockData || otherFootprint.writesBlockData);
+					if (sameStage || overlaps)
+					{
+						other->dependents.push_back(task);
+						task->numDependencies++;
+					}
 				}
-				case CommandType::GenerateDecorations:
+			}
+		}
+	}
+
+	void ChunkThreadWorker::completeTask(ChunkTask* task)
+	{
+		{
+			std::lock_guard<std::mutex> lock(graphMtx);
+			auto iter = pendingStages.find(task->command.chunk->chunkCoords);
+			if (iter != pendingStages.end())
+			{
+				ChunkTask*& slot = iter->second.pending[(uint8)task->command.type];
+				if (slot == task)
 				{
-#ifdef _USE_OPTICK
-					OPTICK_EVENT("GenerateDecorations");
-#endif
-					// SYNCHRONOUS
-					generateDecorations(command);
-					freeChunkCmd(command, sizeof(FillChunkCommand));
-					break;
+					slot = nullptr;
 				}
-				case CommandType::CalculateLighting:
+
+				bool anyPending = false;
+				for (ChunkTask* pending : iter->second.pending)
 				{
-#ifdef _USE_OPTICK
-					OPTICK_EVENT("CalculateLighting");
-#endif
-					// SYNCHRONOUS
-					calculateLighting(command);
-					freeChunkCmd(command, sizeof(FillChunkCommand));
-					break;
+					anyPending = anyPending || pending != nullptr;
 				}
-				case CommandType::RecalculateLighting:
+				if (!anyPending)
 				{
-#ifdef _USE_OPTICK
-					OPTICK_EVENT("RecalculateLighting");
-#endif
-					// SYNCHRONOUS
-					recalculateLighting(command, sizeof(FillChunkCommand));
-					freeChunkCmd(command, sizeof(FillChunkCommand));
-					break;
+					pendingStages.erase(iter);
 				}
-				case CommandType::TesselateVertices:
+			}
+
+			for (ChunkTask* dependent : task->dependents)
+			{
+				dependent->numDependencies--;
+				if (dependent->numDependencies == 0)
 				{
-#ifdef _USE_OPTICK
-					OPTICK_EVENT("TesselateVertices");
-#endif
-					Application::getGlobalThreadPool().queueTask(tesselateVertices, "TesselateVertices", command, sizeof(FillChunkCommand), Priority::High, freeChunkCmd);
-					break;
-				}
+					pushReadyTask(dependent);
 				}
-
-				Application::getGlobalThreadPool().beginWork(false);
 			}
-			else
+
+			numTasksInFlight--;
+			totalCommandsDone++;
+			allTasks.erase(task);
+			if (task->command.type == CommandType::SaveBlockData)
 			{
-				g_memory_free(command);
+				numSavesInFlight--;
+				numSavesPending--;
 			}
 		}
+
+		taskPool.release(task);
+		cv.notify_all();
 	}
 
-	void ChunkThreadWorker::queueCommand(FillChunkCommand& command)
+	void ChunkThreadWorker::beginWork(bool notifyAll)
 	{
-		command.playerPosChunkCoords = playerPosChunkCoords.load();
 		{
-			std::lock_guard<std::mutex> lockGuard(queueMtx);
-			std::lock_guard<std::mutex> lockGuard2(barrierMtx);
-			totalCommandCount++;
-			commands.push(command);
+			std::lock_guard<std::mutex> lock(graphMtx);
+			for (ChunkTask* task : stagedTasks)
+			{
+				task->numDependencies--;
+				if (task->numDependencies == 0)
+				{
+					pushReadyTask(task);
+				}
+			}
+			stagedTasks.clear();
 		}
-	}
 
-	void ChunkThreadWorker::beginWork(bool notifyAll)
-	{
 		if (notifyAll)
 		{
 			cv.notify_all();
@@ -221,19 +484,78 @@ namespace Minecraft
 		}
 	}
 
-	void ChunkThreadWorker::wakeupCv2()
+	void ChunkThreadWorker::pushReadyTask(ChunkTask* task)
 	{
-		cv2.notify_all();
+		// Commands can sit in the graph for a while, so they're keyed against the live position
+		task->command.playerPosChunkCoords = nearestLoadPosition(task->command.chunk->chunkCoords);
+		if (task->command.type == CommandType::SaveBlockData)
+		{
+			readySaves.push_back(task);
+		}
+		else
+		{
+			readyTasks.push_back(task);
+			std::push_heap(readyTasks.begin(), readyTasks.end(), CompareChunkTask());
+		}
 	}
 
 	void ChunkThreadWorker::setPlayerPosChunkCoords(const glm::ivec2& playerPosChunkCoords)
 	{
-		this->playerPosChunkCoords = playerPosChunkCoords;
+		std::lock_guard<std::mutex> lock(graphMtx);
+		if (loadPositions[0] == playerPosChunkCoords)
+		{
+			return;
+		}
+		// A LAN host loads around its guests too, they only move when checkChunkRadius runs again
+		loadPositions[0] = playerPosChunkCoords;
+		reprioritizeReadyTasks();
+	}
+
+	void ChunkThreadWorker::setLoadPositions(const std::vector<glm::ivec2>& loadChunkCoords)
+	{
+		g_logger_assert(loadChunkCoords.size() > 0, "Need at least one position to prioritize chunk work around.");
+
+		std::lock_guard<std::mutex> lock(graphMtx);
+		if (loadPositions == loadChunkCoords)
+		{
+			return;
+		}
+		loadPositions.assign(loadChunkCoords.begin(), loadChunkCoords.end());
+		reprioritizeReadyTasks();
+	}
+
+	void ChunkThreadWorker::reprioritizeReadyTasks()
+	{
+		// The ordering of the ready queue depends on the load positions, so re-heap it in place
+		for (ChunkTask* task : readyTasks)
+		{
+			task->command.playerPosChunkCoords = nearestLoadPosition(task->command.chunk->chunkCoords);
+		}
+		std::make_heap(readyTasks.begin(), readyTasks.end(), CompareChunkTask());
+	}
+
+	glm::ivec2 ChunkThreadWorker::nearestLoadPosition(const glm::ivec2& chunkCoords) const
+	{
+		glm::ivec2 nearest = loadPositions[0];
+		glm::ivec2 tmp = nearest - chunkCoords;
+		int32 nearestDistanceSquared = (tmp.x * tmp.x) + (tmp.y * tmp.y);
+		for (size_t i = 1; i < loadPositions.size(); i++)
+		{
+			tmp = loadPositions[i] - chunkCoords;
+			int32 distanceSquared = (tmp.x * tmp.x) + (tmp.y * tmp.y);
+			if (distanceSquared < nearestDistanceSquared)
+			{
+				nearest = loadPositions[i];
+				nearestDistanceSquared = distanceSquared;
+			}
+		}
+
+		return nearest;
 	}
 
 	float ChunkThreadWorker::percentDone()
 	{
-		std::lock_guard<std::mutex> lock(barrierMtx);
+		std::lock_guard<std::mutex> lock(graphMtx);
 		if (initialSize == -1.0f)
 		{
 			initialSize = (float)totalCommandCount;
@@ -241,17 +563,56 @@ namespace Minecraft
 		return (float)totalCommandsDone >= initialSize ? 1.0f : 1.0f - ((initialSize - (float)totalCommandsDone) / initialSize);
 	}
 
-	static bool isSynchronous(FillChunkCommand* command)
+	bool ChunkThreadWorker::hasPendingWork(const glm::ivec2& chunkCoords)
+	{
+		std::lock_guard<std::mutex> lock(graphMtx);
+		return pendingStages.find(chunkCoords) != pendingStages.end();
+	}
+
+	static void runTask(void* chunkTask, size_t dataSize)
 	{
+		g_logger_assert(dataSize == sizeof(ChunkTask), "Invalid data size sent to task 'runTask'.\nExpected '%zu', but got '%zu'", sizeof(ChunkTask), dataSize);
+		ChunkTask* task = (ChunkTask*)chunkTask;
+		FillChunkCommand* command = &task->command;
+
+		// Pool threads run other work too, so they only count as part of the pipeline until finishTask
+		MemoryStats::isPipelineThread = true;
+		currentTask = task;
 		switch (command->type)
 		{
-		case CommandType::CalculateLighting:
+		case CommandType::SaveBlockData:
+			saveBlockData(command, sizeof(FillChunkCommand));
+			break;
+		case CommandType::ClientLoadChunk:
+			clientLoadChunk(command, sizeof(FillChunkCommand));
+			break;
+		case CommandType::GenerateTerrain:
+			generateTerrain(command, sizeof(FillChunkCommand));
+			break;
 		case CommandType::GenerateDecorations:
+			generateDecorations(command);
+			break;
+		case CommandType::CalculateSkyLighting:
+			calculateSkyLighting(command);
+			break;
+		case CommandType::CalculateLighting:
+			calculateLighting(command);
+			break;
 		case CommandType::RecalculateLighting:
-			return true;
+			recalculateLighting(command, sizeof(FillChunkCommand));
+			break;
+		case CommandType::TesselateVertices:
+			tesselateVertices(command, sizeof(FillChunkCommand));
+			break;
 		}
+		currentTask = nullptr;
+	}
 
-		return false;
+	static void finishTask(void* chunkTask, size_t dataSize)
+	{
+		ChunkTask* task = (ChunkTask*)chunkTask;
+		task->worker->completeTask(task);
+		MemoryStats::isPipelineThread = false;
 	}
 
 	static void clientLoadChunk(void* fillChunkCmd, size_t dataSize)
@@ -260,9 +621,16 @@ namespace Minecraft
 		FillChunkCommand& command = *(FillChunkCommand*)fillChunkCmd;
 
 		g_logger_assert(command.clientChunkData != nullptr, "Invalid client data sent to the chunk.");
-		g_memory_copyMem(command.chunk->data, command.clientChunkData,
-			sizeof(Block) * World::ChunkWidth * World::ChunkDepth * World::ChunkHeight);
+		// Decodes straight into the chunk's slab of the block pool
+		glm::ivec2 chunkCoords;
+		bool decoded = ChunkCodec::decode(command.clientChunkData, command.clientChunkDataSize, command.chunk->data, &chunkCoords);
 		g_memory_free(command.clientChunkData);
+		if (!decoded || chunkCoords != command.chunk->chunkCoords)
+		{
+			// Better a hole of air than whatever was left in the pool
+			g_logger_error("Recieved corrupted chunk data from the server for chunk <%d, %d>.", command.chunk->chunkCoords.x, command.chunk->chunkCoords.y);
+			g_memory_zeroMem(command.chunk->data, sizeof(Block) * World::ChunkWidth * World::ChunkDepth * World::ChunkHeight);
+		}
 		command.chunk->needsToGenerateDecorations = false;
 		command.chunk->needsToCalculateLighting = true;
 	}
@@ -272,37 +640,54 @@ namespace Minecraft
 		g_logger_assert(dataSize == sizeof(FillChunkCommand), "Invalid data size sent to task 'generateTerrain'.\nExpected '%zu', but got '%zu'", sizeof(FillChunkCommand), dataSize);
 		FillChunkCommand& command = *(FillChunkCommand*)fillChunkCmd;
 
-		if (Network::isNetworkEnabled())
+		// Clients get their chunks streamed from the server
+		if (Network::isNetworkEnabled() && !Network::isLanServer())
 		{
+			command.chunk->state = ChunkState::Loaded;
 			return;
 		}
 
-		if (ChunkPrivate::exists(World::chunkSavePath, command.chunk->chunkCoords))
+		if (ChunkStandbyCache::take(command.chunk->chunkCoords, command.chunk->data))
+		{
+			// Already read ahead of time, matches what's on disk
+			command.chunk->needsToGenerateDecorations = false;
+			command.chunk->savedEpoch = command.chunk->modifiedEpoch;
+		}
+		else if (ChunkPrivate::exists(World::chunkSavePath, command.chunk->chunkCoords))
 		{
 			ChunkPrivate::deserialize(*command.chunk, World::chunkSavePath);
 			command.chunk->needsToGenerateDecorations = false;
+			// Matches what's on disk, so there's nothing to save until someone changes it
+			command.chunk->savedEpoch = command.chunk->modifiedEpoch;
 		}
 		else
 		{
 			ChunkPrivate::generateTerrain(command.chunk, command.chunk->chunkCoords, World::seedAsFloat);
 			command.chunk->needsToGenerateDecorations = true;
+			command.chunk->markModified();
 		}
 		command.chunk->needsToCalculateLighting = true;
+		command.chunk->state = ChunkState::Loaded;
 	}
 
 	static void generateDecorations(FillChunkCommand* fillChunkCmd)
 	{
-		if (Network::isNetworkEnabled())
+		if (Network::isNetworkEnabled() && !Network::isLanServer())
 		{
 			return;
 		}
 
-		ChunkPrivate::generateDecorations(fillChunkCmd->playerPosChunkCoords, World::seedAsFloat);
+		ChunkPrivate::generateDecorations(fillChunkCmd->chunk, World::seed);
+	}
+
+	static void calculateSkyLighting(FillChunkCommand* fillChunkCmd)
+	{
+		ChunkPrivate::calculateSkyLighting(fillChunkCmd->chunk);
 	}
 
 	static void calculateLighting(FillChunkCommand* fillChunkCmd)
 	{
-		ChunkPrivate::calculateLighting(fillChunkCmd->playerPosChunkCoords);
+		ChunkPrivate::calculateLighting(fillChunkCmd->chunk);
 	}
 
 	static void recalculateLighting(void* fillChunkCmd, size_t dataSize)
@@ -310,7 +695,9 @@ namespace Minecraft
 		g_logger_assert(dataSize == sizeof(FillChunkCommand), "Invalid data size sent to task 'clientLoadChunk'.\nExpected '%zu', but got '%zu'", sizeof(FillChunkCommand), dataSize);
 		FillChunkCommand& command = *(FillChunkCommand*)fillChunkCmd;
 
-		robin_hood::unordered_flat_set<Chunk*> chunksToRetesselate = {};
+		// Kept per thread so clearing it holds on to its memory for the next update
+		static thread_local robin_hood::unordered_flat_set<Chunk*> chunksToRetesselate;
+		chunksToRetesselate.clear();
 		ChunkPrivate::calculateLightingUpdate(command.chunk, command.chunk->chunkCoords, command.blockThatUpdated, command.removedLightSource, chunksToRetesselate);
 		for (Chunk* chunk : chunksToRetesselate)
 		{
@@ -358,31 +745,22 @@ namespace Minecraft
 			}
 		}
 
-		// Serialize block data
-		ChunkPrivate::serialize(World::chunkSavePath, *command.chunk);
-
-		// Tell the chunk manager we are done
-		command.chunk->state = ChunkState::Unloading;
-	}
-
-	static void freeChunkCmd(void* fillChunkCmd, size_t dataSize)
-	{
-		bool startWork = false;
+		// Serialize block data, chunks that haven't changed since they were loaded just get unloaded
+		if (command.chunk->isDirty())
 		{
-			std::lock_guard<std::mutex> lock(barrierMtx);
-			barrierSyncCounter++;
-			totalCommandsDone++;
-			if (barrierSyncCounter >= barrierSyncPoint)
-			{
-				startWork = true;
-			}
+			uint32 epoch = command.chunk->modifiedEpoch;
+			ChunkPrivate::serialize(World::chunkSavePath, *command.chunk);
+			command.chunk->savedEpoch = epoch;
 		}
 
-		if (startWork)
+		// Keep a compressed copy around so walking back doesn't have to go to disk. This also
+		// replaces any copy that was read ahead of time and is now out of date.
+		if (!Network::isNetworkEnabled())
 		{
-			// Wake up the conditional variable if needed
-			ChunkManager::wakeUpCv2();
+			ChunkStandbyCache::insert(command.chunk->chunkCoords, command.chunk->data);
 		}
-		g_memory_free(fillChunkCmd);
+
+		// Tell the chunk manager we are done
+		command.chunk->state = ChunkState::Unloading;
 	}
 }
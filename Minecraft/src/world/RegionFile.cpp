@@ -0,0 +1,670 @@
+#include "world/RegionFile.h"
+#include "core/Arena.hpp"
+#include "core/File.h"
+
+#include <shared_mutex>
+
+namespace Minecraft
+{
+	namespace RegionFile
+	{
+		// Region file layout
+		// Header: ChunksPerRegion locations (uint32), each one is sectorOffset (24 bits) -> sectorCount (8 bits)
+		//         a location of 0 means the chunk has never been saved
+		// Chunk:  dataSize (uint32) -> data, starting at sectorOffset * SectorSize
+		//
+		// Chunks are never rewritten in place. A save goes to fresh sectors and the header only gets
+		// pointed at them once the data is on disk, so a crash always leaves the last committed copy.
+		//
+		// Journal layout
+		// Magic (uint32) -> numEntries (uint32) -> JournalEntry * numEntries -> checksum (uint32)
+		static const uint32 SectorSize = 4096;
+		static const uint32 ChunksPerRegion = RegionWidth * RegionWidth;
+		static const uint32 HeaderSectors = (ChunksPerRegion * sizeof(uint32) + SectorSize - 1) / SectorSize;
+		static const uint32 MaxSectorsPerChunk = 255;
+		static const uint32 JournalMagic = 0x4C4E524A;
+
+		struct JournalEntry
+		{
+			int32 regionX;
+			int32 regionZ;
+			uint32 locationIndex;
+			uint32 location;
+		};
+
+		struct Region
+		{
+			// Reads share the lock, writes and remaps take it exclusively
+			std::shared_mutex mtx;
+			// Null until the first chunk in this region gets saved
+			FILE* fp;
+			std::string filepath;
+			// Read-only view of the file. Chunks written after it was mapped may live past the end of it.
+			MappedFile mapping;
+			uint32 locations[ChunksPerRegion];
+			std::vector<bool> usedSectors;
+
+			std::string chunkSavePath;
+			glm::ivec2 regionCoords;
+			// Header entries that haven't been committed yet, and the sectors they replace. The old
+			// sectors stay allocated until the commit so nothing can overwrite the committed copy.
+			robin_hood::unordered_flat_map<uint32, uint32> uncommittedLocations;
+			std::vector<glm::uvec2> uncommittedFrees;
+		};
+
+		// Internal members
+		static std::mutex regionsMtx;
+		static robin_hood::unordered_node_map<std::string, Region> regions;
+		// Only one batch can be going through the journal at a time
+		static std::mutex commitMtx;
+
+		// Internal functions
+		static Region* getRegion(const std::string& chunkSavePath, const glm::ivec2& regionCoords);
+		static bool openRegionFile(Region& region, const std::string& filepath, bool createIfNeeded);
+		static std::string getRegionFilepath(const std::string& chunkSavePath, const glm::ivec2& regionCoords);
+		static uint32 getLocationIndex(const glm::ivec2& chunkCoords);
+		static uint32 allocateSectors(Region& region, uint32 numSectors);
+		static bool readMappedChunk(Region& region, const glm::ivec2& chunkCoords, RegionChunkCallback callback, void* userData);
+		static bool getMappedChunk(const Region& region, uint32 location, RawMemory& memory);
+		static bool isMapped(const Region& region, uint32 location);
+		static std::string getJournalFilepath(const std::string& chunkSavePath);
+		static bool writeJournal(const std::string& chunkSavePath, const std::vector<JournalEntry>& entries);
+		static uint32 journalChecksum(const std::vector<JournalEntry>& entries);
+		static void freeSectors(Region& region, uint32 sectorOffset, uint32 sectorCount);
+
+		bool writeChunk(const std::string& chunkSavePath, const glm::ivec2& chunkCoords, const uint8* data, size_t dataSize)
+		{
+			uint32 sectorsNeeded = (uint32)((sizeof(uint32) + dataSize + SectorSize - 1) / SectorSize);
+			if (sectorsNeeded > MaxSectorsPerChunk)
+			{
+				g_logger_error("Chunk<%d, %d> is too large to fit in a region file. Size: '%zu'", chunkCoords.x, chunkCoords.y, dataSize);
+				return false;
+			}
+
+			glm::ivec2 regionCoords = toRegionCoords(chunkCoords);
+			Region* region = getRegion(chunkSavePath, regionCoords);
+			std::unique_lock<std::shared_mutex> lock(region->mtx);
+			if (!region->fp && !openRegionFile(*region, getRegionFilepath(chunkSavePath, regionCoords), true))
+			{
+				return false;
+			}
+
+			uint32 locationIndex = getLocationIndex(chunkCoords);
+			uint32 oldLocation = region->locations[locationIndex];
+			uint32 sectorOffset = allocateSectors(*region, sectorsNeeded);
+
+			uint32 size = (uint32)dataSize;
+			fseek(region->fp, (long)(sectorOffset * SectorSize), SEEK_SET);
+			fwrite(&size, sizeof(uint32), 1, region->fp);
+			fwrite(data, dataSize, 1, region->fp);
+			// Readers go through the mapping, so the data has to leave our stdio buffer right away
+			fflush(region->fp);
+
+			uint32 location = (sectorOffset << 8) | sectorsNeeded;
+			region->locations[locationIndex] = location;
+
+			auto uncommitted = region->uncommittedLocations.find(locationIndex);
+			if (uncommitted != region->uncommittedLocations.end())
+			{
+				// Nothing on disk points at the last uncommitted copy, so it can be reused right away
+				freeSectors(*region, oldLocation >> 8, oldLocation & 0xFF);
+				uncommitted->second = location;
+			}
+			else
+			{
+				if (oldLocation != 0)
+				{
+					region->uncommittedFrees.emplace_back(oldLocation >> 8, oldLocation & 0xFF);
+				}
+				region->uncommittedLocations[locationIndex] = location;
+			}
+
+			return true;
+		}
+
+		void commit(const std::string& chunkSavePath)
+		{
+			std::lock_guard<std::mutex> commitLock(commitMtx);
+
+			std::vector<Region*> savePathRegions;
+			{
+				std::lock_guard<std::mutex> lock(regionsMtx);
+				for (auto& [filepath, region] : regions)
+				{
+					if (region.chunkSavePath == chunkSavePath)
+					{
+						savePathRegions.push_back(&region);
+					}
+				}
+			}
+
+			// Get every chunk's data on disk before anything points at it
+			struct RegionBatch
+			{
+				Region* region;
+				size_t firstEntry;
+				size_t numEntries;
+				std::vector<glm::uvec2> frees;
+			};
+			std::vector<RegionBatch> batches;
+			std::vector<JournalEntry> entries;
+			for (Region* region : savePathRegions)
+			{
+				std::unique_lock<std::shared_mutex> lock(region->mtx);
+				if (region->uncommittedLocations.empty())
+				{
+					continue;
+				}
+
+				File::syncFile(region->fp);
+				RegionBatch batch;
+				batch.region = region;
+				batch.firstEntry = entries.size();
+				batch.numEntries = region->uncommittedLocations.size();
+				batch.frees = std::move(region->uncommittedFrees);
+				for (auto& [locationIndex, location] : region->uncommittedLocations)
+				{
+					entries.push_back({ region->regionCoords.x, region->regionCoords.y, locationIndex, location });
+				}
+				region->uncommittedLocations.clear();
+				region->uncommittedFrees.clear();
+				batches.emplace_back(std::move(batch));
+			}
+
+			if (entries.empty())
+			{
+				return;
+			}
+
+			// Once the journal is on disk the batch can always be replayed, even if we die halfway through the headers
+			bool journaled = writeJournal(chunkSavePath, entries);
+			for (RegionBatch& batch : batches)
+			{
+				std::unique_lock<std::shared_mutex> lock(batch.region->mtx);
+				for (size_t i = batch.firstEntry; i < batch.firstEntry + batch.numEntries; i++)
+				{
+					fseek(batch.region->fp, (long)(entries[i].locationIndex * sizeof(uint32)), SEEK_SET);
+					fwrite(&entries[i].location, sizeof(uint32), 1, batch.region->fp);
+				}
+				File::syncFile(batch.region->fp);
+
+				for (const glm::uvec2& sectors : batch.frees)
+				{
+					freeSectors(*batch.region, sectors.x, sectors.y);
+				}
+			}
+
+			if (journaled)
+			{
+				std::error_code error;
+				std::filesystem::remove(getJournalFilepath(chunkSavePath), error);
+			}
+		}
+
+		void recoverJournal(const std::string& chunkSavePath)
+		{
+			std::string journalFilepath = getJournalFilepath(chunkSavePath);
+			FILE* fp = fopen(journalFilepath.c_str(), "rb");
+			if (!fp)
+			{
+				return;
+			}
+
+			uint32 magic = 0;
+			uint32 numEntries = 0;
+			uint32 checksum = 0;
+			std::vector<JournalEntry> entries;
+			bool valid = fread(&magic, sizeof(uint32), 1, fp) == 1 && magic == JournalMagic &&
+				fread(&numEntries, sizeof(uint32), 1, fp) == 1 && numEntries <= ChunksPerRegion * 1024;
+			if (valid)
+			{
+				entries.resize(numEntries);
+				valid = (numEntries == 0 || fread(entries.data(), sizeof(JournalEntry), numEntries, fp) == numEntries) &&
+					fread(&checksum, sizeof(uint32), 1, fp) == 1 && checksum == journalChecksum(entries);
+			}
+			fclose(fp);
+
+			// A journal that didn't finish writing means none of its headers were touched yet
+			if (valid)
+			{
+				FILE* regionFp = nullptr;
+				glm::ivec2 openRegionCoords;
+				for (const JournalEntry& entry : entries)
+				{
+					glm::ivec2 regionCoords = glm::ivec2(entry.regionX, entry.regionZ);
+					if (!regionFp || regionCoords != openRegionCoords)
+					{
+						if (regionFp)
+						{
+							File::syncFile(regionFp);
+							fclose(regionFp);
+						}
+						regionFp = fopen(getRegionFilepath(chunkSavePath, regionCoords).c_str(), "r+b");
+						openRegionCoords = regionCoords;
+					}
+
+					if (regionFp && entry.locationIndex < ChunksPerRegion)
+					{
+						fseek(regionFp, (long)(entry.locationIndex * sizeof(uint32)), SEEK_SET);
+						fwrite(&entry.location, sizeof(uint32), 1, regionFp);
+					}
+				}
+
+				if (regionFp)
+				{
+					File::syncFile(regionFp);
+					fclose(regionFp);
+				}
+				g_logger_info("Replayed %u chunk saves from the region journal.", numEntries);
+			}
+
+			std::error_code error;
+			std::filesystem::remove(journalFilepath, error);
+		}
+
+		bool readChunk(const std::string& chunkSavePath, const glm::ivec2& chunkCoords, RegionChunkCallback callback, void* userData)
+		{
+			Region* region = getRegion(chunkSavePath, toRegionCoords(chunkCoords));
+			return readMappedChunk(*region, chunkCoords, callback, userData);
+		}
+
+		void readChunks(const std::string& chunkSavePath, const std::vector<glm::ivec2>& chunkCoords, RegionChunkCallback callback, void* userData)
+		{
+			// Group the chunks by region so every region only gets locked and seeked through once
+			robin_hood::unordered_flat_map<glm::ivec2, std::vector<glm::ivec2>> chunksByRegion;
+			for (const glm::ivec2& coords : chunkCoords)
+			{
+				chunksByRegion[toRegionCoords(coords)].push_back(coords);
+			}
+
+			for (auto& [regionCoords, regionChunks] : chunksByRegion)
+			{
+				Region* region = getRegion(chunkSavePath, regionCoords);
+				{
+					std::shared_lock<std::shared_mutex> lock(region->mtx);
+					if (!region->fp)
+					{
+						continue;
+					}
+
+					// Read in file order so the page faults stay sequential
+					std::sort(regionChunks.begin(), regionChunks.end(), [region](const glm::ivec2& a, const glm::ivec2& b) {
+						return region->locations[getLocationIndex(a)] < region->locations[getLocationIndex(b)];
+					});
+				}
+
+				prefetchChunks(chunkSavePath, regionChunks);
+				for (const glm::ivec2& coords : regionChunks)
+				{
+					readMappedChunk(*region, coords, callback, userData);
+				}
+			}
+		}
+
+		void prefetchChunks(const std::string& chunkSavePath, const std::vector<glm::ivec2>& chunkCoords)
+		{
+			for (const glm::ivec2& coords : chunkCoords)
+			{
+				Region* region = getRegion(chunkSavePath, toRegionCoords(coords));
+				std::shared_lock<std::shared_mutex> lock(region->mtx);
+				uint32 location = region->locations[getLocationIndex(coords)];
+				if (region->fp && location != 0 && isMapped(*region, location))
+				{
+					// Chunks that aren't mapped yet were written recently, so they're still in the page cache anyways
+					File::prefetchMappedRange(region->mapping, (size_t)(location >> 8) * SectorSize, (size_t)(location & 0xFF) * SectorSize);
+				}
+			}
+		}
+
+		bool chunkExists(const std::string& chunkSavePath, const glm::ivec2& chunkCoords)
+		{
+			Region* region = getRegion(chunkSavePath, toRegionCoords(chunkCoords));
+			std::shared_lock<std::shared_mutex> lock(region->mtx);
+			return region->fp && region->locations[getLocationIndex(chunkCoords)] != 0;
+		}
+
+		glm::ivec2 toRegionCoords(const glm::ivec2& chunkCoords)
+		{
+			// Round towards negative infinity so chunk -1 ends up in region -1
+			return glm::ivec2(
+				chunkCoords.x >= 0 ? chunkCoords.x / RegionWidth : ((chunkCoords.x + 1) / RegionWidth) - 1,
+				chunkCoords.y >= 0 ? chunkCoords.y / RegionWidth : ((chunkCoords.y + 1) / RegionWidth) - 1
+			);
+		}
+
+		void convertChunkFiles(const std::string& chunkSavePath)
+		{
+			std::error_code error;
+			if (!std::filesystem::is_directory(chunkSavePath, error))
+			{
+				return;
+			}
+
+			std::vector<std::filesystem::path> convertedFiles;
+			for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(chunkSavePath, error))
+			{
+				if (!entry.is_regular_file() || entry.path().extension() != ".bin")
+				{
+					continue;
+				}
+
+				// Old chunk files are named x_z.bin
+				glm::ivec2 chunkCoords;
+				std::string filename = entry.path().stem().string();
+				if (sscanf(filename.c_str(), "%d_%d", &chunkCoords.x, &chunkCoords.y) != 2)
+				{
+					continue;
+				}
+
+				FILE* fp = fopen(entry.path().string().c_str(), "rb");
+				if (!fp)
+				{
+					g_logger_error("Could not open chunk file '%s' for conversion.", entry.path().string().c_str());
+					continue;
+				}
+
+				fseek(fp, 0L, SEEK_END);
+				size_t fileSize = ftell(fp);
+				rewind(fp);
+
+				ArenaScope arenaScope;
+				uint8* fileData = Arena::threadLocal().allocate<uint8>(fileSize);
+				bool readSuccessfully = fread(fileData, fileSize, 1, fp) == 1 || fileSize == 0;
+				fclose(fp);
+
+				if (readSuccessfully && writeChunk(chunkSavePath, chunkCoords, fileData, fileSize))
+				{
+					convertedFiles.push_back(entry.path());
+				}
+			}
+
+			// The old files can only go once the region headers that replace them are on disk
+			commit(chunkSavePath);
+			for (const std::filesystem::path& path : convertedFiles)
+			{
+				std::filesystem::remove(path, error);
+			}
+
+			if (!convertedFiles.empty())
+			{
+				g_logger_info("Converted %zu chunk files into region files.", convertedFiles.size());
+			}
+		}
+
+		void closeAll()
+		{
+			std::vector<std::string> chunkSavePaths;
+			{
+				std::lock_guard<std::mutex> lock(regionsMtx);
+				for (auto& [filepath, region] : regions)
+				{
+					if (std::find(chunkSavePaths.begin(), chunkSavePaths.end(), region.chunkSavePath) == chunkSavePaths.end())
+					{
+						chunkSavePaths.push_back(region.chunkSavePath);
+					}
+				}
+			}
+
+			for (const std::string& chunkSavePath : chunkSavePaths)
+			{
+				commit(chunkSavePath);
+			}
+
+			std::lock_guard<std::mutex> lock(regionsMtx);
+			for (auto& [filepath, region] : regions)
+			{
+				File::unmapFile(region.mapping);
+				if (region.fp)
+				{
+					fclose(region.fp);
+					region.fp = nullptr;
+				}
+			}
+			regions.clear();
+		}
+
+		// =====================================================
+		// Internal functions
+		// =====================================================
+		static Region* getRegion(const std::string& chunkSavePath, const glm::ivec2& regionCoords)
+		{
+			std::string filepath = getRegionFilepath(chunkSavePath, regionCoords);
+
+			std::lock_guard<std::mutex> lock(regionsMtx);
+			auto iter = regions.find(filepath);
+			if (iter != regions.end())
+			{
+				return &iter->second;
+			}
+
+			// Regions that don't exist yet get cached too, so looking up missing chunks never touches the disk
+			Region& region = regions[filepath];
+			region.fp = nullptr;
+			region.filepath = filepath;
+			region.chunkSavePath = chunkSavePath;
+			region.regionCoords = regionCoords;
+			region.mapping = { nullptr, 0, nullptr };
+			g_memory_zeroMem(region.locations, sizeof(region.locations));
+			openRegionFile(region, filepath, false);
+			return &region;
+		}
+
+		static bool openRegionFile(Region& region, const std::string& filepath, bool createIfNeeded)
+		{
+			region.fp = fopen(filepath.c_str(), "r+b");
+			if (region.fp)
+			{
+				fseek(region.fp, 0L, SEEK_END);
+				size_t fileSize = ftell(region.fp);
+				rewind(region.fp);
+
+				if (fread(region.locations, sizeof(region.locations), 1, region.fp) != 1)
+				{
+					g_logger_error("Region file '%s' has a corrupted header.", filepath.c_str());
+					g_memory_zeroMem(region.locations, sizeof(region.locations));
+				}
+
+				uint32 numSectors = (uint32)((fileSize + SectorSize - 1) / SectorSize);
+				region.usedSectors.assign(glm::max(numSectors, HeaderSectors), false);
+			}
+			else if (createIfNeeded)
+			{
+				region.fp = fopen(filepath.c_str(), "w+b");
+				if (!region.fp)
+				{
+					g_logger_error("Failed to create region file '%s'", filepath.c_str());
+					return false;
+				}
+
+				g_memory_zeroMem(region.locations, sizeof(region.locations));
+				fwrite(region.locations, sizeof(region.locations), 1, region.fp);
+				region.usedSectors.assign(HeaderSectors, false);
+			}
+			else
+			{
+				return false;
+			}
+
+			for (uint32 i = 0; i < HeaderSectors; i++)
+			{
+				region.usedSectors[i] = true;
+			}
+
+			for (uint32 i = 0; i < ChunksPerRegion; i++)
+			{
+				uint32 sectorOffset = region.locations[i] >> 8;
+				uint32 sectorCount = region.locations[i] & 0xFF;
+				if (sectorOffset == 0)
+				{
+					continue;
+				}
+
+				if (sectorOffset + sectorCount > region.usedSectors.size())
+				{
+					region.usedSectors.resize(sectorOffset + sectorCount, false);
+				}
+				for (uint32 sector = sectorOffset; sector < sectorOffset + sectorCount; sector++)
+				{
+					region.usedSectors[sector] = true;
+				}
+			}
+
+			return true;
+		}
+
+		static std::string getRegionFilepath(const std::string& chunkSavePath, const glm::ivec2& regionCoords)
+		{
+			return chunkSavePath + "/r." + std::to_string(regionCoords.x) + "." + std::to_string(regionCoords.y) + ".region";
+		}
+
+		static uint32 getLocationIndex(const glm::ivec2& chunkCoords)
+		{
+			glm::ivec2 localCoords = chunkCoords - (toRegionCoords(chunkCoords) * RegionWidth);
+			return (uint32)(localCoords.x + localCoords.y * RegionWidth);
+		}
+
+		static uint32 allocateSectors(Region& region, uint32 numSectors)
+		{
+			// First fit, anything that doesn't fit in a gap goes at the end of the file
+			uint32 runStart = HeaderSectors;
+			uint32 runLength = 0;
+			for (uint32 sector = HeaderSectors; sector < (uint32)region.usedSectors.size(); sector++)
+			{
+				if (region.usedSectors[sector])
+				{
+					runStart = sector + 1;
+					runLength = 0;
+					continue;
+				}
+
+				runLength++;
+				if (runLength == numSectors)
+				{
+					break;
+				}
+			}
+
+			if (runStart + numSectors > region.usedSectors.size())
+			{
+				region.usedSectors.resize(runStart + numSectors, false);
+			}
+			for (uint32 sector = runStart; sector < runStart + numSectors; sector++)
+			{
+				region.usedSectors[sector] = true;
+			}
+
+			return runStart;
+		}
+
+		static bool readMappedChunk(Region& region, const glm::ivec2& chunkCoords, RegionChunkCallback callback, void* userData)
+		{
+			// If the chunk was written after the region got mapped, remap the file once and try again
+			for (int attempt = 0; attempt < 2; attempt++)
+			{
+				{
+					std::shared_lock<std::shared_mutex> lock(region.mtx);
+					uint32 location = region.locations[getLocationIndex(chunkCoords)];
+					if (!region.fp || location == 0)
+					{
+						return false;
+					}
+
+					if (isMapped(region, location))
+					{
+						RawMemory memory;
+						if (!getMappedChunk(region, location, memory))
+						{
+							return false;
+						}
+
+						// The lock stays held so nobody can remap the file out from under the callback
+						callback(chunkCoords, memory, userData);
+						return true;
+					}
+				}
+
+				std::unique_lock<std::shared_mutex> lock(region.mtx);
+				if (!isMapped(region, region.locations[getLocationIndex(chunkCoords)]))
+				{
+					File::unmapFile(region.mapping);
+					region.mapping = File::mapFileReadOnly(region.filepath.c_str());
+				}
+			}
+
+			return false;
+		}
+
+		static bool getMappedChunk(const Region& region, uint32 location, RawMemory& memory)
+		{
+			uint32 sectorOffset = location >> 8;
+			uint32 sectorCount = location & 0xFF;
+			size_t chunkStart = (size_t)sectorOffset * SectorSize;
+
+			uint32 dataSize;
+			g_memory_copyMem(&dataSize, (void*)(region.mapping.data + chunkStart), sizeof(uint32));
+			if (dataSize > sectorCount * SectorSize - sizeof(uint32) || chunkStart + sizeof(uint32) + dataSize > region.mapping.size)
+			{
+				g_logger_error("Region file '%s' has a corrupted chunk at sector '%d'.", region.filepath.c_str(), sectorOffset);
+				return false;
+			}
+
+			// Nothing ever writes through this, the mapping is read-only
+			memory.data = (uint8*)(region.mapping.data + chunkStart + sizeof(uint32));
+			memory.size = dataSize;
+			memory.offset = 0;
+			return true;
+		}
+
+		static bool isMapped(const Region& region, uint32 location)
+		{
+			// Only the size prefix has to be mapped, getMappedChunk checks the rest
+			size_t chunkStart = (size_t)(location >> 8) * SectorSize;
+			return region.mapping.data && chunkStart + sizeof(uint32) <= region.mapping.size;
+		}
+
+		static std::string getJournalFilepath(const std::string& chunkSavePath)
+		{
+			return chunkSavePath + "/regions.journal";
+		}
+
+		static bool writeJournal(const std::string& chunkSavePath, const std::vector<JournalEntry>& entries)
+		{
+			FILE* fp = fopen(getJournalFilepath(chunkSavePath).c_str(), "wb");
+			if (!fp)
+			{
+				g_logger_error("Could not open the region journal, committing chunk saves without it.");
+				return false;
+			}
+
+			uint32 numEntries = (uint32)entries.size();
+			uint32 checksum = journalChecksum(entries);
+			fwrite(&JournalMagic, sizeof(uint32), 1, fp);
+			fwrite(&numEntries, sizeof(uint32), 1, fp);
+			fwrite(entries.data(), sizeof(JournalEntry), entries.size(), fp);
+			fwrite(&checksum, sizeof(uint32), 1, fp);
+			bool synced = File::syncFile(fp);
+			fclose(fp);
+			return synced;
+		}
+
+		static uint32 journalChecksum(const std::vector<JournalEntry>& entries)
+		{
+			// FNV-1a, only here to catch a journal that was cut off mid write
+			uint32 hash = 2166136261u;
+			const uint8* bytes = (const uint8*)entries.data();
+			for (size_t i = 0; i < entries.size() * sizeof(JournalEntry); i++)
+			{
+				hash = (hash ^ bytes[i]) * 16777619u;
+			}
+			return hash;
+		}
+
+		static void freeSectors(Region& region, uint32 sectorOffset, uint32 sectorCount)
+		{
+			for (uint32 i = 0; i < sectorCount && sectorOffset != 0; i++)
+			{
+				region.usedSectors[sectorOffset + i] = false;
+			}
+		}
+	}
+}
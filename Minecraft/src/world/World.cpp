@@ -1,6 +1,7 @@
 #include "core.h"
 #include "world/World.h"
 #include "world/ChunkManager.h"
+#include "world/RegionFile.h"
 #include "world/BlockMap.h"
 #include "renderer/Shader.h"
 #include "renderer/Texture.h"
@@ -29,6 +30,7 @@
 #include "utils/TexturePacker.h"
 #include "utils/DebugStats.h"
 #include "utils/CMath.h"
+#include "utils/Settings.h"
 #include "gui/Gui.h"
 #include "gui/MainHud.h"
 #include "network/Network.h"
@@ -66,13 +68,18 @@ namespace Minecraft
 		static bool isLoading;
 		static std::thread asyncInitThread;
 
+		static const glm::vec3 defaultSpawnPosition = glm::vec3(-145.0f, 289, 55.0f);
+
 		// Internal functions
 		static void asyncInit(glm::vec3 playerPosition, bool isClient);
+		static void loadChunksAroundPlayers();
 
 		void init(Ecs::Registry& sceneRegistry, bool isLanClient)
 		{
 			isLoading = true;
+#ifndef _HEADLESS
 			ChunkLoadingScreen::init();
+#endif
 			registry = &sceneRegistry;
 
 			playerId = Ecs::nullEntity;
@@ -82,7 +89,7 @@ namespace Minecraft
 			// Initialize memory
 			ChunkManager::init();
 
-			lastPlayerLoadPosition = glm::vec2(-145.0f, 55.0f);
+			lastPlayerLoadPosition = glm::vec2(defaultSpawnPosition.x, defaultSpawnPosition.z);
 
 			if (isLanClient)
 			{
@@ -95,6 +102,8 @@ namespace Minecraft
 				// Initialize and create any filepaths for save information
 				g_logger_assert(savePath != "", "World save path must not be empty.");
 				setSavePath(savePath);
+				RegionFile::recoverJournal(chunkSavePath);
+				RegionFile::convertChunkFiles(chunkSavePath);
 
 				// Generate a seed if needed
 				Transform* playerTransform = nullptr;
@@ -110,27 +119,31 @@ namespace Minecraft
 					for (auto entity : registry->view<PlayerComponent>())
 					{
 						PlayerComponent& playerComponent = registry->getComponent<PlayerComponent>(entity);
+#ifndef _HEADLESS
 						if (playerComponent.name == localPlayerName)
 						{
 							playerId = entity;
 							playerComponent.isOnline = true;
+							continue;
 						}
-						else
-						{
-							playerComponent.isOnline = false;
-						}
+#endif
+						playerComponent.isOnline = false;
 					}
+#ifndef _HEADLESS
 					g_logger_assert(playerId != Ecs::nullEntity, "Failed to find a player '%s' from serialized world. Possible save corruption.", localPlayerName);
 					playerTransform = &registry->getComponent<Transform>(playerId);
 					PlayerComponent& playerComp = registry->getComponent<PlayerComponent>(playerId);
 					g_logger_info("Deserialized player '%s'", playerComp.name);
+#endif
 				}
+#ifndef _HEADLESS
 				else
 				{
 					// Setup player if this is a new world
-					playerId = createPlayer(localPlayerName.c_str(), glm::vec3(-145.0f, 289, 55.0f));
+					playerId = createPlayer(localPlayerName.c_str(), defaultSpawnPosition);
 					playerTransform = &registry->getComponent<Transform>(playerId);
 				}
+#endif
 
 				if (seed == UINT32_MAX)
 				{
@@ -142,12 +155,21 @@ namespace Minecraft
 				g_logger_info("Loading world in single player mode locally.");
 				g_logger_info("World seed: %u", seed);
 
+#ifdef _HEADLESS
+				// Nobody is online yet, so the spawn area is loaded until the first player joins
+				glm::vec3 loadPosition = defaultSpawnPosition;
+#else
 				g_logger_assert(playerTransform != nullptr, "Failed to find player or create player when initializing world.");
-				lastPlayerLoadPosition = glm::vec2(playerTransform->position.x, playerTransform->position.z);
+				glm::vec3 loadPosition = playerTransform->position;
+#endif
+				lastPlayerLoadPosition = glm::vec2(loadPosition.x, loadPosition.z);
 				TerrainGenerator::init("assets/custom/terrainNoise.yaml", seed);
-				asyncInitThread = std::thread(asyncInit, playerTransform->position, isClient);
+				asyncInitThread = std::thread(asyncInit, loadPosition, isClient);
 			}
 
+#ifdef _HEADLESS
+			Network::init(true);
+#else
 			reloadShaders();
 			skybox = Cubemap::generateCubemap(
 				"assets/images/sky/dayTop.png",
@@ -167,6 +189,7 @@ namespace Minecraft
 			Fonts::loadFont("assets/fonts/Minecraft.ttf", 16_px);
 			PlayerController::init();
 			MainHud::init();
+#endif
 		}
 
 		void reloadShaders()
@@ -234,26 +257,33 @@ namespace Minecraft
 				asyncInitThread.join();
 			}
 
+#ifndef _HEADLESS
 			Application::takeScreenshot((savePath + "/worldIcon.png").c_str());
+#endif
 
 			// Force any connections that might have been opened to close
 			Network::free();
 
+#ifndef _HEADLESS
 			opaqueShader.destroy();
 			transparentShader.destroy();
 			skybox.destroy();
 			nightSkybox.destroy();
 			cubemapShader.destroy();
+#endif
 
 			if (shouldSerialize)
 			{
 				serialize();
 				ChunkManager::serialize();
+				ChunkManager::flushSaves();
 			}
 			ChunkManager::free();
-			MainHud::free();
 			TerrainGenerator::free();
+#ifndef _HEADLESS
+			MainHud::free();
 			ChunkLoadingScreen::free();
+#endif
 
 			registry->clear();
 
@@ -431,8 +461,18 @@ namespace Minecraft
 				glm::ivec2 playerPositionInChunkCoords = toChunkCoords(playerPosition);
 				ChunkManager::render(playerPosition, playerPositionInChunkCoords, opaqueShader, transparentShader, cameraFrustum);
 
+				if (!isClient && registry->hasComponent<Rigidbody>(playerId))
+				{
+					ChunkManager::prefetchAhead(playerPosition, registry->getComponent<Rigidbody>(playerId).velocity);
+				}
+
 				// Check chunk radius if needed
-				if (glm::distance2(glm::vec2(playerPosition.x, playerPosition.z), lastPlayerLoadPosition) > World::ChunkWidth * World::ChunkDepth)
+				if (!isClient && Network::isNetworkEnabled() && Network::isLanServer())
+				{
+					// Players that joined need the chunks around them loaded before they can be sent in
+					loadChunksAroundPlayers();
+				}
+				else if (glm::distance2(glm::vec2(playerPosition.x, playerPosition.z), lastPlayerLoadPosition) > World::ChunkWidth * World::ChunkDepth)
 				{
 					lastPlayerLoadPosition = glm::vec2(playerPosition.x, playerPosition.z);
 					ChunkManager::checkChunkRadius(playerPosition, isClient);
@@ -440,6 +480,36 @@ namespace Minecraft
 			}
 		}
 
+		void serverUpdate()
+		{
+#ifdef _USE_OPTICK
+			OPTICK_EVENT();
+#endif
+			Network::update();
+
+			if (isLoading)
+			{
+				if (ChunkManager::percentWorkDone() < 1.0f)
+				{
+					return;
+				}
+
+				asyncInitThread.join();
+				isLoading = false;
+				g_logger_info("Spawn area loaded, the server is ready.");
+			}
+
+			Physics::update(*registry);
+			CharacterSystem::update(*registry);
+
+			if (doDaylightCycle)
+			{
+				worldTime = (worldTime + 10) % 2400;
+			}
+
+			loadChunksAroundPlayers();
+		}
+
 		void givePlayerBlock(Ecs::EntityId player, int blockId, int blockCount)
 		{
 			if (registry->hasComponent<Inventory>(player))
@@ -485,6 +555,15 @@ namespace Minecraft
 			playerId = localPlayer;
 		}
 
+		glm::vec3 getSpawnPosition()
+		{
+			if (playerId != Ecs::nullEntity && registry->hasComponent<Transform>(playerId))
+			{
+				return registry->getComponent<Transform>(playerId).position;
+			}
+			return defaultSpawnPosition;
+		}
+
 		Ecs::EntityId createPlayer(const char* playerName, const glm::vec3& position)
 		{
 			Ecs::EntityId player = registry->createEntity();
@@ -531,11 +610,13 @@ namespace Minecraft
 			if (!isClient)
 			{
 				std::string filepath = getWorldDataFilepath(savePath);
+				// Write everything to a temporary file first so a crash mid save never leaves a half written world
+				std::string tmpFilepath = filepath + ".tmp";
 				g_logger_info("Saving world to '%s'", filepath.c_str());
-				FILE* fp = fopen(filepath.c_str(), "wb");
+				FILE* fp = fopen(tmpFilepath.c_str(), "wb");
 				if (!fp)
 				{
-					g_logger_error("Could not serialize file '%s'", filepath.c_str());
+					g_logger_error("Could not serialize file '%s'", tmpFilepath.c_str());
 					return;
 				}
 
@@ -559,7 +640,12 @@ namespace Minecraft
 				g_memory_free(serializedRegistry.data);
 
 				// Done
+				bool synced = File::syncFile(fp);
 				fclose(fp);
+				if (!synced || !File::replaceFile(tmpFilepath.c_str(), filepath.c_str()))
+				{
+					g_logger_error("Could not replace world file '%s'", filepath.c_str());
+				}
 			}
 			else
 			{
@@ -614,6 +700,28 @@ namespace Minecraft
 			return false;
 		}
 
+		uint32 getChunkCapacity()
+		{
+#ifdef _HEADLESS
+			// The first player gets the same room as a client, everyone after them could be standing
+			// far enough away that none of their chunks overlap
+			uint32 chunksPerPlayer = 0;
+			for (int z = -ChunkRadius; z <= ChunkRadius; z++)
+			{
+				for (int x = -ChunkRadius; x <= ChunkRadius; x++)
+				{
+					if ((x * x) + (z * z) <= ChunkRadius * ChunkRadius)
+					{
+						chunksPerPlayer++;
+					}
+				}
+			}
+			return (uint32)ChunkCapacity + (glm::max(Settings::Server::maxPlayers, 1u) - 1) * chunksPerPlayer;
+#else
+			return ChunkCapacity;
+#endif
+		}
+
 		glm::ivec2 toChunkCoords(const glm::vec3& worldCoordinates)
 		{
 			return {
@@ -636,5 +744,47 @@ namespace Minecraft
 		{
 			ChunkManager::checkChunkRadius(playerPosition, isClient);
 		}
+
+		static void loadChunksAroundPlayers()
+		{
+			// The local player goes first, the chunk worker keeps that position up to date between checks
+			std::vector<glm::vec3> loadPositions;
+			if (playerId != Ecs::nullEntity && registry->hasComponent<Transform>(playerId))
+			{
+				loadPositions.push_back(registry->getComponent<Transform>(playerId).position);
+			}
+			for (Ecs::EntityId entity : registry->view<PlayerComponent, Transform>())
+			{
+				if (entity != playerId && registry->getComponent<PlayerComponent>(entity).isOnline)
+				{
+					loadPositions.push_back(registry->getComponent<Transform>(entity).position);
+				}
+			}
+
+			if (loadPositions.empty())
+			{
+				// Keep whatever was loaded last around so the next player doesn't have to wait on it
+				return;
+			}
+
+			// Same rule as the local player, only check again once somebody has moved a chunk's worth
+			static std::vector<glm::vec2> lastLoadPositions;
+			bool needsCheck = loadPositions.size() != lastLoadPositions.size();
+			for (size_t i = 0; i < loadPositions.size() && !needsCheck; i++)
+			{
+				glm::vec2 position = glm::vec2(loadPositions[i].x, loadPositions[i].z);
+				needsCheck = glm::distance2(position, lastLoadPositions[i]) > World::ChunkWidth * World::ChunkDepth;
+			}
+
+			if (needsCheck)
+			{
+				lastLoadPositions.clear();
+				for (const glm::vec3& position : loadPositions)
+				{
+					lastLoadPositions.push_back(glm::vec2(position.x, position.z));
+				}
+				ChunkManager::checkChunkRadius(loadPositions);
+			}
+		}
 	}
 }
\ No newline at end of file
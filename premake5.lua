@@ -14,7 +14,9 @@ workspace "Minecraft"
 -- This is a helper variable, to concatenate the sys-arch
 outputdir = "%{cfg.buildcfg}-%{cfg.system}-%{cfg.architecture}"
 
-project "Minecraft"
+-- Everything the game and the dedicated server share, the server is the same code built without
+-- anything that needs a window or a GL context
+function minecraftProject()
     kind "ConsoleApp"
     language "C++"
     cppdialect "C++17"
@@ -173,6 +175,12 @@ project "Minecraft"
         runtime "Release"
         optimize "on"
 
+    filter {}
+end
+
+project "Minecraft"
+    minecraftProject()
+
 project "Bootstrap"
     kind "ConsoleApp"
     language "C++"
@@ -246,16 +254,8 @@ project "Bootstrap"
         optimize "on"
 
 project "MinecraftServer"
-    language "C++"
-    cppdialect "C++17"
-    staticruntime "on"
-    filter "system:linux"
-        kind "None"
-    filter "system:windows"
-        kind "ConsoleApp"
+    minecraftProject()
 
-    targetdir("bin\\" .. outputdir .. "\\%{prj.name}")
-    objdir("bin-int\\" .. outputdir .. "\\%{prj.name}")
-    
-    -- TODO: Start this in debug mode using command line args or something
-    debugcommand ("bin\\" .. outputdir .. "\\Minecraft\\Minecraft.exe")
\ No newline at end of file
+    defines {
+        "_HEADLESS"
+    }